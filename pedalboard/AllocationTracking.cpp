@@ -0,0 +1,87 @@
+/*
+ * pedalboard
+ * Copyright 2021 Spotify AB
+ *
+ * Licensed under the GNU Public License, Version 3.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AllocationTracking.h"
+
+#if PEDALBOARD_TRACK_ALLOCATIONS
+
+#include <cstdlib>
+#include <new>
+
+/**
+ * Replacements for the global allocation functions, only compiled in when
+ * building with TRACK_ALLOCATIONS=1. These count allocations made while a
+ * ScopedAllocationGuard is active on the current thread, so that tests can
+ * assert that Plugin::process never touches the heap.
+ *
+ * Note that this only catches allocations made through operator new; JUCE's
+ * HeapBlock (and therefore AudioBuffer) calls std::malloc directly.
+ */
+static void *trackedAllocate(std::size_t size) {
+  if (Pedalboard::AllocationTracking::forbiddenScopeDepth > 0)
+    Pedalboard::AllocationTracking::numForbiddenAllocations++;
+
+  if (size == 0)
+    size = 1;
+
+  if (void *pointer = std::malloc(size))
+    return pointer;
+
+  throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size) { return trackedAllocate(size); }
+
+void *operator new[](std::size_t size) { return trackedAllocate(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return trackedAllocate(size);
+  } catch (const std::bad_alloc &) {
+    return nullptr;
+  }
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return trackedAllocate(size);
+  } catch (const std::bad_alloc &) {
+    return nullptr;
+  }
+}
+
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+
+void operator delete[](void *pointer) noexcept { std::free(pointer); }
+
+void operator delete(void *pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept {
+  std::free(pointer);
+}
+
+#endif
@@ -0,0 +1,64 @@
+/*
+ * pedalboard
+ * Copyright 2021 Spotify AB
+ *
+ * Licensed under the GNU Public License, Version 3.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#ifndef PEDALBOARD_TRACK_ALLOCATIONS
+#define PEDALBOARD_TRACK_ALLOCATIONS 0
+#endif
+
+namespace Pedalboard {
+namespace AllocationTracking {
+// Both of these are only read or written by the current thread, so no
+// synchronization is required. They're only updated if
+// PEDALBOARD_TRACK_ALLOCATIONS is enabled, as that replaces the global
+// operator new (see AllocationTracking.cpp).
+inline thread_local int forbiddenScopeDepth = 0;
+inline thread_local size_t numForbiddenAllocations = 0;
+} // namespace AllocationTracking
+
+/**
+ * Marks a scope in which heap allocations are not expected, like the body of
+ * Plugin::process. In builds with PEDALBOARD_TRACK_ALLOCATIONS enabled, any
+ * call to operator new made within this scope on this thread is counted, and
+ * can be retrieved with getNumAllocations(). In regular builds, this class
+ * does nothing.
+ */
+class ScopedAllocationGuard {
+public:
+  ScopedAllocationGuard() noexcept
+      : allocationsAtStart(AllocationTracking::numForbiddenAllocations) {
+    AllocationTracking::forbiddenScopeDepth++;
+  }
+
+  ~ScopedAllocationGuard() noexcept {
+    AllocationTracking::forbiddenScopeDepth--;
+  }
+
+  size_t getNumAllocations() const noexcept {
+    return AllocationTracking::numForbiddenAllocations - allocationsAtStart;
+  }
+
+  ScopedAllocationGuard(const ScopedAllocationGuard &) = delete;
+  ScopedAllocationGuard &operator=(const ScopedAllocationGuard &) = delete;
+
+private:
+  const size_t allocationsAtStart;
+};
+} // namespace Pedalboard
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <mutex>
 #include <optional>
 
@@ -28,6 +29,10 @@
 #include "Plugin.h"
 #include <pybind11/stl.h>
 
+// Hosting external plugins requires juce_audio_processors, which is not
+// available in headless builds.
+#if JUCE_MODULE_AVAILABLE_juce_audio_processors
+
 namespace Pedalboard {
 
 // JUCE external plugins use some global state; here we lock that state
@@ -35,10 +40,36 @@ namespace Pedalboard {
 static std::mutex EXTERNAL_PLUGIN_MUTEX;
 static int NUM_ACTIVE_EXTERNAL_PLUGINS = 0;
 
+/**
+ * Ensure we have a MessageManager, which is required by the VST wrapper.
+ * Without this, we get an assert(false) from JUCE at runtime.
+ *
+ * The MessageManager (and any other global state that JUCE's plugin formats
+ * create alongside it) is expensive to set up and tear down, so we only
+ * create it the first time it's needed and then keep it alive, regardless of
+ * how many plugins are loaded and unloaded. It's only torn down when the
+ * Python interpreter exits (see shutDownPluginHosting).
+ */
+inline void ensurePluginHostingIsInitialized() {
+  static std::once_flag initialized;
+  std::call_once(initialized, []() { juce::MessageManager::getInstance(); });
+}
+
+/**
+ * Delete JUCE's global plugin hosting state, if no plugins are still using it.
+ * Only called once, on interpreter exit.
+ */
+inline void shutDownPluginHosting() {
+  std::lock_guard<std::mutex> lock(EXTERNAL_PLUGIN_MUTEX);
+  if (NUM_ACTIVE_EXTERNAL_PLUGINS == 0 &&
+      juce::MessageManager::getInstanceWithoutCreating() != nullptr) {
+    juce::DeletedAtShutdown::deleteAll();
+    juce::MessageManager::deleteInstance();
+  }
+}
+
 inline std::vector<std::string> findInstalledVSTPluginPaths() {
-  // Ensure we have a MessageManager, which is required by the VST wrapper
-  // Without this, we get an assert(false) from JUCE at runtime
-  juce::MessageManager::getInstance();
+  ensurePluginHostingIsInitialized();
   juce::VST3PluginFormat format;
   std::vector<std::string> pluginPaths;
   for (juce::String pluginIdentifier : format.searchPathsForPlugins(
@@ -58,9 +89,7 @@ inline std::vector<std::string> findInstalledVSTPluginPaths() {
 class AudioUnitPathFinder {
 public:
   static std::vector<std::string> findInstalledAudioUnitPaths() {
-    // Ensure we have a MessageManager, which is required by the VST wrapper
-    // Without this, we get an assert(false) from JUCE at runtime
-    juce::MessageManager::getInstance();
+    ensurePluginHostingIsInitialized();
 
     juce::AudioUnitPluginFormat format;
 
@@ -115,9 +144,7 @@ public:
   ExternalPlugin(std::string &_pathToPluginFile)
       : pathToPluginFile(_pathToPluginFile) {
     py::gil_scoped_release release;
-    // Ensure we have a MessageManager, which is required by the VST wrapper
-    // Without this, we get an assert(false) from JUCE at runtime
-    juce::MessageManager::getInstance();
+    ensurePluginHostingIsInitialized();
 
     juce::KnownPluginList pluginList;
 
@@ -179,14 +206,12 @@ public:
 
   ~ExternalPlugin() {
     {
+      // Note that we don't tear down JUCE's global state here, even if this
+      // is the last plugin; the next plugin to be loaded would just have to
+      // recreate it.
       std::lock_guard<std::mutex> lock(EXTERNAL_PLUGIN_MUTEX);
       pluginInstance.reset();
       NUM_ACTIVE_EXTERNAL_PLUGINS--;
-
-      if (NUM_ACTIVE_EXTERNAL_PLUGINS == 0) {
-        juce::DeletedAtShutdown::deleteAll();
-        juce::MessageManager::deleteInstance();
-      }
     }
   }
 
@@ -296,7 +321,29 @@ public:
                                                   spec.maximumBlockSize);
       pluginInstance->prepareToPlay(spec.sampleRate, spec.maximumBlockSize);
       pluginInstance->setNonRealtime(true);
+
+      // Allocate everything process() needs up front, so that processing
+      // each block doesn't have to touch the heap:
+      size_t pluginBufferChannelCount = getPluginBufferChannelCount();
+      channelPointers.resize(
+          std::max(pluginBufferChannelCount, (size_t)spec.numChannels));
+
+      // Depending on the bus layout, we may have to pass extra buffers to the
+      // plugin that we don't use.
+      int numDummyChannels = std::max(
+          0, (int)pluginBufferChannelCount - (int)spec.numChannels);
+      dummyChannels.setSize(numDummyChannels, (int)spec.maximumBlockSize,
+                            false, false, true);
+    }
+  }
+
+  void release() override {
+    if (pluginInstance) {
+      pluginInstance->releaseResources();
     }
+    dummyChannels.setSize(0, 0);
+    channelPointers.clear();
+    channelPointers.shrink_to_fit();
   }
 
   void reset() noexcept override {
@@ -311,40 +358,43 @@ public:
   void
   process(const juce::dsp::ProcessContextReplacing<float> &context) override {
     if (pluginInstance) {
-      juce::MidiBuffer emptyMidiBuffer;
+      // Some plugins write MIDI to this buffer; clearing it (rather than
+      // constructing a new one) lets us reuse its memory across blocks.
+      emptyMidiBuffer.clear();
       if (context.usesSeparateInputAndOutputBlocks()) {
         throw std::runtime_error("Not implemented yet - "
                                  "no support for using separate "
                                  "input and output blocks.");
       } else {
-        size_t pluginBufferChannelCount = 0;
-        // Iterate through all input busses and add their input channels to our
-        // buffer:
-        for (size_t i = 0;
-             i < static_cast<size_t>(pluginInstance->getBusCount(true)); i++) {
-          if (pluginInstance->getBus(true, i)->isEnabled()) {
-            pluginBufferChannelCount +=
-                pluginInstance->getBus(true, i)->getNumberOfChannels();
-          }
-        }
+        size_t pluginBufferChannelCount = getPluginBufferChannelCount();
 
         juce::dsp::AudioBlock<float> &outputBlock = context.getOutputBlock();
 
-        std::vector<float *> channelPointers(pluginBufferChannelCount);
+        size_t numDummyChannels =
+            pluginBufferChannelCount > outputBlock.getNumChannels()
+                ? pluginBufferChannelCount - outputBlock.getNumChannels()
+                : 0;
+
+        if (channelPointers.size() < pluginBufferChannelCount ||
+            channelPointers.size() < outputBlock.getNumChannels() ||
+            (size_t)dummyChannels.getNumChannels() < numDummyChannels ||
+            (numDummyChannels > 0 && (size_t)dummyChannels.getNumSamples() <
+                                         outputBlock.getNumSamples())) {
+          throw std::runtime_error(
+              "Plugin '" + pluginInstance->getName().toStdString() +
+              "' was not prepared for a block of this size.");
+        }
 
         for (size_t i = 0; i < outputBlock.getNumChannels(); i++) {
           channelPointers[i] = outputBlock.getChannelPointer(i);
         }
 
-        // Depending on the bus layout, we may have to pass extra buffers to the
-        // plugin that we don't use. Use vector here to ensure the memory is
-        // freed via RAII.
-        std::vector<std::vector<float>> dummyChannels;
+        // Pass any extra buffers required by the bus layout from our
+        // preallocated (and otherwise unused) dummy channels.
         for (size_t i = outputBlock.getNumChannels();
              i < pluginBufferChannelCount; i++) {
-          std::vector<float> dummyChannel(outputBlock.getNumSamples());
-          channelPointers[i] = dummyChannel.data();
-          dummyChannels.push_back(dummyChannel);
+          channelPointers[i] = dummyChannels.getWritePointer(
+              (int)(i - outputBlock.getNumChannels()));
         }
 
         if ((size_t)pluginInstance->getMainBusNumInputChannels() !=
@@ -397,15 +447,43 @@ public:
   }
 
 private:
+  size_t getPluginBufferChannelCount() const {
+    size_t pluginBufferChannelCount = 0;
+    // Iterate through all input busses and add their input channels to our
+    // buffer:
+    for (size_t i = 0;
+         i < static_cast<size_t>(pluginInstance->getBusCount(true)); i++) {
+      if (pluginInstance->getBus(true, i)->isEnabled()) {
+        pluginBufferChannelCount +=
+            pluginInstance->getBus(true, i)->getNumberOfChannels();
+      }
+    }
+    return pluginBufferChannelCount;
+  }
+
   constexpr static int ExternalLoadSampleRate = 44100,
                        ExternalLoadMaximumBlockSize = 8192;
   juce::String pathToPluginFile;
   juce::PluginDescription foundPluginDescription;
   juce::AudioPluginFormatManager pluginFormatManager;
   std::unique_ptr<juce::AudioPluginInstance> pluginInstance;
+
+  // Preallocated in prepare() and reused by process() for every block:
+  std::vector<float *> channelPointers;
+  juce::AudioBuffer<float> dummyChannels;
+  juce::MidiBuffer emptyMidiBuffer;
 };
 
 inline void init_external_plugins(py::module &m) {
+  py::module::import("atexit").attr("register")(
+      py::cpp_function(&shutDownPluginHosting));
+
+  // Exposed for testing, to check that hosting state outlives plugins:
+  m.def("_get_message_manager_address", []() {
+    return reinterpret_cast<std::uintptr_t>(
+        juce::MessageManager::getInstanceWithoutCreating());
+  });
+
   py::class_<juce::AudioProcessorParameter>(
       m, "_AudioProcessorParameter",
       "An abstract base class for parameter objects that can be added to an "
@@ -588,4 +666,6 @@ inline void init_external_plugins(py::module &m) {
 #endif
 }
 
-} // namespace Pedalboard
\ No newline at end of file
+} // namespace Pedalboard
+
+#endif
@@ -24,13 +24,21 @@
 
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <juce_audio_formats/juce_audio_formats.h>
-#include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_core/juce_core.h>
 #include <juce_data_structures/juce_data_structures.h>
 #include <juce_dsp/juce_dsp.h>
 #include <juce_events/juce_events.h>
+
+// These modules are left out of headless builds (see HEADLESS in setup.py):
+#if JUCE_MODULE_AVAILABLE_juce_audio_processors
+#include <juce_audio_processors/juce_audio_processors.h>
+#endif
+#if JUCE_MODULE_AVAILABLE_juce_graphics
 #include <juce_graphics/juce_graphics.h>
+#endif
+#if JUCE_MODULE_AVAILABLE_juce_gui_basics
 #include <juce_gui_basics/juce_gui_basics.h>
+#endif
 
 #define JUCE_PROJUCER_VERSION 0x60008
 
@@ -18,32 +18,61 @@
 #pragma once
 
 #include "JuceHeader.h"
+#include <atomic>
+#include <mutex>
+#include <type_traits>
 
 #include "Plugin.h"
 
 // A macro to make it easier to add simple parameter validation to existing
 // JUCE DSP types, without fully wrapping them in JUCE's `AudioParameter`
 // machinery.
+//
+// Parameters may be read and written from any thread (even without the GIL,
+// on free-threaded Python builds) so the stored value is atomic, and the DSP
+// object is only updated while holding the plugin's mutex. (The GIL is
+// released while waiting for it, as a concurrent process() call may hold it
+// for a long time.)
 #define DEFINE_DSP_SETTER_AND_GETTER(type, CamelCaseParameterName,             \
                                      setterValidation)                         \
 private:                                                                       \
-  type _##CamelCaseParameterName;                                              \
+  std::atomic<type> _##CamelCaseParameterName;                                 \
                                                                                \
 public:                                                                        \
   type get##CamelCaseParameterName() const {                                   \
-    return _##CamelCaseParameterName;                                          \
+    return _##CamelCaseParameterName.load();                                   \
   }                                                                            \
   void set##CamelCaseParameterName(const type value) {                         \
     {setterValidation};                                                        \
+    Pedalboard::ScopedGILReleasingLock lock(this->mutex);                      \
     _##CamelCaseParameterName = value;                                         \
     this->getDSP().set##CamelCaseParameterName(value);                         \
   }
 
 namespace Pedalboard {
+template <typename DSPType, typename = void>
+struct HasReleaseMethod : std::false_type {};
+
+template <typename DSPType>
+struct HasReleaseMethod<
+    DSPType, std::void_t<decltype(std::declval<DSPType &>().release())>>
+    : std::true_type {};
+
+template <typename DSPType, typename = void>
+struct HasLatencyMethod : std::false_type {};
+
+template <typename DSPType>
+struct HasLatencyMethod<
+    DSPType,
+    std::void_t<decltype(std::declval<const DSPType &>().getLatencySamples())>>
+    : std::true_type {};
+
 /**
  * A template class to adapt an arbitrary juce::dsp block to a Plugin.
  * Could technically be used with any type that provides prepare,
- * process, and reset methods.
+ * process, and reset methods. If the type also provides a release()
+ * method, it will be called when this plugin is released, and if it provides
+ * a getLatencySamples() method, it's used to report the plugin's latency.
  */
 template <typename DSPType> class JucePlugin : public Plugin {
 public:
@@ -60,7 +89,22 @@ public:
 
   void reset() override final { dspBlock.reset(); }
 
+  void release() override {
+    if constexpr (HasReleaseMethod<DSPType>::value) {
+      dspBlock.release();
+    }
+  }
+
+  int getLatencySamples() const override {
+    if constexpr (HasLatencyMethod<DSPType>::value) {
+      return dspBlock.getLatencySamples();
+    } else {
+      return 0;
+    }
+  }
+
   DSPType &getDSP() { return dspBlock; };
+  const DSPType &getDSP() const { return dspBlock; };
 
 private:
   DSPType dspBlock;
@@ -19,6 +19,9 @@
 
 #include "JuceHeader.h"
 #include <mutex>
+#include <vector>
+
+#include <pybind11/pybind11.h>
 
 namespace Pedalboard {
 /**
@@ -35,9 +38,97 @@ public:
 
   virtual void reset() = 0;
 
+  /**
+   * Free any memory allocated by prepare() for processing audio (delay lines,
+   * FFT buffers, etc.) while keeping this plugin's parameters. This allows
+   * large numbers of idle plugins to be kept in memory cheaply; the next call
+   * to prepare() will re-allocate whatever is needed.
+   *
+   * The caller must hold this plugin's mutex.
+   */
+  virtual void release(){};
+
+  /**
+   * Returns true if this plugin should receive all of its input audio in a
+   * single block, regardless of the buffer size requested by the caller. If
+   * any plugin in a chain returns true, the whole chain is processed this way.
+   */
+  virtual bool processesWholeBuffer() const { return false; }
+
+  /**
+   * Returns the number of samples by which this plugin delays its output
+   * relative to its input. Only valid once prepared. Plugins that mix their
+   * input with a processed copy of it (like Mix) use this to keep both
+   * signals aligned.
+   */
+  virtual int getLatencySamples() const { return 0; }
+
+  /**
+   * Returns the number of samples this plugin outputs for each sample of
+   * input. Plugins that return anything other than 1.0 (like TimeStretch)
+   * are passed separate input and output blocks of different lengths, via
+   * processWithLengthChange() rather than process(). Their latency is
+   * measured in output samples.
+   */
+  virtual double getLengthRatio() const { return 1.0; }
+
+  /**
+   * Consumes all of the samples in input, and fills output. Over the course
+   * of a call to pedalboard.process, the total number of samples requested
+   * is always the total number of samples passed in so far multiplied by
+   * getLengthRatio() (rounded to the nearest sample).
+   */
+  virtual void
+  processWithLengthChange(const juce::dsp::AudioBlock<const float> &input,
+                          juce::dsp::AudioBlock<float> &output) {
+    jassertfalse;
+  }
+
+  /**
+   * Appends any plugins that this plugin calls into while processing (i.e.:
+   * the plugins wrapped by a Mix) to the provided list, recursively, so that
+   * they can be locked along with this plugin.
+   */
+  virtual void appendNestedPlugins(std::vector<Plugin *> &plugins) const {}
+
   // A mutex to gate access to this plugin, as its internals may not be
   // thread-safe. Note: use std::lock or std::scoped_lock when locking multiple
   // plugins to avoid deadlocking.
   std::mutex mutex;
 };
+
+/**
+ * Locks a plugin's mutex from code that may be called by Python with the GIL
+ * held (i.e.: parameter getters and setters). As process() holds the mutex
+ * for as long as it runs, the GIL is released before locking (and reacquired
+ * after unlocking) so that other Python threads can run in the meantime.
+ *
+ * Nothing in the scope of this lock may touch Python objects.
+ */
+class ScopedGILReleasingLock {
+public:
+  explicit ScopedGILReleasingLock(std::mutex &mutex)
+      : gilRelease(), lock(mutex) {}
+
+  ScopedGILReleasingLock(const ScopedGILReleasingLock &) = delete;
+  ScopedGILReleasingLock &operator=(const ScopedGILReleasingLock &) = delete;
+
+private:
+  // Only releases the GIL if this thread holds it; parameters may also be
+  // set from C++ code that's already running without the GIL.
+  struct GILRelease {
+    GILRelease()
+        : threadState(PyGILState_Check() ? PyEval_SaveThread() : nullptr) {}
+    ~GILRelease() {
+      if (threadState)
+        PyEval_RestoreThread(threadState);
+    }
+    PyThreadState *const threadState;
+  };
+
+  // Declared in this order so that the mutex is unlocked before the GIL is
+  // reacquired, as other threads may hold the GIL while waiting for it.
+  GILRelease gilRelease;
+  std::lock_guard<std::mutex> lock;
+};
 } // namespace Pedalboard
\ No newline at end of file
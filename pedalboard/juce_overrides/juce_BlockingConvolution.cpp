@@ -1,5 +1,39 @@
 #include "juce_BlockingConvolution.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <list>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(_M_AMD64)
+// Wheels are built for baseline x86-64 (SSE2), so the AVX2 and FMA kernel is
+// compiled separately and only called if the CPU supports it.
+#define PEDALBOARD_HAS_AVX2_KERNEL 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define PEDALBOARD_TARGET_AVX2_FMA
+#else
+#define PEDALBOARD_TARGET_AVX2_FMA __attribute__((target("avx2,fma")))
+#endif
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#if JUCE_MAC || JUCE_LINUX || JUCE_BSD
+#include <sys/mman.h>
+#endif
+
 /*
   ==============================================================================
 
@@ -36,84 +70,280 @@ namespace juce {
 namespace dsp {
 
 //==============================================================================
-//==============================================================================
-struct ConvolutionEngine {
-  ConvolutionEngine(const float *samples, size_t numSamples,
-                    size_t maxBlockSize)
-      : blockSize((size_t)nextPowerOfTwo((int)maxBlockSize)),
-        fftSize(blockSize > 128 ? 2 * blockSize : 4 * blockSize),
-        fftObject(std::make_unique<FFT>(roundToInt(std::log2(fftSize)))),
-        numSegments(numSamples / (fftSize - blockSize) + 1u),
-        numInputSegments((blockSize > 128 ? numSegments : 3 * numSegments)),
-        bufferInput(1, static_cast<int>(fftSize)),
-        bufferOutput(1, static_cast<int>(fftSize * 2)),
-        bufferTempOutput(1, static_cast<int>(fftSize * 2)),
-        bufferOverlap(1, static_cast<int>(fftSize)) {
-    bufferOutput.clear();
+// Computes out += a * b for the remaining complex numbers from index i.
+static inline void
+complexMultiplyAccumulateScalar(const float *aReal, const float *aImag,
+                                const float *bReal, const float *bImag,
+                                float *outReal, float *outImag, size_t i,
+                                size_t numBins) noexcept {
+  for (; i < numBins; ++i) {
+    const auto ar = aReal[i], ai = aImag[i], br = bReal[i], bi = bImag[i];
+    outReal[i] += ar * br - ai * bi;
+    outImag[i] += ar * bi + ai * br;
+  }
+}
 
-    auto updateSegmentsIfNecessary =
-        [this](size_t numSegmentsToUpdate,
-               std::vector<AudioBuffer<float>> &segments) {
-          if (numSegmentsToUpdate == 0 ||
-              numSegmentsToUpdate != (size_t)segments.size() ||
-              (size_t)segments[0].getNumSamples() != fftSize * 2) {
-            segments.clear();
+#if PEDALBOARD_HAS_AVX2_KERNEL
+PEDALBOARD_TARGET_AVX2_FMA static void complexMultiplyAccumulateAVX2(
+    const float *aReal, const float *aImag, const float *bReal,
+    const float *bImag, float *outReal, float *outImag,
+    size_t numBins) noexcept {
+  size_t i = 0;
+  for (; i + 8 <= numBins; i += 8) {
+    const auto ar = _mm256_loadu_ps(aReal + i);
+    const auto ai = _mm256_loadu_ps(aImag + i);
+    const auto br = _mm256_loadu_ps(bReal + i);
+    const auto bi = _mm256_loadu_ps(bImag + i);
+
+    auto real = _mm256_loadu_ps(outReal + i);
+    auto imag = _mm256_loadu_ps(outImag + i);
+    real = _mm256_fnmadd_ps(ai, bi, _mm256_fmadd_ps(ar, br, real));
+    imag = _mm256_fmadd_ps(ai, br, _mm256_fmadd_ps(ar, bi, imag));
+    _mm256_storeu_ps(outReal + i, real);
+    _mm256_storeu_ps(outImag + i, imag);
+  }
 
-            for (size_t i = 0; i < numSegmentsToUpdate; ++i)
-              segments.push_back({1, static_cast<int>(fftSize * 2)});
-          }
-        };
+  complexMultiplyAccumulateScalar(aReal, aImag, bReal, bImag, outReal,
+                                  outImag, i, numBins);
+}
+
+// Checks for AVX2 and FMA support in both the CPU and the OS (which has to
+// save the upper halves of the YMM registers).
+static bool cpuSupportsAVX2AndFMA() noexcept {
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    return false;
+
+  __cpuid(info, 1);
+  const bool hasFMA = (info[2] & (1 << 12)) != 0;
+  const bool hasOSXSAVE = (info[2] & (1 << 27)) != 0;
+  const bool hasAVX = (info[2] & (1 << 28)) != 0;
+  if (!hasFMA || !hasOSXSAVE || !hasAVX || (_xgetbv(0) & 6) != 6)
+    return false;
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+#endif
+
+// Computes out += a * b for numBins complex numbers with the baseline
+// instruction set for this platform: SSE2 on x86-64, NEON on ARM.
+static void complexMultiplyAccumulateBaseline(
+    const float *aReal, const float *aImag, const float *bReal,
+    const float *bImag, float *outReal, float *outImag,
+    size_t numBins) noexcept {
+  size_t i = 0;
+
+#if PEDALBOARD_HAS_AVX2_KERNEL || defined(__SSE2__)
+  for (; i + 4 <= numBins; i += 4) {
+    const auto ar = _mm_loadu_ps(aReal + i);
+    const auto ai = _mm_loadu_ps(aImag + i);
+    const auto br = _mm_loadu_ps(bReal + i);
+    const auto bi = _mm_loadu_ps(bImag + i);
+
+    const auto real = _mm_sub_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi));
+    const auto imag = _mm_add_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br));
+    _mm_storeu_ps(outReal + i, _mm_add_ps(_mm_loadu_ps(outReal + i), real));
+    _mm_storeu_ps(outImag + i, _mm_add_ps(_mm_loadu_ps(outImag + i), imag));
+  }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  for (; i + 4 <= numBins; i += 4) {
+    const auto ar = vld1q_f32(aReal + i);
+    const auto ai = vld1q_f32(aImag + i);
+    const auto br = vld1q_f32(bReal + i);
+    const auto bi = vld1q_f32(bImag + i);
+
+    auto real = vld1q_f32(outReal + i);
+    auto imag = vld1q_f32(outImag + i);
+#if defined(__aarch64__)
+    real = vfmsq_f32(vfmaq_f32(real, ar, br), ai, bi);
+    imag = vfmaq_f32(vfmaq_f32(imag, ar, bi), ai, br);
+#else
+    real = vmlsq_f32(vmlaq_f32(real, ar, br), ai, bi);
+    imag = vmlaq_f32(vmlaq_f32(imag, ar, bi), ai, br);
+#endif
+    vst1q_f32(outReal + i, real);
+    vst1q_f32(outImag + i, imag);
+  }
+#endif
+
+  complexMultiplyAccumulateScalar(aReal, aImag, bReal, bImag, outReal,
+                                  outImag, i, numBins);
+}
+
+// Computes out += a * b as JUCE's ConvolutionEngine does, with four
+// FloatVectorOperations passes over the data. Only used for benchmarking.
+static void complexMultiplyAccumulateReference(
+    const float *aReal, const float *aImag, const float *bReal,
+    const float *bImag, float *outReal, float *outImag,
+    size_t numBins) noexcept {
+  const auto n = static_cast<int>(numBins);
+  FloatVectorOperations::addWithMultiply(outReal, aReal, bReal, n);
+  FloatVectorOperations::subtractWithMultiply(outReal, aImag, bImag, n);
+  FloatVectorOperations::addWithMultiply(outImag, aReal, bImag, n);
+  FloatVectorOperations::addWithMultiply(outImag, aImag, bReal, n);
+}
+
+static std::atomic<bool> useReferenceMultiplyAccumulate{false};
 
-    updateSegmentsIfNecessary(numInputSegments, buffersInputSegments);
-    updateSegmentsIfNecessary(numSegments, buffersImpulseSegments);
+void BlockingConvolution::setUseReferenceMultiplyAccumulate(bool useReference) {
+  useReferenceMultiplyAccumulate = useReference;
+}
 
+//==============================================================================
+// Computes out += a * b for numBins complex numbers, where the real and
+// imaginary parts of each operand are stored in separate arrays (as arranged
+// by ConvolutionEngine::prepareForConvolution). This does the same work as
+// four FloatVectorOperations calls, but in a single pass, reading each input
+// and output value only once.
+static void complexMultiplyAccumulate(const float *aReal, const float *aImag,
+                                      const float *bReal, const float *bImag,
+                                      float *outReal, float *outImag,
+                                      size_t numBins) noexcept {
+  if (useReferenceMultiplyAccumulate.load(std::memory_order_relaxed)) {
+    complexMultiplyAccumulateReference(aReal, aImag, bReal, bImag, outReal,
+                                       outImag, numBins);
+    return;
+  }
+
+#if PEDALBOARD_HAS_AVX2_KERNEL
+  static const bool hasAVX2AndFMA = cpuSupportsAVX2AndFMA();
+  if (hasAVX2AndFMA) {
+    complexMultiplyAccumulateAVX2(aReal, aImag, bReal, bImag, outReal,
+                                  outImag, numBins);
+    return;
+  }
+#endif
+
+  complexMultiplyAccumulateBaseline(aReal, aImag, bReal, bImag, outReal,
+                                    outImag, numBins);
+}
+
+//==============================================================================
+struct ConvolutionEngine {
+  ConvolutionEngine(const float *samples, size_t numSamples,
+                    size_t maxBlockSize)
+      : ConvolutionEngine(&samples, 1, numSamples, maxBlockSize) {}
+
+  // Convolves one input with several impulse responses of the same length
+  // (i.e.: the paths from one input channel of a true-stereo impulse
+  // response), producing one output per impulse response. The input is only
+  // transformed once per block, then shared by every path.
+  ConvolutionEngine(const float *const *samples, size_t numPathsIn,
+                    size_t numSamples, size_t maxBlockSize)
+      : ConvolutionEngine(numSamples, maxBlockSize, numPathsIn, true) {
     auto FFTTempObject = std::make_unique<FFT>(roundToInt(std::log2(fftSize)));
-    size_t currentPtr = 0;
 
-    for (auto &buf : buffersImpulseSegments) {
-      buf.clear();
+    for (size_t path = 0; path < numPaths; ++path) {
+      size_t currentPtr = 0;
 
-      auto *impulseResponse = buf.getWritePointer(0);
+      for (size_t segment = 0; segment < numSegments; ++segment) {
+        auto *impulseResponse =
+            alignedSegments + getImpulseSegmentOffset(segment, path);
 
-      if (&buf == &buffersImpulseSegments.front())
-        impulseResponse[0] = 1.0f;
+        if (segment == 0)
+          impulseResponse[0] = 1.0f;
 
-      FloatVectorOperations::copy(
-          impulseResponse, samples + currentPtr,
-          static_cast<int>(jmin(fftSize - blockSize, numSamples - currentPtr)));
+        FloatVectorOperations::copy(
+            impulseResponse, samples[path] + currentPtr,
+            static_cast<int>(
+                jmin(fftSize - blockSize, numSamples - currentPtr)));
 
-      FFTTempObject->performRealOnlyForwardTransform(impulseResponse);
-      prepareForConvolution(impulseResponse);
+        FFTTempObject->performRealOnlyForwardTransform(impulseResponse);
+        prepareForConvolution(impulseResponse);
 
-      currentPtr += (fftSize - blockSize);
+        currentPtr += (fftSize - blockSize);
+      }
     }
 
     reset();
   }
 
+  // Uses impulse segments that have already been transformed (i.e.: by
+  // another engine with the same numSamples and maxBlockSize), which must
+  // stay valid for as long as this engine exists. Typically, these are in a
+  // memory-mapped partition cache file, which `owner` keeps open.
+  ConvolutionEngine(const float *precomputedImpulseSegments,
+                    std::shared_ptr<const void> owner, size_t numSamples,
+                    size_t maxBlockSize)
+      : ConvolutionEngine(numSamples, maxBlockSize, 1, false) {
+    impulseSegments = precomputedImpulseSegments;
+    impulseSegmentsOwner = std::move(owner);
+    reset();
+  }
+
+private:
+  ConvolutionEngine(size_t numSamples, size_t maxBlockSize, size_t numPathsIn,
+                    bool allocateImpulseSegments)
+      : blockSize((size_t)nextPowerOfTwo((int)maxBlockSize)),
+        fftSize(blockSize > 128 ? 2 * blockSize : 4 * blockSize),
+        fftObject(std::make_unique<FFT>(roundToInt(std::log2(fftSize)))),
+        numSegments(numSamples / (fftSize - blockSize) + 1u),
+        numInputSegments((blockSize > 128 ? numSegments : 3 * numSegments)),
+        numPaths(numPathsIn), numResidentSegments(numSegments),
+        bufferInput(1, static_cast<int>(fftSize)),
+        bufferOutput((int)numPaths, static_cast<int>(fftSize * 2)),
+        bufferTempOutput((int)numPaths, static_cast<int>(fftSize * 2)),
+        bufferOverlap((int)numPaths, static_cast<int>(fftSize)),
+        segmentStride(((fftSize * 2 + segmentAlignmentInFloats - 1) /
+                       segmentAlignmentInFloats) *
+                      segmentAlignmentInFloats) {
+    bufferOutput.clear();
+
+    // All input and impulse segments live in one contiguous, aligned arena
+    // (rather than in one heap allocation per segment) so that accumulating
+    // across hundreds of partitions streams predictably through the cache.
+    segmentArena.calloc(
+        (numInputSegments +
+         (allocateImpulseSegments ? numPaths * numSegments : 0)) *
+            segmentStride +
+        segmentAlignmentInFloats);
+    const auto misalignment = reinterpret_cast<uintptr_t>(segmentArena.get()) %
+                              segmentAlignmentInBytes;
+    alignedSegments =
+        segmentArena.get() +
+        (misalignment == 0
+             ? 0
+             : (segmentAlignmentInBytes - misalignment) / sizeof(float));
+
+    if (allocateImpulseSegments)
+      impulseSegments = alignedSegments + getImpulseSegmentOffset(0, 0);
+  }
+
+public:
   void reset() {
     bufferInput.clear();
     bufferOverlap.clear();
     bufferTempOutput.clear();
     bufferOutput.clear();
 
-    for (auto &buf : buffersInputSegments)
-      buf.clear();
+    FloatVectorOperations::clear(getInputSegment(0),
+                                 static_cast<int>(numInputSegments *
+                                                  segmentStride));
 
     currentSegment = 0;
     inputDataPos = 0;
   }
 
   void processSamples(const float *input, float *output, size_t numSamples) {
+    processSamples(input, &output, numSamples);
+  }
+
+  // Writes one output per path. These must all be distinct, but any of them
+  // may be the same as the input.
+  void processSamples(const float *input, float *const *outputs,
+                      size_t numSamples) {
     // Overlap-add, zero latency convolution algorithm with uniform partitioning
     size_t numSamplesProcessed = 0;
 
     auto indexStep = numInputSegments / numSegments;
 
     auto *inputData = bufferInput.getWritePointer(0);
-    auto *outputTempData = bufferTempOutput.getWritePointer(0);
-    auto *outputData = bufferOutput.getWritePointer(0);
-    auto *overlapData = bufferOverlap.getWritePointer(0);
 
     while (numSamplesProcessed < numSamples) {
       const bool inputDataWasEmpty = (inputDataPos == 0);
@@ -124,47 +354,51 @@ struct ConvolutionEngine {
                                   input + numSamplesProcessed,
                                   static_cast<int>(numSamplesToProcess));
 
-      auto *inputSegmentData =
-          buffersInputSegments[currentSegment].getWritePointer(0);
+      auto *inputSegmentData = getInputSegment(currentSegment);
       FloatVectorOperations::copy(inputSegmentData, inputData,
                                   static_cast<int>(fftSize));
 
       fftObject->performRealOnlyForwardTransform(inputSegmentData);
       prepareForConvolution(inputSegmentData);
 
-      // Complex multiplication
-      if (inputDataWasEmpty) {
-        FloatVectorOperations::fill(outputTempData, 0,
-                                    static_cast<int>(fftSize + 1));
+      for (size_t path = 0; path < numPaths; ++path) {
+        auto *outputTempData = bufferTempOutput.getWritePointer((int)path);
+        auto *outputData = bufferOutput.getWritePointer((int)path);
+        auto *overlapData = bufferOverlap.getWritePointer((int)path);
+
+        // Complex multiplication
+        if (inputDataWasEmpty) {
+          FloatVectorOperations::fill(outputTempData, 0,
+                                      static_cast<int>(fftSize + 1));
 
-        auto index = currentSegment;
+          auto index = currentSegment;
 
-        for (size_t i = 1; i < numSegments; ++i) {
-          index += indexStep;
+          for (size_t i = 1; i < numSegments; ++i) {
+            index += indexStep;
 
-          if (index >= numInputSegments)
-            index -= numInputSegments;
+            if (index >= numInputSegments)
+              index -= numInputSegments;
 
-          convolutionProcessingAndAccumulate(
-              buffersInputSegments[index].getWritePointer(0),
-              buffersImpulseSegments[i].getWritePointer(0), outputTempData);
+            convolutionProcessingAndAccumulate(
+                getInputSegment(index), getImpulseSegment(i, path),
+                outputTempData);
+          }
         }
-      }
 
-      FloatVectorOperations::copy(outputData, outputTempData,
-                                  static_cast<int>(fftSize + 1));
+        FloatVectorOperations::copy(outputData, outputTempData,
+                                    static_cast<int>(fftSize + 1));
 
-      convolutionProcessingAndAccumulate(
-          inputSegmentData, buffersImpulseSegments.front().getWritePointer(0),
-          outputData);
+        convolutionProcessingAndAccumulate(
+            inputSegmentData, getImpulseSegment(0, path), outputData);
 
-      updateSymmetricFrequencyDomainData(outputData);
-      fftObject->performRealOnlyInverseTransform(outputData);
+        updateSymmetricFrequencyDomainData(outputData);
+        fftObject->performRealOnlyInverseTransform(outputData);
 
-      // Add overlap
-      FloatVectorOperations::add(
-          &output[numSamplesProcessed], &outputData[inputDataPos],
-          &overlapData[inputDataPos], (int)numSamplesToProcess);
+        // Add overlap
+        FloatVectorOperations::add(
+            &outputs[path][numSamplesProcessed], &outputData[inputDataPos],
+            &overlapData[inputDataPos], (int)numSamplesToProcess);
+      }
 
       // Input buffer full => Next block
       inputDataPos += numSamplesToProcess;
@@ -175,14 +409,19 @@ struct ConvolutionEngine {
 
         inputDataPos = 0;
 
-        // Extra step for segSize > blockSize
-        FloatVectorOperations::add(&(outputData[blockSize]),
-                                   &(overlapData[blockSize]),
-                                   static_cast<int>(fftSize - 2 * blockSize));
+        for (size_t path = 0; path < numPaths; ++path) {
+          auto *outputData = bufferOutput.getWritePointer((int)path);
+          auto *overlapData = bufferOverlap.getWritePointer((int)path);
+
+          // Extra step for segSize > blockSize
+          FloatVectorOperations::add(&(outputData[blockSize]),
+                                     &(overlapData[blockSize]),
+                                     static_cast<int>(fftSize - 2 * blockSize));
 
-        // Save the overlap
-        FloatVectorOperations::copy(overlapData, &(outputData[blockSize]),
-                                    static_cast<int>(fftSize - blockSize));
+          // Save the overlap
+          FloatVectorOperations::copy(overlapData, &(outputData[blockSize]),
+                                      static_cast<int>(fftSize - blockSize));
+        }
 
         currentSegment = (currentSegment > 0) ? (currentSegment - 1)
                                               : (numInputSegments - 1);
@@ -194,15 +433,18 @@ struct ConvolutionEngine {
 
   void processSamplesWithAddedLatency(const float *input, float *output,
                                       size_t numSamples) {
+    processSamplesWithAddedLatency(input, &output, numSamples);
+  }
+
+  void processSamplesWithAddedLatency(const float *input,
+                                      float *const *outputs,
+                                      size_t numSamples) {
     // Overlap-add, zero latency convolution algorithm with uniform partitioning
     size_t numSamplesProcessed = 0;
 
     auto indexStep = numInputSegments / numSegments;
 
     auto *inputData = bufferInput.getWritePointer(0);
-    auto *outputTempData = bufferTempOutput.getWritePointer(0);
-    auto *outputData = bufferOutput.getWritePointer(0);
-    auto *overlapData = bufferOverlap.getWritePointer(0);
 
     while (numSamplesProcessed < numSamples) {
       auto numSamplesToProcess =
@@ -212,9 +454,11 @@ struct ConvolutionEngine {
                                   input + numSamplesProcessed,
                                   static_cast<int>(numSamplesToProcess));
 
-      FloatVectorOperations::copy(output + numSamplesProcessed,
-                                  outputData + inputDataPos,
-                                  static_cast<int>(numSamplesToProcess));
+      for (size_t path = 0; path < numPaths; ++path)
+        FloatVectorOperations::copy(
+            outputs[path] + numSamplesProcessed,
+            bufferOutput.getReadPointer((int)path) + inputDataPos,
+            static_cast<int>(numSamplesToProcess));
 
       numSamplesProcessed += numSamplesToProcess;
       inputDataPos += numSamplesToProcess;
@@ -222,57 +466,61 @@ struct ConvolutionEngine {
       // processing itself when needed (with latency)
       if (inputDataPos == blockSize) {
         // Copy input data in input segment
-        auto *inputSegmentData =
-            buffersInputSegments[currentSegment].getWritePointer(0);
+        auto *inputSegmentData = getInputSegment(currentSegment);
         FloatVectorOperations::copy(inputSegmentData, inputData,
                                     static_cast<int>(fftSize));
 
         fftObject->performRealOnlyForwardTransform(inputSegmentData);
         prepareForConvolution(inputSegmentData);
 
-        // Complex multiplication
-        FloatVectorOperations::fill(outputTempData, 0,
-                                    static_cast<int>(fftSize + 1));
+        for (size_t path = 0; path < numPaths; ++path) {
+          auto *outputTempData = bufferTempOutput.getWritePointer((int)path);
+          auto *outputData = bufferOutput.getWritePointer((int)path);
+          auto *overlapData = bufferOverlap.getWritePointer((int)path);
+
+          // Complex multiplication
+          FloatVectorOperations::fill(outputTempData, 0,
+                                      static_cast<int>(fftSize + 1));
 
-        auto index = currentSegment;
+          auto index = currentSegment;
 
-        for (size_t i = 1; i < numSegments; ++i) {
-          index += indexStep;
+          for (size_t i = 1; i < numSegments; ++i) {
+            index += indexStep;
+
+            if (index >= numInputSegments)
+              index -= numInputSegments;
+
+            convolutionProcessingAndAccumulate(getInputSegment(index),
+                                               getImpulseSegment(i, path),
+                                               outputTempData);
+          }
 
-          if (index >= numInputSegments)
-            index -= numInputSegments;
+          FloatVectorOperations::copy(outputData, outputTempData,
+                                      static_cast<int>(fftSize + 1));
 
           convolutionProcessingAndAccumulate(
-              buffersInputSegments[index].getWritePointer(0),
-              buffersImpulseSegments[i].getWritePointer(0), outputTempData);
-        }
+              inputSegmentData, getImpulseSegment(0, path), outputData);
 
-        FloatVectorOperations::copy(outputData, outputTempData,
-                                    static_cast<int>(fftSize + 1));
+          updateSymmetricFrequencyDomainData(outputData);
+          fftObject->performRealOnlyInverseTransform(outputData);
 
-        convolutionProcessingAndAccumulate(
-            inputSegmentData, buffersImpulseSegments.front().getWritePointer(0),
-            outputData);
+          // Add overlap
+          FloatVectorOperations::add(outputData, overlapData,
+                                     static_cast<int>(blockSize));
 
-        updateSymmetricFrequencyDomainData(outputData);
-        fftObject->performRealOnlyInverseTransform(outputData);
+          // Extra step for segSize > blockSize
+          FloatVectorOperations::add(&(outputData[blockSize]),
+                                     &(overlapData[blockSize]),
+                                     static_cast<int>(fftSize - 2 * blockSize));
 
-        // Add overlap
-        FloatVectorOperations::add(outputData, overlapData,
-                                   static_cast<int>(blockSize));
+          // Save the overlap
+          FloatVectorOperations::copy(overlapData, &(outputData[blockSize]),
+                                      static_cast<int>(fftSize - blockSize));
+        }
 
         // Input buffer is empty again now
         FloatVectorOperations::fill(inputData, 0.0f, static_cast<int>(fftSize));
 
-        // Extra step for segSize > blockSize
-        FloatVectorOperations::add(&(outputData[blockSize]),
-                                   &(overlapData[blockSize]),
-                                   static_cast<int>(fftSize - 2 * blockSize));
-
-        // Save the overlap
-        FloatVectorOperations::copy(overlapData, &(outputData[blockSize]),
-                                    static_cast<int>(fftSize - blockSize));
-
         currentSegment = (currentSegment > 0) ? (currentSegment - 1)
                                               : (numInputSegments - 1);
 
@@ -281,8 +529,9 @@ struct ConvolutionEngine {
     }
   }
 
-  // After each FFT, this function is called to allow convolution to be
-  // performed with only 4 SIMD functions calls.
+  // After each FFT, this function is called to split the real and imaginary
+  // parts of each bin into two contiguous halves, allowing convolution to be
+  // performed in a single SIMD pass (see complexMultiplyAccumulate).
   void prepareForConvolution(float *samples) noexcept {
     auto FFTSizeDiv2 = fftSize / 2;
 
@@ -301,18 +550,9 @@ struct ConvolutionEngine {
                                           const float *impulse, float *output) {
     auto FFTSizeDiv2 = fftSize / 2;
 
-    FloatVectorOperations::addWithMultiply(output, input, impulse,
-                                           static_cast<int>(FFTSizeDiv2));
-    FloatVectorOperations::subtractWithMultiply(output, &(input[FFTSizeDiv2]),
-                                                &(impulse[FFTSizeDiv2]),
-                                                static_cast<int>(FFTSizeDiv2));
-
-    FloatVectorOperations::addWithMultiply(&(output[FFTSizeDiv2]), input,
-                                           &(impulse[FFTSizeDiv2]),
-                                           static_cast<int>(FFTSizeDiv2));
-    FloatVectorOperations::addWithMultiply(&(output[FFTSizeDiv2]),
-                                           &(input[FFTSizeDiv2]), impulse,
-                                           static_cast<int>(FFTSizeDiv2));
+    complexMultiplyAccumulate(input, &(input[FFTSizeDiv2]), impulse,
+                              &(impulse[FFTSizeDiv2]), output,
+                              &(output[FFTSizeDiv2]), FFTSizeDiv2);
 
     output[fftSize] += input[fftSize] * impulse[fftSize];
   }
@@ -343,12 +583,267 @@ struct ConvolutionEngine {
   const std::unique_ptr<FFT> fftObject;
   const size_t numSegments;
   const size_t numInputSegments;
+  const size_t numPaths;
+  // Impulse segments from this index onwards may be stored on disk instead;
+  // see moveImpulseSegmentsToDisk.
+  size_t numResidentSegments;
   size_t currentSegment = 0, inputDataPos = 0;
 
   AudioBuffer<float> bufferInput, bufferOutput, bufferTempOutput, bufferOverlap;
-  std::vector<AudioBuffer<float>> buffersInputSegments, buffersImpulseSegments;
+
+  // Frequency-domain segments: numInputSegments input segments followed by
+  // numSegments impulse segments per path, each starting on a 64-byte
+  // boundary.
+  // The impulse segments may instead live outside of the arena; see the
+  // constructor that takes precomputed segments.
+  static constexpr size_t segmentAlignmentInBytes = 64;
+  static constexpr size_t segmentAlignmentInFloats =
+      segmentAlignmentInBytes / sizeof(float);
+  const size_t segmentStride;
+  HeapBlock<float> segmentArena;
+  float *alignedSegments = nullptr;
+  const float *impulseSegments = nullptr;
+  std::shared_ptr<const void> impulseSegmentsOwner;
+
+  // A temporary file holding the impulse segments that have been moved to
+  // disk, which is deleted once it's no longer mapped.
+  struct SpilledImpulseSegments {
+    explicit SpilledImpulseSegments(const File &fileIn) : file(fileIn) {}
+    ~SpilledImpulseSegments() {
+      mapping.reset();
+      file.deleteFile();
+    }
+
+    const File file;
+    std::unique_ptr<MemoryMappedFile> mapping;
+  };
+
+  const float *spilledImpulseSegments = nullptr;
+  std::unique_ptr<SpilledImpulseSegments> spilledImpulseSegmentsFile;
+
+  float *getInputSegment(size_t index) noexcept {
+    return alignedSegments + index * segmentStride;
+  }
+
+  const float *getImpulseSegment(size_t index,
+                                 size_t path = 0) const noexcept {
+    if (index < numResidentSegments)
+      return impulseSegments +
+             (path * numResidentSegments + index) * segmentStride;
+
+    const auto numSpilledSegments = numSegments - numResidentSegments;
+    return spilledImpulseSegments +
+           (path * numSpilledSegments + index - numResidentSegments) *
+               segmentStride;
+  }
+
+  // All impulse segments, back-to-back, as stored in a partition cache file.
+  const float *getImpulseSegments() const noexcept {
+    jassert(numResidentSegments == numSegments);
+    return impulseSegments;
+  }
+  size_t getImpulseSegmentsSize() const noexcept {
+    return numPaths * numSegments * segmentStride;
+  }
+
+  // Moves every impulse segment after the first numToKeep into a temporary,
+  // memory-mapped file in the given directory, freeing the memory they used.
+  // As the segments are accumulated in order, the OS can then page them in
+  // (and evict them again) sequentially, at the cost of extra I/O if they
+  // don't stay in the page cache. Returns false if this wasn't possible, in
+  // which case the engine is left unchanged.
+  bool moveImpulseSegmentsToDisk(size_t numToKeep, const File &directory) {
+    numToKeep = jmax((size_t)1, numToKeep);
+    if (numToKeep >= numSegments || impulseSegmentsOwner != nullptr ||
+        numResidentSegments != numSegments)
+      return false;
+
+    const auto numSpilledSegments = numSegments - numToKeep;
+    const auto spilledSizePerPath = numSpilledSegments * segmentStride;
+
+    auto spilled = std::make_unique<SpilledImpulseSegments>(
+        directory.getNonexistentChildFile("pedalboard_impulse_response",
+                                          ".tmp", false));
+    {
+      FileOutputStream stream(spilled->file);
+      if (!stream.openedOk())
+        return false;
+
+      for (size_t path = 0; path < numPaths; ++path)
+        if (!stream.write(getImpulseSegment(numToKeep, path),
+                          spilledSizePerPath * sizeof(float)))
+          return false;
+
+      stream.flush();
+      if (stream.getStatus().failed())
+        return false;
+    }
+
+    spilled->mapping = std::make_unique<MemoryMappedFile>(
+        spilled->file, MemoryMappedFile::readOnly);
+    if (spilled->mapping->getData() == nullptr ||
+        spilled->mapping->getSize() !=
+            numPaths * spilledSizePerPath * sizeof(float))
+      return false;
+
+#if JUCE_MAC || JUCE_LINUX || JUCE_BSD
+    posix_madvise(spilled->mapping->getData(), spilled->mapping->getSize(),
+                  POSIX_MADV_SEQUENTIAL);
+#endif
+
+    // Shrink the arena down to the input segments and the segments we kept.
+    HeapBlock<float> newArena;
+    newArena.calloc((numInputSegments + numPaths * numToKeep) * segmentStride +
+                    segmentAlignmentInFloats);
+    const auto misalignment = reinterpret_cast<uintptr_t>(newArena.get()) %
+                              segmentAlignmentInBytes;
+    auto *newAlignedSegments =
+        newArena.get() +
+        (misalignment == 0
+             ? 0
+             : (segmentAlignmentInBytes - misalignment) / sizeof(float));
+
+    FloatVectorOperations::copy(newAlignedSegments, alignedSegments,
+                                (int)(numInputSegments * segmentStride));
+    for (size_t path = 0; path < numPaths; ++path)
+      FloatVectorOperations::copy(
+          newAlignedSegments + (numInputSegments + path * numToKeep) *
+                                   segmentStride,
+          getImpulseSegment(0, path), (int)(numToKeep * segmentStride));
+
+    segmentArena.swapWith(newArena);
+    alignedSegments = newAlignedSegments;
+    impulseSegments = alignedSegments + numInputSegments * segmentStride;
+    spilledImpulseSegments =
+        static_cast<const float *>(spilled->mapping->getData());
+    spilledImpulseSegmentsFile = std::move(spilled);
+    numResidentSegments = numToKeep;
+    return true;
+  }
+
+private:
+  size_t getImpulseSegmentOffset(size_t index, size_t path) const noexcept {
+    return (numInputSegments + path * numSegments + index) * segmentStride;
+  }
 };
 
+//==============================================================================
+// A time-domain (direct form) FIR filter, used instead of ConvolutionEngine
+// for very short impulse responses. For these, the cost of the FFTs and the
+// overlap-add bookkeeping per block outweighs the convolution itself, while
+// a direct-form FIR needs just one vectorized multiply-add pass per tap.
+// Like ConvolutionEngine's zero-latency mode, this adds no latency.
+struct DirectFormEngine {
+  DirectFormEngine(const float *samples, size_t numSamples,
+                   size_t maxBlockSizeIn)
+      : numTaps(jmax((size_t)1, numSamples)), maxBlockSize(maxBlockSizeIn),
+        taps(1, static_cast<int>(numTaps)),
+        history(1, static_cast<int>(numTaps - 1 + maxBlockSize)) {
+    taps.clear();
+    FloatVectorOperations::copy(taps.getWritePointer(0), samples,
+                                static_cast<int>(numSamples));
+    reset();
+  }
+
+  void reset() { history.clear(); }
+
+  // Input and output may point to the same buffer.
+  void processSamples(const float *input, float *output, size_t numSamples) {
+    const auto *tapData = taps.getReadPointer(0);
+    auto *historyData = history.getWritePointer(0);
+    const auto historyLength = numTaps - 1;
+
+    for (size_t offset = 0; offset < numSamples; offset += maxBlockSize) {
+      const auto numToProcess = jmin(maxBlockSize, numSamples - offset);
+
+      // The history buffer holds the last (numTaps - 1) input samples,
+      // followed by this chunk of input:
+      FloatVectorOperations::copy(historyData + historyLength, input + offset,
+                                  static_cast<int>(numToProcess));
+
+      // y[n] = sum_k(h[k] * x[n - k]), computed one tap at a time over the
+      // whole chunk so that each pass is a single vectorized operation.
+      float *chunkOutput = output + offset;
+      FloatVectorOperations::multiply(chunkOutput, historyData + historyLength,
+                                      tapData[0],
+                                      static_cast<int>(numToProcess));
+      for (size_t k = 1; k < numTaps; ++k)
+        FloatVectorOperations::addWithMultiply(
+            chunkOutput, historyData + historyLength - k, tapData[k],
+            static_cast<int>(numToProcess));
+
+      // Keep the most recent (numTaps - 1) samples for the next chunk.
+      std::memmove(historyData, historyData + numToProcess,
+                   historyLength * sizeof(float));
+    }
+  }
+
+  const size_t numTaps;
+  const size_t maxBlockSize;
+  AudioBuffer<float> taps, history;
+};
+
+// Returns the longest impulse response (in samples) that's convolved with a
+// DirectFormEngine rather than a zero-latency ConvolutionEngine, or 0 if the
+// FFT is always faster.
+//
+// This depends on the CPU (and its SIMD support), so it's measured once per
+// process, on first use, at a typical block size: per sample, the direct
+// form's cost is fixed while the FFT engine's grows slowly with the block
+// size, so larger blocks err slightly towards the FFT. Building with
+// PEDALBOARD_DIRECT_FORM_CROSSOVER_LENGTH skips the measurement, for
+// reproducible output across machines.
+size_t BlockingConvolution::getDirectFormCrossoverLength() {
+#ifdef PEDALBOARD_DIRECT_FORM_CROSSOVER_LENGTH
+  return PEDALBOARD_DIRECT_FORM_CROSSOVER_LENGTH;
+#else
+  static std::once_flag measured;
+  static size_t crossover = 0;
+
+  std::call_once(measured, []() {
+    static constexpr size_t candidateLengths[] = {8, 16, 32, 64, 128, 256};
+    static constexpr size_t longestCandidateLength = 256;
+    static constexpr size_t blockSize = 512;
+    static constexpr size_t numBlocks = 32;
+
+    AudioBuffer<float> signal(1, (int)blockSize);
+    AudioBuffer<float> impulse(1, (int)longestCandidateLength);
+    Random random(0x5eed);
+    for (int i = 0; i < signal.getNumSamples(); ++i)
+      signal.setSample(0, i, random.nextFloat() * 2.0f - 1.0f);
+    for (int i = 0; i < impulse.getNumSamples(); ++i)
+      impulse.setSample(0, i, random.nextFloat() * 2.0f - 1.0f);
+
+    const auto timeEngine = [&](auto &engine) {
+      auto *data = signal.getWritePointer(0);
+      // Take the fastest of a few runs, to reduce noise from other threads.
+      int64 fastest = std::numeric_limits<int64>::max();
+      for (int run = 0; run < 3; ++run) {
+        const auto start = Time::getHighResolutionTicks();
+        for (size_t i = 0; i < numBlocks; ++i)
+          engine.processSamples(data, data, blockSize);
+        fastest = jmin(fastest, Time::getHighResolutionTicks() - start);
+      }
+      return fastest;
+    };
+
+    for (auto length : candidateLengths) {
+      ConvolutionEngine fftEngine(impulse.getReadPointer(0), length,
+                                  blockSize);
+      DirectFormEngine directEngine(impulse.getReadPointer(0), length,
+                                    blockSize);
+
+      if (timeEngine(directEngine) >= timeEngine(fftEngine))
+        break;
+
+      crossover = length;
+    }
+  });
+
+  return crossover;
+#endif
+}
+
 //==============================================================================
 class MultichannelEngine {
 public:
@@ -367,12 +862,34 @@ public:
           length, static_cast<size_t>(thisBlockSize));
     };
 
-    if (headSizeIn.headSizeInSamples == 0) {
+    if (buf.getNumChannels() == 4) {
+      // A true-stereo impulse response, with channels for the L->L, L->R,
+      // R->L and R->R paths. Each input channel gets one engine with two
+      // paths, so that each input is only transformed once per block.
+      jassert(headSizeIn.headSizeInSamples == 0);
+
+      for (int input = 0; input < numChannels; ++input) {
+        const float *paths[] = {buf.getReadPointer(2 * input),
+                                buf.getReadPointer(2 * input + 1)};
+        head.emplace_back(std::make_unique<ConvolutionEngine>(
+            paths, 2, (size_t)buf.getNumSamples(), (size_t)maxBufferSize));
+      }
+
+      trueStereoBuffer.setSize(4, maxBlockSize);
+    } else if (headSizeIn.headSizeInSamples == 0 && isZeroDelay &&
+               (size_t)buf.getNumSamples() <=
+                   BlockingConvolution::getDirectFormCrossoverLength()) {
+      for (int i = 0; i < numChannels; ++i)
+        direct.emplace_back(std::make_unique<DirectFormEngine>(
+            buf.getReadPointer(jmin(buf.getNumChannels() - 1, i)),
+            (size_t)buf.getNumSamples(), (size_t)maxBlockSize));
+    } else if (headSizeIn.headSizeInSamples == 0) {
       for (int i = 0; i < numChannels; ++i)
         head.emplace_back(makeEngine(i, 0, buf.getNumSamples(),
                                      static_cast<uint32>(maxBufferSize)));
     } else {
       const auto size = jmin(buf.getNumSamples(), headSizeIn.headSizeInSamples);
+      tailStart = size;
 
       for (int i = 0; i < numChannels; ++i)
         head.emplace_back(
@@ -388,22 +905,46 @@ public:
     }
   }
 
+  // Wraps zero-latency, uniformly partitioned engines that were built
+  // elsewhere (i.e.: from a partition cache file).
+  MultichannelEngine(std::vector<std::unique_ptr<ConvolutionEngine>> headIn,
+                     int irSizeIn, int maxBlockSize)
+      : head(std::move(headIn)), tailBuffer(1, maxBlockSize), latency(0),
+        irSize(irSizeIn), blockSize(maxBlockSize), isZeroDelay(true) {}
+
   void reset() {
     for (const auto &e : head)
       e->reset();
 
     for (const auto &e : tail)
       e->reset();
+
+    for (const auto &e : direct)
+      e->reset();
   }
 
   void processSamples(const AudioBlock<const float> &input,
                       AudioBlock<float> &output) {
+    if (!direct.empty()) {
+      processSamplesWithDirectForm(input, output);
+      return;
+    }
+
+    if (isTrueStereo()) {
+      processSamplesWithTrueStereo(input, output);
+      return;
+    }
+
     const auto numChannels =
         jmin(head.size(), input.getNumChannels(), output.getNumChannels());
     const auto numSamples = jmin(input.getNumSamples(), output.getNumSamples());
 
+    // Note: the tail buffer is only used (and is only guaranteed to be large
+    // enough) when using non-uniform partitioning; in offline mode, blocks
+    // may be much larger than it.
     const AudioBlock<float> fullTailBlock(tailBuffer);
-    const auto tailBlock = fullTailBlock.getSubBlock(0, (size_t)numSamples);
+    const auto tailBlock = fullTailBlock.getSubBlock(
+        0, jmin((size_t)numSamples, fullTailBlock.getNumSamples()));
 
     const auto isUniform = tail.empty();
 
@@ -436,20 +977,129 @@ public:
   int getLatency() const noexcept { return latency; }
   int getBlockSize() const noexcept { return blockSize; }
 
+  // True if this engine is zero-latency and uniformly partitioned, and so
+  // could be recreated from its head engines' impulse segments alone.
+  bool isUniformlyPartitioned() const noexcept {
+    return isZeroDelay && tail.empty() && direct.empty() && !isTrueStereo();
+  }
+
+  bool isTrueStereo() const noexcept {
+    return trueStereoBuffer.getNumChannels() > 0;
+  }
+
+  // Keeps only the partitions covering the first residentLength samples of
+  // the impulse response in memory, moving the rest into memory-mapped
+  // temporary files (see ConvolutionEngine::moveImpulseSegmentsToDisk).
+  void moveImpulseResponseTailToDisk(int residentLength,
+                                     const File &directory) {
+    const auto moveToDisk = [&](ConvolutionEngine &engine, int length) {
+      const auto samplesPerSegment = engine.fftSize - engine.blockSize;
+      const auto numToKeep =
+          ((size_t)jmax(0, length) + samplesPerSegment - 1) /
+          samplesPerSegment;
+      engine.moveImpulseSegmentsToDisk(numToKeep, directory);
+    };
+
+    for (const auto &e : head)
+      moveToDisk(*e, residentLength);
+
+    for (const auto &e : tail)
+      moveToDisk(*e, residentLength - tailStart);
+  }
+
+  const ConvolutionEngine &getHeadEngine(size_t channel) const {
+    return *head[channel];
+  }
+
 private:
+  void processSamplesWithDirectForm(const AudioBlock<const float> &input,
+                                    AudioBlock<float> &output) {
+    const auto numChannels =
+        jmin(direct.size(), input.getNumChannels(), output.getNumChannels());
+    const auto numSamples = jmin(input.getNumSamples(), output.getNumSamples());
+
+    for (size_t channel = 0; channel < numChannels; ++channel)
+      direct[channel]->processSamples(input.getChannelPointer(channel),
+                                      output.getChannelPointer(channel),
+                                      numSamples);
+
+    const auto numOutputChannels = output.getNumChannels();
+
+    for (auto i = numChannels; i < numOutputChannels; ++i)
+      output.getSingleChannelBlock(i).copyFrom(output.getSingleChannelBlock(0));
+  }
+
+  // With a true-stereo impulse response, each input channel's engine writes
+  // its two paths here before they're summed into the output. Processing
+  // happens in chunks of at most this buffer's length, as the output may be
+  // the same as the input.
+  void processSamplesWithTrueStereo(const AudioBlock<const float> &input,
+                                    AudioBlock<float> &output) {
+    const auto numInputChannels =
+        jmin((size_t)2, input.getNumChannels(), output.getNumChannels());
+    const auto numOutputChannels = output.getNumChannels();
+    const auto numSamples = jmin(input.getNumSamples(), output.getNumSamples());
+    const auto chunkSize = (size_t)trueStereoBuffer.getNumSamples();
+
+    for (size_t start = 0; start < numSamples; start += chunkSize) {
+      const auto chunkLength = jmin(chunkSize, numSamples - start);
+
+      for (size_t channel = 0; channel < numInputChannels; ++channel) {
+        float *paths[] = {
+            trueStereoBuffer.getWritePointer(2 * (int)channel),
+            trueStereoBuffer.getWritePointer(2 * (int)channel + 1)};
+
+        if (isZeroDelay)
+          head[channel]->processSamples(
+              input.getChannelPointer(channel) + start, paths, chunkLength);
+        else
+          head[channel]->processSamplesWithAddedLatency(
+              input.getChannelPointer(channel) + start, paths, chunkLength);
+      }
+
+      if (numInputChannels == 1) {
+        // Mono audio only uses the L->L path.
+        FloatVectorOperations::copy(output.getChannelPointer(0) + start,
+                                    trueStereoBuffer.getReadPointer(0),
+                                    (int)chunkLength);
+      } else {
+        for (int channel = 0; channel < 2; ++channel)
+          FloatVectorOperations::add(
+              output.getChannelPointer((size_t)channel) + start,
+              trueStereoBuffer.getReadPointer(channel),
+              trueStereoBuffer.getReadPointer(2 + channel), (int)chunkLength);
+      }
+    }
+
+    for (auto i = numInputChannels; i < numOutputChannels; ++i)
+      output.getSingleChannelBlock(i).copyFrom(output.getSingleChannelBlock(0));
+  }
+
   std::vector<std::unique_ptr<ConvolutionEngine>> head, tail;
+  // Only used (instead of head and tail) for very short impulse responses.
+  std::vector<std::unique_ptr<DirectFormEngine>> direct;
   AudioBuffer<float> tailBuffer;
+  // Only allocated for true-stereo impulse responses.
+  AudioBuffer<float> trueStereoBuffer;
 
   const int latency;
   const int irSize;
   const int blockSize;
   const bool isZeroDelay;
+  // Where the tail engines start in the impulse response, if there are any.
+  int tailStart = 0;
 };
 
+// Four-channel impulse responses are kept as-is if allowed, as these are
+// true-stereo impulse responses (see MultichannelEngine).
 static AudioBuffer<float> fixNumChannels(const AudioBuffer<float> &buf,
-                                         Convolution::Stereo stereo) {
-  const auto numChannels =
-      jmin(buf.getNumChannels(), stereo == Convolution::Stereo::yes ? 2 : 1);
+                                         Convolution::Stereo stereo,
+                                         bool allowTrueStereo) {
+  const auto maxNumChannels =
+      stereo == Convolution::Stereo::no
+          ? 1
+          : (allowTrueStereo && buf.getNumChannels() == 4 ? 4 : 2);
+  const auto numChannels = jmin(buf.getNumChannels(), maxNumChannels);
   const auto numSamples = buf.getNumSamples();
 
   AudioBuffer<float> result(numChannels, buf.getNumSamples());
@@ -519,6 +1169,54 @@ static float calculateNormalisationFactor(float sumSquaredMagnitude) {
   return 0.125f / std::sqrt(sumSquaredMagnitude);
 }
 
+// Truncates an impulse response where its energy decay curve (the backward
+// integral of its energy, summed across channels) falls below the given level
+// relative to its total energy, fading out over the last few milliseconds
+// before that point. For long reverbs, this can remove most of the impulse
+// response (and most of the work needed to convolve with it) while keeping
+// its early reflections, and all but the quietest part of its tail, exact.
+static AudioBuffer<float> truncateImpulseResponse(const AudioBuffer<float> &buf,
+                                                  float decibels,
+                                                  double sampleRate) {
+  const auto numChannels = buf.getNumChannels();
+  const auto numSamples = buf.getNumSamples();
+
+  const auto energyAt = [&](int sample) {
+    double energy = 0.0;
+    for (int channel = 0; channel < numChannels; ++channel)
+      energy += (double)buf.getSample(channel, sample) *
+                (double)buf.getSample(channel, sample);
+    return energy;
+  };
+
+  double totalEnergy = 0.0;
+  for (int sample = 0; sample < numSamples; ++sample)
+    totalEnergy += energyAt(sample);
+
+  const auto threshold = totalEnergy * std::pow(10.0, decibels / 10.0);
+
+  auto newLength = numSamples;
+  double tailEnergy = 0.0;
+  for (int sample = numSamples - 1; sample >= 0; --sample) {
+    tailEnergy += energyAt(sample);
+    if (tailEnergy > threshold) {
+      newLength = sample + 1;
+      break;
+    }
+  }
+
+  if (newLength >= numSamples || totalEnergy <= 0.0)
+    return buf;
+
+  AudioBuffer<float> result(numChannels, newLength);
+  for (int channel = 0; channel < numChannels; ++channel)
+    result.copyFrom(channel, 0, buf, channel, 0, newLength);
+
+  const auto fadeLength = jmin(newLength, roundToInt(0.01 * sampleRate));
+  result.applyGainRamp(newLength - fadeLength, fadeLength, 1.0f, 0.0f);
+  return result;
+}
+
 static void normaliseImpulseResponse(AudioBuffer<float> &buf) {
   const auto numChannels = buf.getNumChannels();
   const auto numSamples = buf.getNumSamples();
@@ -591,9 +1289,14 @@ loadStreamToBuffer(std::unique_ptr<InputStream> stream, size_t maxLength) {
   const auto lengthToLoad =
       maxLength == 0 ? fileLength : jmin(maxLength, fileLength);
 
+  // Impulse responses may be mono, stereo or true stereo (four channels).
+  const auto numChannels =
+      formatReader->numChannels == 4
+          ? 4
+          : jlimit(1, 2, static_cast<int>(formatReader->numChannels));
+
   BufferWithSampleRate result{
-      {jlimit(1, 2, static_cast<int>(formatReader->numChannels)),
-       static_cast<int>(lengthToLoad)},
+      {numChannels, static_cast<int>(lengthToLoad)},
       formatReader->sampleRate};
 
   formatReader->read(result.buffer.getArrayOfWritePointers(),
@@ -603,10 +1306,370 @@ loadStreamToBuffer(std::unique_ptr<InputStream> stream, size_t maxLength) {
   return result;
 }
 
+// A process-wide cache of decoded impulse response files, populated by
+// BlockingConvolution::preloadImpulseResponses. Entries are keyed by path
+// (and maximum length) and are only used if the file's size and modification
+// time haven't changed since it was decoded. Once the decoded samples take
+// up more than maximumSizeInBytes, the least recently used files are evicted
+// (although the most recently stored file is always kept).
+//
+// Samples are kept in std::vectors rather than AudioBuffers, as this cache
+// lives until the process exits (after JUCE's leak detectors have run).
+class DecodedImpulseResponseCache {
+public:
+  static constexpr size_t maximumSizeInBytes = (size_t)1 << 30;
+
+  static DecodedImpulseResponseCache &getInstance() {
+    static DecodedImpulseResponseCache instance;
+    return instance;
+  }
+
+  bool lookup(const File &file, size_t maxLength,
+              BufferWithSampleRate &result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(getKey(file, maxLength));
+    if (it == entries.end() || !it->second.isUpToDate(file))
+      return false;
+
+    recentlyUsed.splice(recentlyUsed.begin(), recentlyUsed,
+                        it->second.recentlyUsedPosition);
+
+    const auto &channels = it->second.channels;
+    const auto numSamples = channels.empty() ? 0 : channels[0].size();
+    result.buffer.setSize((int)channels.size(), (int)numSamples);
+    for (size_t channel = 0; channel < channels.size(); ++channel)
+      result.buffer.copyFrom((int)channel, 0, channels[channel].data(),
+                             (int)numSamples);
+    result.sampleRate = it->second.sampleRate;
+    return true;
+  }
+
+  void store(const File &file, size_t maxLength,
+             const BufferWithSampleRate &decoded) {
+    Entry entry;
+    entry.fileSize = file.getSize();
+    entry.modificationTime = file.getLastModificationTime();
+    entry.sampleRate = decoded.sampleRate;
+    for (int channel = 0; channel < decoded.buffer.getNumChannels(); ++channel)
+      entry.channels.emplace_back(
+          decoded.buffer.getReadPointer(channel),
+          decoded.buffer.getReadPointer(channel) +
+              decoded.buffer.getNumSamples());
+
+    entry.sizeInBytes = (size_t)decoded.buffer.getNumChannels() *
+                        (size_t)decoded.buffer.getNumSamples() * sizeof(float);
+
+    const auto key = getKey(file, maxLength);
+    std::lock_guard<std::mutex> lock(mutex);
+    erase(key);
+    recentlyUsed.push_front(key);
+    entry.recentlyUsedPosition = recentlyUsed.begin();
+    totalSizeInBytes += entry.sizeInBytes;
+    entries.emplace(key, std::move(entry));
+
+    while (totalSizeInBytes > maximumSizeInBytes && entries.size() > 1)
+      erase(recentlyUsed.back());
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    recentlyUsed.clear();
+    totalSizeInBytes = 0;
+  }
+
+  size_t getSizeInBytes() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return totalSizeInBytes;
+  }
+
+private:
+  struct Entry {
+    int64 fileSize = 0;
+    Time modificationTime;
+    double sampleRate = 0.0;
+    std::vector<std::vector<float>> channels;
+    size_t sizeInBytes = 0;
+    std::list<std::string>::iterator recentlyUsedPosition;
+
+    bool isUpToDate(const File &file) const {
+      return file.getSize() == fileSize &&
+             file.getLastModificationTime() == modificationTime;
+    }
+  };
+
+  static std::string getKey(const File &file, size_t maxLength) {
+    return file.getFullPathName().toStdString() + ":" +
+           std::to_string(maxLength);
+  }
+
+  // Must be called with the mutex held. (The key is copied, as it may be
+  // one of the strings in recentlyUsed.)
+  void erase(std::string key) {
+    auto it = entries.find(key);
+    if (it == entries.end())
+      return;
+
+    totalSizeInBytes -= it->second.sizeInBytes;
+    recentlyUsed.erase(it->second.recentlyUsedPosition);
+    entries.erase(it);
+  }
+
+  std::mutex mutex;
+  std::map<std::string, Entry> entries;
+  // Keys of every entry, most recently used first.
+  std::list<std::string> recentlyUsed;
+  size_t totalSizeInBytes = 0;
+};
+
+// A process-wide pool of threads for decoding impulse responses and building
+// engines in the background, so that creating many Convolution plugins at
+// once doesn't start a thread for each of them. Tasks run in the order
+// they're submitted, and must never wait for one another.
+//
+// The pool is never destroyed: its threads just wait for more work until
+// the process exits, rather than being joined during static destruction.
+class BackgroundThreadPool {
+public:
+  static BackgroundThreadPool &getInstance() {
+    static auto *instance = new BackgroundThreadPool();
+    return *instance;
+  }
+
+  template <typename Function>
+  std::future<std::invoke_result_t<Function>> submit(Function function) {
+    using Result = std::invoke_result_t<Function>;
+    auto task =
+        std::make_shared<std::packaged_task<Result()>>(std::move(function));
+    auto result = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      // Threads are only started once they're needed.
+      if (threads.empty()) {
+        const auto numThreads =
+            jmax((unsigned int)1, std::thread::hardware_concurrency());
+        for (unsigned int i = 0; i < numThreads; ++i)
+          threads.emplace_back([this]() { runTasks(); });
+      }
+      tasks.emplace_back([task]() { (*task)(); });
+    }
+    tasksAvailable.notify_one();
+    return result;
+  }
+
+private:
+  BackgroundThreadPool() = default;
+
+  void runTasks() {
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        tasksAvailable.wait(lock, [this]() { return !tasks.empty(); });
+        task = std::move(tasks.front());
+        tasks.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable tasksAvailable;
+  std::deque<std::function<void()>> tasks;
+  std::vector<std::thread> threads;
+};
+
+// Decodes an impulse response file, using a previously decoded copy if one
+// was preloaded.
+static BufferWithSampleRate loadFileToBuffer(const File &file,
+                                             size_t maxLength) {
+  BufferWithSampleRate result;
+  if (DecodedImpulseResponseCache::getInstance().lookup(file, maxLength,
+                                                        result))
+    return result;
+
+  return loadStreamToBuffer(std::make_unique<FileInputStream>(file),
+                            maxLength);
+}
+
+//==============================================================================
+// A partition cache file holds the frequency-domain impulse segments of a
+// zero-latency, uniformly partitioned engine, for one impulse response file
+// at one sample rate and block size. Loading an engine from one is just a
+// memory map: decoding, resampling, normalisation and FFTs are all skipped.
+//
+// Each file starts with a fixed-size header (padded so that the segments
+// that follow stay 64-byte aligned when mapped), followed by the impulse
+// segments of each channel of the impulse response, back-to-back. Files are
+// ignored (and rewritten) if their header doesn't match what we expect, so
+// the version below must be bumped if the engine's layout ever changes.
+class PartitionCacheFile {
+public:
+  // blockSize should be 0 for engines using offline partitioning, as their
+  // partition size depends on the impulse response instead. loadOptions
+  // should describe everything else that affects the impulse response.
+  PartitionCacheFile(const File &directory, const File &sourceIn,
+                     double sampleRateIn, int blockSizeIn,
+                     const String &loadOptions)
+      : source(sourceIn), sourceSize(source.getSize()),
+        sourceModificationTime(
+            source.getLastModificationTime().toMilliseconds()),
+        sampleRate(sampleRateIn), blockSize((uint32)blockSizeIn) {
+    const auto key = source.getFullPathName() + "|" + String(sampleRate) +
+                     "|" + String(blockSize) + "|" + loadOptions;
+    keyHash = (uint64)key.hashCode64();
+    file = directory.getChildFile(source.getFileNameWithoutExtension() + "." +
+                                  String::toHexString((int64)keyHash) +
+                                  ".pbpartitions");
+  }
+
+  const File &getFile() const { return file; }
+
+  // Returns nullptr if there is no usable cache file.
+  std::unique_ptr<MultichannelEngine> load() const {
+    auto mapping =
+        std::make_shared<MemoryMappedFile>(file, MemoryMappedFile::readOnly);
+    if (mapping->getData() == nullptr ||
+        mapping->getSize() < (size_t)headerSize)
+      return nullptr;
+
+    Header header;
+    std::memcpy(&header, mapping->getData(), sizeof(header));
+    if (!matches(header))
+      return nullptr;
+
+    const auto segmentsSize = (size_t)header.numSegments * header.segmentStride;
+    if (mapping->getSize() !=
+        headerSize + header.numChannels * segmentsSize * sizeof(float))
+      return nullptr;
+
+    const auto *segments = reinterpret_cast<const float *>(
+        static_cast<const char *>(mapping->getData()) + headerSize);
+
+    std::vector<std::unique_ptr<ConvolutionEngine>> head;
+    for (uint32 i = 0; i < 2; ++i) {
+      const auto channel = jmin(header.numChannels - 1, i);
+      head.emplace_back(std::make_unique<ConvolutionEngine>(
+          segments + channel * segmentsSize, mapping,
+          header.impulseResponseLength, header.engineBlockSize));
+
+      if (head.back()->fftSize != header.fftSize ||
+          head.back()->numSegments != header.numSegments ||
+          head.back()->segmentStride != header.segmentStride)
+        return nullptr;
+    }
+
+    return std::make_unique<MultichannelEngine>(
+        std::move(head), (int)header.impulseResponseLength,
+        (int)header.engineBlockSize);
+  }
+
+  // Writes the given engine's partitions to disk, if possible. Failures are
+  // ignored, as the cache is only an optimization.
+  void store(const MultichannelEngine &engine, int numImpulseChannels) const {
+    if (!engine.isUniformlyPartitioned())
+      return;
+
+    const auto &firstEngine = engine.getHeadEngine(0);
+
+    Header header;
+    std::memcpy(header.magic, magic, sizeof(header.magic));
+    header.version = version;
+    header.byteOrderMark = byteOrderMark;
+    header.keyHash = keyHash;
+    header.sourceSize = sourceSize;
+    header.sourceModificationTime = sourceModificationTime;
+    header.sampleRate = sampleRate;
+    header.engineBlockSize = (uint32)engine.getBlockSize();
+    header.fftSize = (uint32)firstEngine.fftSize;
+    header.numSegments = (uint32)firstEngine.numSegments;
+    header.segmentStride = (uint32)firstEngine.segmentStride;
+    header.numChannels = (uint32)numImpulseChannels;
+    header.impulseResponseLength = (uint32)engine.getIRSize();
+
+    char paddedHeader[headerSize] = {};
+    std::memcpy(paddedHeader, &header, sizeof(header));
+
+    // Write to a temporary file first, so that other processes never see
+    // (and try to map) a partially written cache file.
+    TemporaryFile temporaryFile(file);
+    {
+      FileOutputStream stream(temporaryFile.getFile());
+      if (!stream.openedOk())
+        return;
+
+      bool succeeded = stream.write(paddedHeader, headerSize);
+      for (int channel = 0; channel < numImpulseChannels; ++channel) {
+        const auto &channelEngine = engine.getHeadEngine((size_t)channel);
+        succeeded = succeeded &&
+                    stream.write(channelEngine.getImpulseSegments(),
+                                 channelEngine.getImpulseSegmentsSize() *
+                                     sizeof(float));
+      }
+      stream.flush();
+
+      if (!succeeded || stream.getStatus().failed())
+        return;
+    }
+
+    temporaryFile.overwriteTargetFileWithTemporary();
+  }
+
+private:
+  struct Header {
+    char magic[8];
+    uint32 version;
+    uint32 byteOrderMark;
+    uint64 keyHash;
+    int64 sourceSize;
+    int64 sourceModificationTime;
+    double sampleRate;
+    uint32 engineBlockSize;
+    uint32 fftSize;
+    uint32 numSegments;
+    uint32 segmentStride;
+    uint32 numChannels;
+    uint32 impulseResponseLength;
+  };
+
+  static constexpr size_t headerSize = 256;
+  static_assert(sizeof(Header) <= headerSize, "Header must fit in headerSize");
+  static_assert(headerSize % ConvolutionEngine::segmentAlignmentInBytes == 0,
+                "Segments must stay aligned after the header");
+
+  static constexpr char magic[8] = {'P', 'B', 'P', 'A', 'R', 'T', 'S', 0};
+  static constexpr uint32 version = 1;
+  static constexpr uint32 byteOrderMark = 0x01020304;
+
+  bool matches(const Header &header) const {
+    return std::memcmp(header.magic, magic, sizeof(magic)) == 0 &&
+           header.version == version &&
+           header.byteOrderMark == byteOrderMark &&
+           header.keyHash == keyHash && header.sourceSize == sourceSize &&
+           header.sourceModificationTime == sourceModificationTime &&
+           header.sampleRate == sampleRate &&
+           (blockSize == 0 || header.engineBlockSize == blockSize) &&
+           header.engineBlockSize > 0 && header.numChannels >= 1 &&
+           header.numChannels <= 2 && header.numSegments > 0;
+  }
+
+  File file;
+  const File source;
+  const int64 sourceSize;
+  const int64 sourceModificationTime;
+  const double sampleRate;
+  const uint32 blockSize;
+  uint64 keyHash = 0;
+};
+
 // This class caches the data required to build a new convolution engine
 // (in particular, impulse response data and a ProcessSpec).
-// Calls to `setProcessSpec` and `setImpulseResponse` construct a
-// new engine, which can be retrieved by calling `getEngine`.
+// Factories copied from one another (with copyImpulseResponseFrom) share
+// their impulse response, and the transformed partitions of any uniformly
+// partitioned engine that one of them has built for the same settings.
+// Calls to `setProcessSpec` construct a new engine if required, which can be
+// retrieved by calling `getEngine`. Engines are only built once prepared, and
+// can be freed again with `release` without losing the impulse response.
 class BlockingConvolutionEngineFactory {
 public:
   BlockingConvolutionEngineFactory(Convolution::Latency requiredLatency,
@@ -624,13 +1687,22 @@ public:
   // It is safe to call this method simultaneously with other public
   // member functions.
   void setProcessSpec(const ProcessSpec &spec) {
-    bool shouldRemakeEngine =
-        processSpec.maximumBlockSize != spec.maximumBlockSize ||
-        processSpec.sampleRate != spec.sampleRate ||
-        processSpec.numChannels != spec.numChannels;
+    // In offline mode, the block size is usually the length of each input,
+    // which only affects the engine if it changes the partition size.
+    const bool blockSizeChanged =
+        usesOfflinePartitioning()
+            ? (engine && getOfflinePartitionSize(engine->getIRSize(),
+                                                 spec.maximumBlockSize) !=
+                             getOfflinePartitionSize(
+                                 engine->getIRSize(),
+                                 processSpec.maximumBlockSize))
+            : processSpec.maximumBlockSize != spec.maximumBlockSize;
+    bool shouldRemakeEngine = blockSizeChanged ||
+                              processSpec.sampleRate != spec.sampleRate ||
+                              processSpec.numChannels != spec.numChannels;
     processSpec = spec;
 
-    if (shouldRemakeEngine) {
+    if (shouldRemakeEngine || !engine) {
       engine = makeEngine();
     }
   }
@@ -641,15 +1713,100 @@ public:
                           Convolution::Stereo stereo, Convolution::Trim trim,
                           Convolution::Normalise normalise) {
     wantsNormalise = normalise;
-    originalSampleRate = buf.sampleRate;
+    source.reset();
+    applyImpulseResponse(std::move(buf), stereo, trim);
 
-    impulseResponse = [&] {
-      auto corrected = fixNumChannels(buf.buffer, stereo);
-      return trim == Convolution::Trim::yes ? trimImpulseResponse(corrected)
-                                            : corrected;
-    }();
+    // Don't build an engine until we're prepared, unless we already were.
+    if (engine)
+      engine = makeEngine();
+  }
+
+  // Like setImpulseResponse, but remembers which file the impulse response
+  // came from so that its partitions can be cached. If a partition cache
+  // directory is set, the file isn't decoded unless it needs to be (i.e.:
+  // if the engine can't be loaded from the cache).
+  void setImpulseResponseFile(const File &file, Convolution::Stereo stereo,
+                              Convolution::Trim trim, size_t maxLength,
+                              Convolution::Normalise normalise) {
+    wantsNormalise = normalise;
+    source = ImpulseResponseSource{file, stereo, trim, maxLength, true};
+
+    if (partitionCacheDirectory == File())
+      decodeSourceIfNeeded();
+
+    if (engine)
+      engine = makeEngine();
+  }
 
-    engine = makeEngine();
+  void setPartitionCacheDirectory(const File &directory) {
+    partitionCacheDirectory = directory;
+  }
+
+  bool hasPartitionCacheDirectory() const {
+    return partitionCacheDirectory != File();
+  }
+
+  // If set, the impulse response is truncated where its energy decay curve
+  // falls below this many decibels (see truncateImpulseResponse).
+  void setTailTruncation(std::optional<float> decibels) {
+    if (tailTruncationDecibels == decibels)
+      return;
+
+    tailTruncationDecibels = decibels;
+    if (engine)
+      engine = makeEngine();
+  }
+
+  // If non-negative, only this many seconds of the impulse response are kept
+  // in memory; the rest is moved to disk (see MultichannelEngine).
+  void setResidentImpulseResponseLength(double seconds) {
+    if (residentImpulseResponseSeconds == seconds)
+      return;
+
+    residentImpulseResponseSeconds = seconds;
+    if (engine)
+      engine = makeEngine();
+  }
+
+  // Free the engine (and all of its FFT buffers) until next prepared.
+  void release() { engine.reset(); }
+
+  void setOfflineMode(bool shouldBeOffline) {
+    if (offline == shouldBeOffline)
+      return;
+
+    offline = shouldBeOffline;
+    if (engine)
+      engine = makeEngine();
+  }
+
+  bool isOffline() const { return offline; }
+
+  // Shares the impulse response (and the options used to load it) with
+  // another factory, without re-reading it from its original source or
+  // copying it.
+  void copyImpulseResponseFrom(const BlockingConvolutionEngineFactory &other) {
+    impulseResponse = other.impulseResponse;
+    sharedEngines = other.sharedEngines;
+    originalSampleRate = other.originalSampleRate;
+    wantsNormalise = other.wantsNormalise;
+    source = other.source;
+    partitionCacheDirectory = other.partitionCacheDirectory;
+    residentImpulseResponseSeconds = other.residentImpulseResponseSeconds;
+    tailTruncationDecibels = other.tailTruncationDecibels;
+
+    if (engine)
+      engine = makeEngine();
+  }
+
+  bool hasEngine() const { return engine != nullptr; }
+
+  const ProcessSpec &getProcessSpec() const { return processSpec; }
+
+  bool hasSameProcessSpec(const BlockingConvolutionEngineFactory &other) const {
+    return processSpec.sampleRate == other.processSpec.sampleRate &&
+           processSpec.maximumBlockSize == other.processSpec.maximumBlockSize &&
+           processSpec.numChannels == other.processSpec.numChannels;
   }
 
   MultichannelEngine &getEngine() const {
@@ -661,13 +1818,153 @@ public:
   }
 
 private:
-  std::unique_ptr<MultichannelEngine> makeEngine() {
+  // Offline mode only applies to zero-latency, uniformly partitioned
+  // convolution.
+  bool usesOfflinePartitioning() const {
+    return offline && shouldBeZeroLatency && headSize.headSizeInSamples == 0;
+  }
+
+  void applyImpulseResponse(BufferWithSampleRate &&buf,
+                            Convolution::Stereo stereo,
+                            Convolution::Trim trim) {
+    originalSampleRate = buf.sampleRate;
+
+    impulseResponse = std::make_shared<const AudioBuffer<float>>([&] {
+      // True-stereo impulse responses only support uniform partitioning.
+      auto corrected = fixNumChannels(buf.buffer, stereo,
+                                      headSize.headSizeInSamples == 0);
+      return trim == Convolution::Trim::yes ? trimImpulseResponse(corrected)
+                                            : corrected;
+    }());
+    sharedEngines = std::make_shared<SharedEngines>();
+  }
+
+  void decodeSourceIfNeeded() {
+    if (!source || !source->needsDecoding)
+      return;
+
+    applyImpulseResponse(loadFileToBuffer(source->file, source->maxLength),
+                         source->stereo, source->trim);
+    source->needsDecoding = false;
+  }
+
+  // Partition cache files are only used for engines loaded from files, and
+  // only when the engine is zero-latency and uniformly partitioned.
+  std::optional<PartitionCacheFile> getPartitionCacheFile() const {
+    if (!hasPartitionCacheDirectory() || !source || !shouldBeZeroLatency ||
+        headSize.headSizeInSamples != 0)
+      return {};
+
+    const auto loadOptions =
+        String(source->stereo == Convolution::Stereo::yes ? "stereo"
+                                                          : "mono") +
+        (source->trim == Convolution::Trim::yes ? "|trim" : "|notrim") +
+        (wantsNormalise == Convolution::Normalise::yes ? "|normalise"
+                                                       : "|nonormalise") +
+        "|" + String((int64)source->maxLength) +
+        (tailTruncationDecibels
+             ? "|truncate" + String(*tailTruncationDecibels)
+             : String("|notruncate"));
+
+    return PartitionCacheFile(
+        partitionCacheDirectory, source->file, processSpec.sampleRate,
+        usesOfflinePartitioning() ? 0 : (int)processSpec.maximumBlockSize,
+        loadOptions);
+  }
+
+  std::shared_ptr<MultichannelEngine> makeEngine() {
+    const auto cacheFile = getPartitionCacheFile();
+    if (cacheFile) {
+      if (auto cached = cacheFile->load())
+        return cached;
+    }
+
+    decodeSourceIfNeeded();
+
+    // Engines whose impulse segments are moved to disk aren't shared, as
+    // that modifies them after they're built.
+    auto result = residentImpulseResponseSeconds >= 0
+                      ? std::shared_ptr<MultichannelEngine>(
+                            makeEngineFromImpulseResponse())
+                      : makeSharedEngine();
+
+    if (cacheFile) {
+      // Make sure the directory exists; if it can't be created, the cache
+      // file won't be written.
+      partitionCacheDirectory.createDirectory();
+      cacheFile->store(*result, jmin(2, impulseResponse->getNumChannels()));
+    }
+
+    if (residentImpulseResponseSeconds >= 0)
+      result->moveImpulseResponseTailToDisk(
+          roundToInt(residentImpulseResponseSeconds * processSpec.sampleRate),
+          File::getSpecialLocation(File::tempDirectory));
+
+    return result;
+  }
+
+  // Returns an engine that uses the transformed impulse segments of one
+  // that another factory sharing this impulse response has already built
+  // with the same settings, if there is one. Otherwise, builds a new engine
+  // that others can then share. The segments are never modified once built,
+  // so they can be read by any number of engines at once.
+  std::shared_ptr<MultichannelEngine> makeSharedEngine() {
+    const auto key =
+        String(processSpec.sampleRate) + "|" +
+        (usesOfflinePartitioning()
+             ? "offline" + String(getOfflinePartitionSize(
+                               maximumOfflinePartitionSize,
+                               processSpec.maximumBlockSize))
+             : String(processSpec.maximumBlockSize)) +
+        (tailTruncationDecibels
+             ? "|truncate" + String(*tailTruncationDecibels)
+             : String("|notruncate"));
+
+    // Held while building, so that copies prepared at the same time wait
+    // for the first of them rather than all repeating the same work.
+    std::lock_guard<std::mutex> lock(sharedEngines->mutex);
+    auto &engines = sharedEngines->engines;
+    for (auto it = engines.begin(); it != engines.end();)
+      it = it->second.expired() ? engines.erase(it) : std::next(it);
+
+    if (auto donor = engines[key].lock()) {
+      std::vector<std::unique_ptr<ConvolutionEngine>> headEngines;
+      for (size_t channel = 0; channel < 2; ++channel)
+        headEngines.emplace_back(std::make_unique<ConvolutionEngine>(
+            donor->getHeadEngine(channel).getImpulseSegments(), donor,
+            (size_t)donor->getIRSize(), (size_t)donor->getBlockSize()));
+      return std::make_shared<MultichannelEngine>(
+          std::move(headEngines), donor->getIRSize(), donor->getBlockSize());
+    }
+
+    std::shared_ptr<MultichannelEngine> result =
+        makeEngineFromImpulseResponse();
+    if (result->isUniformlyPartitioned())
+      engines[key] = result;
+    else
+      engines.erase(key);
+    return result;
+  }
+
+  std::unique_ptr<MultichannelEngine> makeEngineFromImpulseResponse() {
     auto resampled = resampleImpulseResponse(
-        impulseResponse, originalSampleRate, processSpec.sampleRate);
+        tailTruncationDecibels
+            ? truncateImpulseResponse(*impulseResponse,
+                                      *tailTruncationDecibels,
+                                      originalSampleRate)
+            : *impulseResponse,
+        originalSampleRate, processSpec.sampleRate);
 
     if (wantsNormalise == Convolution::Normalise::yes)
       normaliseImpulseResponse(resampled);
 
+    if (usesOfflinePartitioning()) {
+      const auto partitionSize = getOfflinePartitionSize(
+          resampled.getNumSamples(), processSpec.maximumBlockSize);
+      return std::make_unique<MultichannelEngine>(
+          resampled, partitionSize, partitionSize, headSize, true);
+    }
+
     const auto currentLatency =
         jmax(processSpec.maximumBlockSize, (uint32)latency.latencyInSamples);
     const auto maxBufferSize =
@@ -679,21 +1976,68 @@ private:
         shouldBeZeroLatency);
   }
 
-  static AudioBuffer<float> makeImpulseBuffer() {
-    AudioBuffer<float> result(1, 1);
-    result.setSample(0, 0, 1.0f);
+  // When processing whole buffers at once, small partitions just mean more
+  // FFTs. Instead, partitions are about as long as the impulse response
+  // (within reason) so that each input needs only one forward and inverse
+  // FFT, and very few partitions. Inputs shorter than the impulse response
+  // get partitions about as long as themselves, as a transform the length
+  // of the impulse response would mostly be of silence. (Unless partitions
+  // are cached, as cache files are shared by inputs of every length.)
+  int getOfflinePartitionSize(int impulseResponseLength,
+                              uint32 maxBlockSize) const {
+    const auto inputLength =
+        (int)jmin(maxBlockSize, (uint32)maximumOfflinePartitionSize);
+    const auto length = hasPartitionCacheDirectory()
+                            ? impulseResponseLength
+                            : jmin(impulseResponseLength, inputLength);
+    return jlimit(minimumOfflinePartitionSize, maximumOfflinePartitionSize,
+                  nextPowerOfTwo(length));
+  }
+
+  static std::shared_ptr<const AudioBuffer<float>> makeImpulseBuffer() {
+    auto result = std::make_shared<AudioBuffer<float>>(1, 1);
+    result->setSample(0, 0, 1.0f);
     return result;
   }
 
+  // The engines built by every factory sharing an impulse response, by the
+  // settings they were built with. Only uniformly partitioned engines are
+  // kept, as their impulse segments can be shared.
+  struct SharedEngines {
+    std::mutex mutex;
+    std::map<String, std::weak_ptr<const MultichannelEngine>> engines;
+  };
+
+  static constexpr int minimumOfflinePartitionSize = 512;
+  static constexpr int maximumOfflinePartitionSize = 1 << 17;
+
+  // The file the current impulse response was loaded from, if any.
+  struct ImpulseResponseSource {
+    File file;
+    Convolution::Stereo stereo;
+    Convolution::Trim trim;
+    size_t maxLength;
+    // True until the file is decoded into impulseResponse.
+    bool needsDecoding;
+  };
+
   ProcessSpec processSpec{44100.0, 128, 2};
-  AudioBuffer<float> impulseResponse = makeImpulseBuffer();
+  bool offline = false;
+  std::optional<ImpulseResponseSource> source;
+  File partitionCacheDirectory;
+  double residentImpulseResponseSeconds = -1.0;
+  std::optional<float> tailTruncationDecibels;
+  std::shared_ptr<const AudioBuffer<float>> impulseResponse =
+      makeImpulseBuffer();
+  std::shared_ptr<SharedEngines> sharedEngines =
+      std::make_shared<SharedEngines>();
   double originalSampleRate = processSpec.sampleRate;
   Convolution::Normalise wantsNormalise = Convolution::Normalise::no;
   const Convolution::Latency latency;
   const Convolution::NonUniform headSize;
   const bool shouldBeZeroLatency;
 
-  std::unique_ptr<MultichannelEngine> engine;
+  std::shared_ptr<MultichannelEngine> engine;
 };
 
 static void setImpulseResponse(BlockingConvolutionEngineFactory &factory,
@@ -713,56 +2057,355 @@ static void setImpulseResponse(BlockingConvolutionEngineFactory &factory,
                                Convolution::Stereo stereo,
                                Convolution::Trim trim, size_t size,
                                Convolution::Normalise normalise) {
-  factory.setImpulseResponse(
-      loadStreamToBuffer(std::make_unique<FileInputStream>(fileImpulseResponse),
-                         size),
-      stereo, trim, normalise);
+  factory.setImpulseResponseFile(fileImpulseResponse, stereo, trim, size,
+                                 normalise);
 }
 
 class BlockingConvolution::Impl {
 public:
-  Impl(Convolution::Latency requiredLatency,
-       Convolution::NonUniform requiredHeadSize)
-      : engineFactory(requiredLatency, requiredHeadSize) {}
+  Impl(Convolution::Latency requiredLatencyIn,
+       Convolution::NonUniform requiredHeadSizeIn)
+      : requiredLatency(requiredLatencyIn),
+        requiredHeadSize(requiredHeadSizeIn),
+        engineFactory(std::make_unique<BlockingConvolutionEngineFactory>(
+            requiredLatency, requiredHeadSize)) {}
+
+  ~Impl() {
+    std::lock_guard<std::mutex> builderLock(builderMutex);
+    if (builder.valid())
+      builder.wait();
+  }
+
+  void reset() {
+    // If an impulse response is still loading, there's nothing to reset yet;
+    // its engine will be built from scratch when next prepared.
+    if (engineFactory->hasEngine())
+      engineFactory->getEngine().reset();
+
+    // Any crossfade in progress is cut short, as the previous engine's
+    // state would be stale.
+    crossfadePosition = crossfadeLength;
+  }
+
+  void prepare(const ProcessSpec &spec) {
+    waitForPendingImpulseResponse();
+    adoptQueuedImpulseResponse();
+
+    {
+      std::lock_guard<std::mutex> lock(settingsMutex);
+      preparedSpec = spec;
+    }
+
+    engineFactory->setProcessSpec(spec);
+  }
+
+  void release() {
+    engineFactory->release();
+    previousEngineFactory.reset();
+    crossfadeBuffer.setSize(0, 0);
+    crossfadePosition = crossfadeLength = 0;
+
+    std::lock_guard<std::mutex> lock(queuedMutex);
+    retiredEngineFactory.reset();
+  }
+
+  void setOfflineMode(bool shouldBeOffline) {
+    {
+      std::lock_guard<std::mutex> lock(settingsMutex);
+      offline = shouldBeOffline;
+    }
+    engineFactory->setOfflineMode(shouldBeOffline);
+  }
+
+  bool isOffline() const { return engineFactory->isOffline(); }
+
+  void setPartitionCacheDirectory(const File &directory) {
+    {
+      std::lock_guard<std::mutex> lock(settingsMutex);
+      partitionCacheDirectory = directory;
+    }
+    engineFactory->setPartitionCacheDirectory(directory);
+  }
+
+  void setTailTruncation(std::optional<float> decibels) {
+    {
+      std::lock_guard<std::mutex> lock(settingsMutex);
+      tailTruncationDecibels = decibels;
+    }
+    engineFactory->setTailTruncation(decibels);
+  }
+
+  void setResidentImpulseResponseLength(double seconds) {
+    {
+      std::lock_guard<std::mutex> lock(settingsMutex);
+      residentImpulseResponseSeconds = seconds;
+    }
+    engineFactory->setResidentImpulseResponseLength(seconds);
+  }
+
+  void copyImpulseResponseFrom(Impl &other) {
+    other.waitForPendingImpulseResponse();
+    waitForPendingImpulseResponse();
+    engineFactory->copyImpulseResponseFrom(*other.engineFactory);
+  }
+
+  void loadImpulseResponseAsync(const File &fileImpulseResponse,
+                                Convolution::Stereo stereo,
+                                Convolution::Trim trim, size_t size,
+                                Convolution::Normalise normalise) {
+    waitForPendingImpulseResponse();
+
+    // With a partition cache, the file may not need to be decoded at all.
+    if (engineFactory->hasPartitionCacheDirectory()) {
+      setImpulseResponse(*engineFactory, fileImpulseResponse, stereo, trim,
+                         size, normalise);
+      return;
+    }
+
+    pendingImpulseResponse = BackgroundThreadPool::getInstance().submit(
+        [fileImpulseResponse, size]() {
+          return loadFileToBuffer(fileImpulseResponse, size);
+        });
+    pendingStereo = stereo;
+    pendingTrim = trim;
+    pendingNormalise = normalise;
+  }
 
-  void reset() { engineFactory.getEngine().reset(); }
+  bool isLoadingImpulseResponse() const {
+    return pendingImpulseResponse.valid();
+  }
 
-  void prepare(const ProcessSpec &spec) { engineFactory.setProcessSpec(spec); }
+  void waitForPendingImpulseResponse() {
+    if (pendingImpulseResponse.valid())
+      engineFactory->setImpulseResponse(pendingImpulseResponse.get(),
+                                        pendingStereo, pendingTrim,
+                                        pendingNormalise);
+  }
+
+  // Builds an engine for a new impulse response on a background thread, with
+  // the most recent settings passed to prepare(). Unlike the other methods
+  // here, this may be called while audio is being processed on another
+  // thread: processSamples picks up the new engine at the start of its next
+  // block (and crossfades to it) once it's ready.
+  void queueImpulseResponse(const File &fileImpulseResponse,
+                            Convolution::Stereo stereo, Convolution::Trim trim,
+                            size_t size, Convolution::Normalise normalise,
+                            double crossfadeSeconds) {
+    std::lock_guard<std::mutex> builderLock(builderMutex);
+
+    // Only one engine is built at a time; a newer impulse response replaces
+    // one that's been built but not yet swapped in.
+    if (builder.valid())
+      builder.wait();
+
+    std::unique_lock<std::mutex> settingsLock(settingsMutex);
+    const auto spec = preparedSpec;
+    const auto shouldBeOffline = offline;
+    const auto cacheDirectory = partitionCacheDirectory;
+    const auto residentSeconds = residentImpulseResponseSeconds;
+    const auto truncationDecibels = tailTruncationDecibels;
+    settingsLock.unlock();
+
+    builder = BackgroundThreadPool::getInstance().submit(
+        [this, fileImpulseResponse, stereo, trim, size, normalise,
+         crossfadeSeconds, spec, shouldBeOffline, cacheDirectory,
+         residentSeconds, truncationDecibels]() {
+          auto factory = std::make_unique<BlockingConvolutionEngineFactory>(
+              requiredLatency, requiredHeadSize);
+          factory->setOfflineMode(shouldBeOffline);
+          factory->setPartitionCacheDirectory(cacheDirectory);
+          factory->setResidentImpulseResponseLength(residentSeconds);
+          factory->setTailTruncation(truncationDecibels);
+          factory->setImpulseResponseFile(fileImpulseResponse, stereo, trim,
+                                          size, normalise);
+          factory->setProcessSpec(spec);
+
+          // The audio thread needs somewhere to put the previous engine's
+          // output while crossfading, which it can't allocate itself.
+          AudioBuffer<float> buffer((int)spec.numChannels,
+                                    (int)spec.maximumBlockSize);
+
+          std::unique_ptr<BlockingConvolutionEngineFactory> unusedFactory,
+              retiredFactory;
+          {
+            std::lock_guard<std::mutex> lock(queuedMutex);
+            unusedFactory = std::move(queuedEngineFactory);
+            retiredFactory = std::move(retiredEngineFactory);
+            queuedEngineFactory = std::move(factory);
+            std::swap(queuedCrossfadeBuffer, buffer);
+            queuedCrossfadeSeconds = crossfadeSeconds;
+            hasQueuedEngine = true;
+          }
+          // Anything replaced above is freed here, outside of the lock, so
+          // that the audio thread never has to wait for it.
+        });
+  }
 
   void processSamples(const AudioBlock<const float> &input,
                       AudioBlock<float> &output) {
-    engineFactory.getEngine().processSamples(input, output);
+    swapInQueuedEngineIfReady();
+
+    if (crossfadePosition < crossfadeLength)
+      processSamplesWithCrossfade(input, output);
+    else
+      engineFactory->getEngine().processSamples(input, output);
   }
 
-  int getCurrentIRSize() const { return engineFactory.getEngine().getIRSize(); }
+  int getCurrentIRSize() const {
+    return engineFactory->getEngine().getIRSize();
+  }
 
-  int getLatency() const { return engineFactory.getEngine().getLatency(); }
+  int getLatency() const { return engineFactory->getEngine().getLatency(); }
 
   void loadImpulseResponse(AudioBuffer<float> &&buffer,
                            double originalSampleRate,
                            Convolution::Stereo stereo, Convolution::Trim trim,
                            Convolution::Normalise normalise) {
-    engineFactory.setImpulseResponse({std::move(buffer), originalSampleRate},
-                                     stereo, trim, normalise);
+    waitForPendingImpulseResponse();
+    engineFactory->setImpulseResponse({std::move(buffer), originalSampleRate},
+                                      stereo, trim, normalise);
   }
 
   void loadImpulseResponse(const void *sourceData, size_t sourceDataSize,
                            Convolution::Stereo stereo, Convolution::Trim trim,
                            size_t size, Convolution::Normalise normalise) {
-
-    setImpulseResponse(engineFactory, sourceData, sourceDataSize, stereo, trim,
-                       size, normalise);
+    waitForPendingImpulseResponse();
+    setImpulseResponse(*engineFactory, sourceData, sourceDataSize, stereo,
+                       trim, size, normalise);
   }
 
   void loadImpulseResponse(const File &fileImpulseResponse,
                            Convolution::Stereo stereo, Convolution::Trim trim,
                            size_t size, Convolution::Normalise normalise) {
-    setImpulseResponse(engineFactory, fileImpulseResponse, stereo, trim, size,
+    waitForPendingImpulseResponse();
+    setImpulseResponse(*engineFactory, fileImpulseResponse, stereo, trim, size,
                        normalise);
   }
 
 private:
-  BlockingConvolutionEngineFactory engineFactory;
+  // Waits for any queued impulse response to finish building, and uses it
+  // from now on (without crossfading, as we're about to be reset anyways).
+  void adoptQueuedImpulseResponse() {
+    {
+      std::lock_guard<std::mutex> builderLock(builderMutex);
+      if (builder.valid())
+        builder.get();
+    }
+
+    std::lock_guard<std::mutex> lock(queuedMutex);
+    if (hasQueuedEngine) {
+      engineFactory = std::move(queuedEngineFactory);
+      std::swap(crossfadeBuffer, queuedCrossfadeBuffer);
+      hasQueuedEngine = false;
+    }
+    queuedEngineFactory.reset();
+    queuedCrossfadeBuffer.setSize(0, 0);
+    retiredEngineFactory.reset();
+    previousEngineFactory.reset();
+    crossfadePosition = crossfadeLength = 0;
+  }
+
+  // Called at the start of each block on the audio thread. This never
+  // blocks, allocates or frees memory: if the background thread holds the
+  // lock, we'll just try again next block.
+  void swapInQueuedEngineIfReady() noexcept {
+    if (!hasQueuedEngine.load(std::memory_order_acquire))
+      return;
+
+    std::unique_lock<std::mutex> lock(queuedMutex, std::try_to_lock);
+    if (!lock.owns_lock() || !hasQueuedEngine || !queuedEngineFactory ||
+        !queuedEngineFactory->hasEngine() ||
+        !queuedEngineFactory->hasSameProcessSpec(*engineFactory))
+      return;
+
+    // The engine we crossfaded away from last time (if any) gets freed by
+    // the background thread or the next call to prepare().
+    retiredEngineFactory = std::move(previousEngineFactory);
+    previousEngineFactory = std::move(engineFactory);
+    engineFactory = std::move(queuedEngineFactory);
+    std::swap(crossfadeBuffer, queuedCrossfadeBuffer);
+    hasQueuedEngine = false;
+
+    const auto &spec = engineFactory->getProcessSpec();
+    const auto canCrossfade =
+        previousEngineFactory->hasEngine() &&
+        crossfadeBuffer.getNumChannels() >= (int)spec.numChannels &&
+        crossfadeBuffer.getNumSamples() >= (int)spec.maximumBlockSize;
+
+    crossfadePosition = 0;
+    crossfadeLength =
+        canCrossfade ? (size_t)jmax(0.0, queuedCrossfadeSeconds *
+                                             spec.sampleRate)
+                     : 0;
+  }
+
+  // Runs both the previous and current engines, ramping linearly from the
+  // output of the former to the output of the latter.
+  void processSamplesWithCrossfade(const AudioBlock<const float> &input,
+                                   AudioBlock<float> &output) {
+    const auto numChannels = output.getNumChannels();
+    const auto numSamples = output.getNumSamples();
+
+    // As input and output may be the same block, run the previous engine
+    // first, into a separate buffer.
+    auto previousOutput = AudioBlock<float>(crossfadeBuffer)
+                              .getSubsetChannelBlock(0, numChannels)
+                              .getSubBlock(0, numSamples);
+    previousEngineFactory->getEngine().processSamples(input, previousOutput);
+    engineFactory->getEngine().processSamples(input, output);
+
+    for (size_t channel = 0; channel < numChannels; ++channel) {
+      const auto *previous = previousOutput.getChannelPointer(channel);
+      auto *current = output.getChannelPointer(channel);
+
+      for (size_t i = 0; i < numSamples; ++i) {
+        const auto position = crossfadePosition + i;
+        const auto gain = position >= crossfadeLength
+                              ? 1.0f
+                              : (float)position / (float)crossfadeLength;
+        current[i] = previous[i] + gain * (current[i] - previous[i]);
+      }
+    }
+
+    crossfadePosition += numSamples;
+  }
+
+  const Convolution::Latency requiredLatency;
+  const Convolution::NonUniform requiredHeadSize;
+
+  std::unique_ptr<BlockingConvolutionEngineFactory> engineFactory;
+
+  // Set while an impulse response is being decoded on another thread.
+  std::future<BufferWithSampleRate> pendingImpulseResponse;
+  Convolution::Stereo pendingStereo = Convolution::Stereo::yes;
+  Convolution::Trim pendingTrim = Convolution::Trim::no;
+  Convolution::Normalise pendingNormalise = Convolution::Normalise::yes;
+
+  // Copies of the settings used to build queued engines, which can be read
+  // from any thread.
+  std::mutex settingsMutex;
+  ProcessSpec preparedSpec{44100.0, 128, 2};
+  bool offline = false;
+  File partitionCacheDirectory;
+  double residentImpulseResponseSeconds = -1.0;
+  std::optional<float> tailTruncationDecibels;
+
+  // An engine built by queueImpulseResponse, waiting to be swapped in.
+  std::mutex queuedMutex;
+  std::atomic<bool> hasQueuedEngine{false};
+  std::unique_ptr<BlockingConvolutionEngineFactory> queuedEngineFactory;
+  std::unique_ptr<BlockingConvolutionEngineFactory> retiredEngineFactory;
+  AudioBuffer<float> queuedCrossfadeBuffer;
+  double queuedCrossfadeSeconds = 0.0;
+
+  // The engine we're crossfading away from, only used on the audio thread.
+  std::unique_ptr<BlockingConvolutionEngineFactory> previousEngineFactory;
+  AudioBuffer<float> crossfadeBuffer;
+  size_t crossfadePosition = 0, crossfadeLength = 0;
+
+  // Waited on when destroyed (see ~Impl), as it refers to this object.
+  std::mutex builderMutex;
+  std::future<void> builder;
 };
 
 //==============================================================================
@@ -806,13 +2449,95 @@ void BlockingConvolution::loadImpulseResponse(
                              trim, normalise);
 }
 
+void BlockingConvolution::loadImpulseResponseAsync(
+    const File &fileImpulseResponse, Convolution::Stereo stereo,
+    Convolution::Trim trim, size_t size, Convolution::Normalise normalise) {
+  pimpl->loadImpulseResponseAsync(fileImpulseResponse, stereo, trim, size,
+                                  normalise);
+}
+
+bool BlockingConvolution::isLoadingImpulseResponse() const {
+  return pimpl->isLoadingImpulseResponse();
+}
+
+void BlockingConvolution::preloadImpulseResponses(const std::vector<File> &files,
+                                                  size_t size) {
+  std::vector<std::future<bool>> decoded;
+  for (const auto &file : files)
+    decoded.push_back(
+        BackgroundThreadPool::getInstance().submit([file, size]() {
+          auto buffer =
+              loadStreamToBuffer(std::make_unique<FileInputStream>(file), size);
+          if (buffer.buffer.getNumSamples() == 0)
+            return false;
+
+          DecodedImpulseResponseCache::getInstance().store(file, size, buffer);
+          return true;
+        }));
+
+  StringArray failures;
+  for (size_t i = 0; i < files.size(); ++i)
+    if (!decoded[i].get())
+      failures.add(files[i].getFullPathName());
+
+  if (!failures.isEmpty())
+    throw std::runtime_error("Unable to load impulse response(s): " +
+                             failures.joinIntoString(", ").toStdString());
+}
+
+void BlockingConvolution::clearPreloadedImpulseResponses() {
+  DecodedImpulseResponseCache::getInstance().clear();
+}
+
+size_t BlockingConvolution::getPreloadedImpulseResponsesSize() {
+  return DecodedImpulseResponseCache::getInstance().getSizeInBytes();
+}
+
 void BlockingConvolution::prepare(const ProcessSpec &spec) {
+  // Measured (once) here, before taking any of the engine's locks:
+  getDirectFormCrossoverLength();
   pimpl->prepare(spec);
   isActive = true;
 }
 
 void BlockingConvolution::reset() noexcept { pimpl->reset(); }
 
+void BlockingConvolution::release() {
+  pimpl->release();
+  isActive = false;
+}
+
+void BlockingConvolution::setOfflineMode(bool shouldBeOffline) {
+  pimpl->setOfflineMode(shouldBeOffline);
+}
+
+bool BlockingConvolution::isOffline() const { return pimpl->isOffline(); }
+
+void BlockingConvolution::loadImpulseResponseWithCrossfade(
+    const File &fileImpulseResponse, Convolution::Stereo stereo,
+    Convolution::Trim trim, size_t size, Convolution::Normalise normalise,
+    double crossfadeSeconds) {
+  pimpl->queueImpulseResponse(fileImpulseResponse, stereo, trim, size,
+                              normalise, crossfadeSeconds);
+}
+
+void BlockingConvolution::setTailTruncation(std::optional<float> decibels) {
+  pimpl->setTailTruncation(decibels);
+}
+
+void BlockingConvolution::setResidentImpulseResponseLength(double seconds) {
+  pimpl->setResidentImpulseResponseLength(seconds);
+}
+
+void BlockingConvolution::setPartitionCacheDirectory(const File &directory) {
+  pimpl->setPartitionCacheDirectory(directory);
+}
+
+void BlockingConvolution::copyImpulseResponseFrom(
+    const BlockingConvolution &other) {
+  pimpl->copyImpulseResponseFrom(*other.pimpl);
+}
+
 void BlockingConvolution::processSamples(const AudioBlock<const float> &input,
                                          AudioBlock<float> &output,
                                          bool isBypassed) noexcept {
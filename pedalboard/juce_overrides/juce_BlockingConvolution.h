@@ -1,5 +1,7 @@
 #include "../JuceHeader.h"
 
+#include <optional>
+
 /*
   ==============================================================================
 
@@ -49,6 +51,11 @@ namespace dsp {
     latency version of the algorithm, or a simple non-uniform partitioned
     convolution algorithm.
 
+    Impulse responses with four channels are treated as true-stereo impulse
+    responses, with channels for the L->L, L->R, R->L and R->R paths (in that
+    order), as long as isStereo is set and uniform partitioning is used. Each
+    output channel is then the sum of both input channels' paths to it.
+
     @see FIRFilter, FIRFilter::Coefficients, FFT
 
     @tags{DSP}
@@ -101,6 +108,62 @@ public:
   /** Resets the processing pipeline ready to start a new stream of data. */
   void reset() noexcept;
 
+  /** Frees the memory used for processing, while keeping the impulse
+      response. prepare() must be called again before processing.
+  */
+  void release();
+
+  /** Enables or disables offline mode, for when each call to process() will
+      be passed a very large block of audio (like an entire file).
+
+      In offline mode, the partition size is chosen based on the length of the
+      impulse response rather than the block size, which uses far fewer FFTs
+      for long blocks but is much slower for short ones. This has no effect
+      on convolutions with a fixed latency or non-uniform partitioning.
+  */
+  void setOfflineMode(bool shouldBeOffline);
+
+  /** Returns true if offline mode is enabled. */
+  bool isOffline() const;
+
+  /** Copies the impulse response loaded into another BlockingConvolution
+      (including its original sample rate and normalisation) without
+      reloading it from disk.
+  */
+  void copyImpulseResponseFrom(const BlockingConvolution &other);
+
+  /** Sets a directory in which to cache the partitioned, frequency-domain
+      form of impulse responses loaded from files, for each sample rate and
+      block size they're prepared with. Later loads of the same (unchanged)
+      file, even from other processes, memory-map the cached partitions
+      instead of decoding and transforming the file again.
+
+      This must be called before loadImpulseResponse() to avoid decoding the
+      file at all. Only zero-latency, uniformly partitioned convolutions are
+      cached.
+  */
+  void setPartitionCacheDirectory(const File &directory);
+
+  /** Limits how much of the (partitioned, frequency-domain) impulse response
+      is kept in memory. Partitions more than this many seconds into the
+      impulse response are moved into memory-mapped temporary files, which
+      the OS pages in as processing reaches them and can evict again when
+      memory is short. This trades memory for throughput with very long
+      impulse responses. Pass a negative value to keep everything in memory
+      (the default).
+  */
+  void setResidentImpulseResponseLength(double seconds);
+
+  /** Trades accuracy for speed by truncating the impulse response where its
+      energy decay curve (the energy remaining after each sample) falls below
+      the given level, relative to its total energy. The early part of the
+      impulse response is kept exactly, and its last few milliseconds are
+      faded out. As the cost of convolution grows with the length of the
+      impulse response, this can make long reverbs much cheaper to apply.
+      Pass std::nullopt to use the whole impulse response (the default).
+  */
+  void setTailTruncation(std::optional<float> decibels);
+
   /** Performs the filter operation on the given set of samples with optional
       stereo processing.
   */
@@ -164,6 +227,59 @@ public:
                            Convolution::Normalise requiresNormalisation =
                                Convolution::Normalise::yes);
 
+  /** Like loadImpulseResponse(), but decodes the file on a background
+      thread (from a pool shared by every BlockingConvolution) and returns
+      immediately. The next call to prepare() waits for decoding to finish
+      (if it hasn't already) and applies the result.
+  */
+  void loadImpulseResponseAsync(const File &fileImpulseResponse,
+                                Convolution::Stereo isStereo,
+                                Convolution::Trim requiresTrimming, size_t size,
+                                Convolution::Normalise requiresNormalisation =
+                                    Convolution::Normalise::yes);
+
+  /** Loads a new impulse response while audio may be being processed on
+      another thread, without blocking it. The new engine is built on a
+      background thread, then swapped in at the start of the next block
+      processed once it's ready, crossfading from the previous impulse
+      response over crossfadeSeconds.
+
+      If prepare() is called before the swap happens, it waits for the new
+      engine and uses it immediately, without crossfading.
+  */
+  void loadImpulseResponseWithCrossfade(
+      const File &fileImpulseResponse, Convolution::Stereo isStereo,
+      Convolution::Trim requiresTrimming, size_t size,
+      Convolution::Normalise requiresNormalisation, double crossfadeSeconds);
+
+  /** Returns true if an impulse response passed to loadImpulseResponseAsync()
+      hasn't yet been applied.
+  */
+  bool isLoadingImpulseResponse() const;
+
+  /** Decodes a number of impulse response files in parallel and keeps the
+      results in memory, so that later calls to loadImpulseResponse() and
+      loadImpulseResponseAsync() with the same file and size don't have to
+      read or decode it again. Cached files are re-read if they change on
+      disk.
+
+      Files are decoded on a shared pool of background threads. Decoded files
+      are kept until they take up more than 1 GiB in total, after which the
+      least recently used are discarded.
+
+      Throws a std::runtime_error if any file could not be decoded.
+  */
+  static void preloadImpulseResponses(const std::vector<File> &files,
+                                      size_t size = 0);
+
+  /** Discards every file kept in memory by preloadImpulseResponses(). */
+  static void clearPreloadedImpulseResponses();
+
+  /** Returns the size (in bytes) of the files kept in memory by
+      preloadImpulseResponses().
+  */
+  static size_t getPreloadedImpulseResponsesSize();
+
   /** This function loads an impulse response from an audio buffer.
       To avoid memory allocation on the audio thread, this function takes
       ownership of the buffer passed in.
@@ -200,6 +316,18 @@ public:
   */
   int getLatency() const;
 
+  /** Switches every BlockingConvolution in this process between the fused,
+      vectorized complex multiply-accumulate and the four-pass version used by
+      juce::dsp::Convolution. Only intended for benchmarking.
+  */
+  static void setUseReferenceMultiplyAccumulate(bool useReference);
+
+  /** Returns the longest impulse response (in samples) that's convolved in
+      the time domain rather than with FFTs, when there's no latency. This is
+      measured the first time it's needed, unless set at build time.
+  */
+  static size_t getDirectFormCrossoverLength();
+
 private:
   //==============================================================================
   BlockingConvolution(const Convolution::Latency &,
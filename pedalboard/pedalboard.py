@@ -16,6 +16,7 @@
 
 import collections
 import platform
+import threading
 import weakref
 from functools import update_wrapper
 from contextlib import contextmanager
@@ -23,7 +24,13 @@ from typing import List, Optional, Dict, Union, Tuple, Iterable
 
 import numpy as np
 
-from pedalboard_native import Plugin, process, _AudioProcessorParameter
+from pedalboard_native import Plugin, process
+
+try:
+    from pedalboard_native import _AudioProcessorParameter
+except ImportError:
+    # Headless builds of pedalboard can't host external plugins.
+    _AudioProcessorParameter = None
 
 
 class Pedalboard(collections.MutableSequence):
@@ -129,6 +136,15 @@ class Pedalboard(collections.MutableSequence):
     # Alias process to __call__, so that people can call Pedalboards like functions.
     __call__ = process
 
+    def release(self) -> None:
+        """
+        Free any memory used by the plugins in this Pedalboard for processing audio,
+        while keeping their parameters. Memory will be re-allocated on next use.
+        """
+        for plugin in self.plugins:
+            if plugin is not None:
+                plugin.release()
+
 
 FLOAT_SUFFIXES_TO_IGNORE = "x%*,."
 
@@ -473,6 +489,11 @@ def to_python_parameter_name(parameter: _AudioProcessorParameter) -> Optional[st
     return name
 
 
+# Guards the creation of each ExternalPlugin's parameter cache lock. Without the GIL
+# (i.e.: on free-threaded Python builds) two threads could otherwise both create a lock.
+_PARAMETER_CACHE_LOCK_CREATION_LOCK = threading.Lock()
+
+
 class ExternalPlugin(object):
     def __set_initial_parameter_values__(
         self, parameter_values: Dict[str, Union[str, int, float, bool]] = {}
@@ -491,43 +512,58 @@ class ExternalPlugin(object):
     def parameters(self) -> Dict[str, AudioProcessorParameter]:
         return self._get_parameters()
 
+    def _get_parameter_cache_lock(self) -> threading.RLock:
+        """
+        Returns a lock that must be held while reading or populating this plugin's
+        parameter caches, which may be accessed from multiple threads at once.
+        """
+        try:
+            return self.__python_parameter_cache_lock__
+        except AttributeError:
+            with _PARAMETER_CACHE_LOCK_CREATION_LOCK:
+                if not hasattr(self, "__python_parameter_cache_lock__"):
+                    self.__python_parameter_cache_lock__ = threading.RLock()
+                return self.__python_parameter_cache_lock__
+
     def _get_parameters(self):
-        if not hasattr(self, "__python_parameter_cache__"):
-            self.__python_parameter_cache__ = {}
-        if not hasattr(self, "__python_to_cpp_names__"):
-            self.__python_to_cpp_names__ = {}
+        with self._get_parameter_cache_lock():
+            if not hasattr(self, "__python_parameter_cache__"):
+                self.__python_parameter_cache__ = {}
+            if not hasattr(self, "__python_to_cpp_names__"):
+                self.__python_to_cpp_names__ = {}
+
+            parameters = {}
+            for cpp_parameter in self._parameters:
+                if cpp_parameter.name not in self.__python_parameter_cache__:
+                    self.__python_parameter_cache__[cpp_parameter.name] = AudioProcessorParameter(
+                        self, cpp_parameter.name
+                    )
+                parameter = self.__python_parameter_cache__[cpp_parameter.name]
+                if parameter.python_name:
+                    parameters[parameter.python_name] = parameter
+                    self.__python_to_cpp_names__[parameter.python_name] = cpp_parameter.name
+            return parameters
+
+    def _get_parameter_by_python_name(self, python_name: str) -> AudioProcessorParameter:
+        with self._get_parameter_cache_lock():
+            if not hasattr(self, "__python_parameter_cache__"):
+                self.__python_parameter_cache__ = {}
+            if not hasattr(self, "__python_to_cpp_names__"):
+                self.__python_to_cpp_names__ = {}
+
+            cpp_name = self.__python_to_cpp_names__.get(python_name)
+            if not cpp_name:
+                return self._get_parameters().get(python_name)
+
+            cpp_parameter = self._get_parameter(cpp_name)
+            if not cpp_parameter:
+                return None
 
-        parameters = {}
-        for cpp_parameter in self._parameters:
             if cpp_parameter.name not in self.__python_parameter_cache__:
                 self.__python_parameter_cache__[cpp_parameter.name] = AudioProcessorParameter(
                     self, cpp_parameter.name
                 )
-            parameter = self.__python_parameter_cache__[cpp_parameter.name]
-            if parameter.python_name:
-                parameters[parameter.python_name] = parameter
-                self.__python_to_cpp_names__[parameter.python_name] = cpp_parameter.name
-        return parameters
-
-    def _get_parameter_by_python_name(self, python_name: str) -> AudioProcessorParameter:
-        if not hasattr(self, "__python_parameter_cache__"):
-            self.__python_parameter_cache__ = {}
-        if not hasattr(self, "__python_to_cpp_names__"):
-            self.__python_to_cpp_names__ = {}
-
-        cpp_name = self.__python_to_cpp_names__.get(python_name)
-        if not cpp_name:
-            return self._get_parameters().get(python_name)
-
-        cpp_parameter = self._get_parameter(cpp_name)
-        if not cpp_parameter:
-            return None
-
-        if cpp_parameter.name not in self.__python_parameter_cache__:
-            self.__python_parameter_cache__[cpp_parameter.name] = AudioProcessorParameter(
-                self, cpp_parameter.name
-            )
-        return self.__python_parameter_cache__[cpp_parameter.name]
+            return self.__python_parameter_cache__[cpp_parameter.name]
 
     def __dir__(self):
         parameter_names = []
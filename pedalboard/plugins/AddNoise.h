@@ -0,0 +1,526 @@
+/*
+ * pedalboard
+ * Copyright 2021 Spotify AB
+ *
+ * Licensed under the GNU Public License, Version 3.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <optional>
+#include <random>
+
+#include "../Plugin.h"
+#include "../process.h"
+
+namespace Pedalboard {
+
+enum class NoiseColor { White, Pink, Brown };
+
+/**
+ * Generates white, pink or brown noise in chunks of up to chunkSize samples.
+ *
+ * White noise comes from eight independent xorshift32 generators, stepped
+ * in lockstep so that the compiler can vectorize them. Pink noise is made
+ * by filtering it with Paul Kellett's refined pinking filter, and brown
+ * noise with a leaky integrator. No attempt is made to normalize the level
+ * of the result, as AddNoise measures it anyway.
+ *
+ * All state is held by value, so a copy of a generator produces exactly the
+ * same noise as the original.
+ */
+class NoiseGenerator {
+public:
+  static constexpr int numLanes = 8;
+  static constexpr int chunkSize = 256;
+
+  void seed(uint64_t seed) noexcept {
+    // Expand the seed into each lane's state with splitmix64:
+    for (auto &lane : lanes) {
+      seed += 0x9E3779B97F4A7C15ull;
+      uint64_t z = seed;
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+      lane = static_cast<uint32_t>(z ^ (z >> 31)) | 1u;
+    }
+    for (auto &state : filterState)
+      state = 0;
+  }
+
+  /**
+   * Returns a random integer, for choosing offsets and the like.
+   */
+  uint32_t nextInteger() noexcept { return step(lanes[0]); }
+
+  /**
+   * Fills output with numSamples (at most chunkSize) samples of noise.
+   */
+  void generate(NoiseColor color, float *output, int numSamples) noexcept {
+    jassert(numSamples <= chunkSize);
+
+    const int numSteps = (numSamples + numLanes - 1) / numLanes;
+    for (int i = 0; i < numSteps; i++) {
+      for (int lane = 0; lane < numLanes; lane++) {
+        // Scale the full range of int32_t to [-1, 1):
+        whiteNoise[i * numLanes + lane] =
+            static_cast<float>(static_cast<int32_t>(step(lanes[lane]))) *
+            (1.0f / 2147483648.0f);
+      }
+    }
+
+    switch (color) {
+    case NoiseColor::White:
+      std::copy(whiteNoise, whiteNoise + numSamples, output);
+      break;
+    case NoiseColor::Pink: {
+      float b0 = filterState[0], b1 = filterState[1], b2 = filterState[2],
+            b3 = filterState[3], b4 = filterState[4], b5 = filterState[5],
+            b6 = filterState[6];
+      for (int i = 0; i < numSamples; i++) {
+        const float white = whiteNoise[i];
+        b0 = 0.99886f * b0 + white * 0.0555179f;
+        b1 = 0.99332f * b1 + white * 0.0750759f;
+        b2 = 0.96900f * b2 + white * 0.1538520f;
+        b3 = 0.86650f * b3 + white * 0.3104856f;
+        b4 = 0.55000f * b4 + white * 0.5329522f;
+        b5 = -0.7616f * b5 - white * 0.0168980f;
+        output[i] = b0 + b1 + b2 + b3 + b4 + b5 + b6 + white * 0.5362f;
+        b6 = white * 0.115926f;
+      }
+      filterState = {b0, b1, b2, b3, b4, b5, b6};
+      break;
+    }
+    case NoiseColor::Brown: {
+      float brown = filterState[0];
+      for (int i = 0; i < numSamples; i++) {
+        brown = (brown + 0.02f * whiteNoise[i]) * (1.0f / 1.02f);
+        output[i] = brown;
+      }
+      filterState[0] = brown;
+      break;
+    }
+    }
+  }
+
+private:
+  static uint32_t step(uint32_t &x) noexcept {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+  }
+
+  std::array<uint32_t, numLanes> lanes = {};
+  std::array<float, 7> filterState = {};
+  float whiteNoise[chunkSize];
+};
+
+/**
+ * Adds noise to its input at a given signal-to-noise ratio, measured over
+ * the whole of each block (which is the whole buffer passed to process(),
+ * as this plugin processes whole buffers at once).
+ *
+ * Note that as processesWholeBuffer() is always true, a chain containing
+ * this plugin is processed as a single block: every other plugin in the
+ * chain (including external plugins) is prepared with, and sees, blocks as
+ * long as the whole input, regardless of the buffer size requested.
+ *
+ * The noise is either generated (white, pink or brown), or read from a
+ * provided buffer, starting at a random offset and looping as necessary.
+ * Rather than making a scaled copy of the noise, each block is read twice:
+ * once to measure the noise's energy, then again to add it to the signal
+ * with the right gain. (Generated noise is read twice by generating it
+ * twice from the same state.)
+ */
+class AddNoise : public Plugin {
+public:
+  AddNoise() { seed(std::random_device()()); }
+  virtual ~AddNoise(){};
+
+  void prepare(const juce::dsp::ProcessSpec &spec) override {
+    // Provided noise is resampled to the sample rate of the audio, if
+    // needed. (Arrays are always assumed to be at that sample rate already.)
+    if (noiseSampleRate == 0 || noiseSampleRate == spec.sampleRate) {
+      // Don't leave noise resampled for a previous sample rate behind.
+      release();
+      return;
+    }
+    if (resampledNoiseSampleRate == spec.sampleRate)
+      return;
+
+    const double ratio = noiseSampleRate / spec.sampleRate;
+    const int numSamples = std::max(
+        1, static_cast<int>(std::floor(noise.getNumSamples() / ratio)) - 4);
+    resampledNoise.setSize(noise.getNumChannels(), numSamples);
+    for (int channel = 0; channel < noise.getNumChannels(); channel++) {
+      juce::LagrangeInterpolator interpolator;
+      interpolator.process(ratio, noise.getReadPointer(channel),
+                           resampledNoise.getWritePointer(channel),
+                           numSamples);
+    }
+    resampledNoiseSampleRate = spec.sampleRate;
+  }
+
+  void process(
+      const juce::dsp::ProcessContextReplacing<float> &context) override {
+    auto block = context.getOutputBlock();
+    const int numChannels = static_cast<int>(block.getNumChannels());
+    const int numSamples = static_cast<int>(block.getNumSamples());
+
+    double signalEnergy = 0;
+    for (int channel = 0; channel < numChannels; channel++) {
+      signalEnergy +=
+          getSumOfSquares(block.getChannelPointer(channel), numSamples);
+    }
+
+    // There's no level to add noise relative to in silence.
+    if (signalEnergy == 0)
+      return;
+
+    if (noise.getNumChannels() > 0) {
+      addProvidedNoise(block, signalEnergy);
+    } else {
+      addGeneratedNoise(block, signalEnergy);
+    }
+  }
+
+  // Deliberately leaves the noise generators alone, so that each call to
+  // process() adds different noise.
+  void reset() override {}
+
+  void release() override {
+    resampledNoise = juce::AudioBuffer<float>();
+    resampledNoiseSampleRate = 0;
+  }
+
+  bool processesWholeBuffer() const override { return true; }
+
+  float getSnrDecibels() const { return snrDecibels; }
+  void setSnrDecibels(float newSnrDecibels) {
+    if (!std::isfinite(newSnrDecibels)) {
+      throw std::range_error("SNR must be finite.");
+    }
+    snrDecibels = newSnrDecibels;
+  }
+
+  NoiseColor getColor() const { return color; }
+  void setColor(NoiseColor newColor) { color = newColor; }
+
+  /**
+   * Reseeds the noise generators (which are also used to choose offsets
+   * into provided noise), so that the following calls to process() add the
+   * same noise as the last time this seed was set.
+   */
+  void seed(uint64_t seed) {
+    ScopedGILReleasingLock lock(mutex);
+    for (size_t i = 0; i < generators.size(); i++)
+      generators[i].seed(seed * generators.size() + i);
+  }
+
+  /**
+   * Uses the provided buffer as noise in place of generated noise. If
+   * sampleRate is non-zero, the buffer is resampled to the audio's sample
+   * rate when prepared.
+   */
+  void setNoise(juce::AudioBuffer<float> &&newNoise, double sampleRate) {
+    if (newNoise.getNumSamples() == 0) {
+      throw std::runtime_error("Noise must not be empty.");
+    }
+
+    ScopedGILReleasingLock lock(mutex);
+    noise = std::move(newNoise);
+    noiseSampleRate = sampleRate;
+    release();
+  }
+
+  const juce::AudioBuffer<float> &getNoise() const { return noise; }
+
+private:
+  static double getSumOfSquares(const float *samples, int numSamples) noexcept {
+    // Accumulate in several independent float lanes so that this vectorizes,
+    // but only over short chunks: the total for a whole clip is kept as a
+    // double, so that small squares late in a long clip aren't lost.
+    constexpr int chunkSize = 1024;
+    double sum = 0;
+    int i = 0;
+    while (i + 8 <= numSamples) {
+      const int chunkEnd = std::min(numSamples, i + chunkSize);
+      float lanes[8] = {};
+      for (; i + 8 <= chunkEnd; i += 8) {
+        for (int lane = 0; lane < 8; lane++)
+          lanes[lane] += samples[i + lane] * samples[i + lane];
+      }
+      for (float lane : lanes)
+        sum += lane;
+    }
+
+    for (; i < numSamples; i++)
+      sum += samples[i] * samples[i];
+    return sum;
+  }
+
+  /**
+   * Returns the gain to apply to noise with the given energy, so that the
+   * signal-to-noise ratio of the result is snrDecibels.
+   */
+  float getNoiseGain(double signalEnergy, double noiseEnergy) const noexcept {
+    if (noiseEnergy == 0)
+      return 0;
+    return static_cast<float>(std::sqrt(signalEnergy / noiseEnergy) *
+                              std::pow(10.0, -snrDecibels / 20.0));
+  }
+
+  void addGeneratedNoise(juce::dsp::AudioBlock<float> &block,
+                         double signalEnergy) noexcept {
+    const int numChannels = static_cast<int>(block.getNumChannels());
+    const int numSamples = static_cast<int>(block.getNumSamples());
+    const NoiseColor currentColor = color;
+    float chunk[NoiseGenerator::chunkSize];
+
+    // Measure the noise with copies of the generators...
+    double noiseEnergy = 0;
+    for (int channel = 0; channel < numChannels; channel++) {
+      NoiseGenerator generator = generators[channel];
+      for (int start = 0; start < numSamples;
+           start += NoiseGenerator::chunkSize) {
+        const int chunkLength =
+            std::min(NoiseGenerator::chunkSize, numSamples - start);
+        generator.generate(currentColor, chunk, chunkLength);
+        noiseEnergy += getSumOfSquares(chunk, chunkLength);
+      }
+    }
+
+    // ...then generate it again with the originals, this time adding it in.
+    const float gain = getNoiseGain(signalEnergy, noiseEnergy);
+    for (int channel = 0; channel < numChannels; channel++) {
+      float *output = block.getChannelPointer(channel);
+      for (int start = 0; start < numSamples;
+           start += NoiseGenerator::chunkSize) {
+        const int chunkLength =
+            std::min(NoiseGenerator::chunkSize, numSamples - start);
+        generators[channel].generate(currentColor, chunk, chunkLength);
+        juce::FloatVectorOperations::addWithMultiply(output + start, chunk,
+                                                     gain, chunkLength);
+      }
+    }
+  }
+
+  void addProvidedNoise(juce::dsp::AudioBlock<float> &block,
+                        double signalEnergy) noexcept {
+    const auto &source =
+        resampledNoise.getNumChannels() > 0 ? resampledNoise : noise;
+    const int numChannels = static_cast<int>(block.getNumChannels());
+    const int numSamples = static_cast<int>(block.getNumSamples());
+    const int noiseLength = source.getNumSamples();
+    const int offset =
+        static_cast<int>(generators[0].nextInteger() % noiseLength);
+
+    // Mono noise is added to every channel; stereo noise added to mono
+    // audio only uses its first channel.
+    auto forEachSpan = [&](int channel, auto &&callback) {
+      const float *noiseChannel = source.getReadPointer(
+          std::min(channel, source.getNumChannels() - 1));
+      int position = offset;
+      for (int start = 0; start < numSamples;) {
+        const int spanLength =
+            std::min(numSamples - start, noiseLength - position);
+        callback(start, noiseChannel + position, spanLength);
+        start += spanLength;
+        position = 0;
+      }
+    };
+
+    double noiseEnergy = 0;
+    for (int channel = 0; channel < numChannels; channel++) {
+      forEachSpan(channel, [&](int, const float *span, int spanLength) {
+        noiseEnergy += getSumOfSquares(span, spanLength);
+      });
+    }
+
+    const float gain = getNoiseGain(signalEnergy, noiseEnergy);
+    for (int channel = 0; channel < numChannels; channel++) {
+      float *output = block.getChannelPointer(channel);
+      forEachSpan(channel, [&](int start, const float *span, int spanLength) {
+        juce::FloatVectorOperations::addWithMultiply(output + start, span,
+                                                     gain, spanLength);
+      });
+    }
+  }
+
+  std::atomic<float> snrDecibels{20.0f};
+  std::atomic<NoiseColor> color{NoiseColor::White};
+  std::array<NoiseGenerator, 2> generators;
+
+  // Empty unless noise was provided:
+  juce::AudioBuffer<float> noise;
+  double noiseSampleRate = 0;
+  juce::AudioBuffer<float> resampledNoise;
+  double resampledNoiseSampleRate = 0;
+};
+
+using NoiseArray =
+    py::array_t<float, py::array::c_style | py::array::forcecast>;
+
+/**
+ * Copies noise passed from Python into a buffer, accepting the same shapes
+ * that process() does.
+ */
+inline juce::AudioBuffer<float> noiseFromArray(const NoiseArray &array) {
+  py::buffer_info info = array.request();
+  unsigned int numChannels = 1;
+  unsigned int numSamples = 0;
+  ChannelLayout layout = ChannelLayout::Interleaved;
+
+  if (info.ndim == 1) {
+    numSamples = info.shape[0];
+  } else if (info.ndim == 2 && info.shape[1] < info.shape[0]) {
+    numSamples = info.shape[0];
+    numChannels = info.shape[1];
+  } else if (info.ndim == 2 && info.shape[0] < info.shape[1]) {
+    numSamples = info.shape[1];
+    numChannels = info.shape[0];
+    layout = ChannelLayout::NotInterleaved;
+  } else {
+    throw std::runtime_error(
+        "Unable to determine channel layout of noise from its shape!");
+  }
+
+  if (numChannels > 2) {
+    throw std::runtime_error("Noise must have one or two channels.");
+  }
+
+  juce::AudioBuffer<float> noise(numChannels, numSamples);
+  copyInputSamples(info, layout, numChannels, numSamples, 0, numSamples,
+                   noise.getArrayOfWritePointers());
+  return noise;
+}
+
+/**
+ * Decodes an audio file of noise (keeping at most two channels), returning
+ * the noise and its sample rate.
+ */
+inline std::pair<juce::AudioBuffer<float>, double>
+noiseFromFile(const std::string &filename) {
+  juce::AudioFormatManager manager;
+  manager.registerBasicFormats();
+  std::unique_ptr<juce::AudioFormatReader> reader(
+      manager.createReaderFor(juce::File(filename)));
+  if (!reader) {
+    throw std::runtime_error("Unable to load noise file: " + filename);
+  }
+
+  juce::AudioBuffer<float> noise(
+      juce::jlimit(1, 2, static_cast<int>(reader->numChannels)),
+      static_cast<int>(reader->lengthInSamples));
+  reader->read(noise.getArrayOfWritePointers(), noise.getNumChannels(), 0,
+               noise.getNumSamples());
+  return {std::move(noise), reader->sampleRate};
+}
+
+inline void init_addnoise(py::module &m) {
+  py::class_<AddNoise, Plugin> addNoise(
+      m, "AddNoise",
+      "Adds noise to audio at a given signal-to-noise ratio (in decibels), "
+      "measured over the whole of the audio passed to process.\n\n"
+      "By default, white, pink or brown noise is generated: different noise "
+      "each time process is called, or a repeatable sequence if a seed is "
+      "provided. Alternatively, noise can be provided as an array (at the "
+      "same sample rate as the audio it'll be added to) or as the path to "
+      "an audio file (which is resampled as needed). Provided noise is "
+      "added starting at a random offset, and loops if it's shorter than "
+      "the audio.\n\n"
+      "As the signal-to-noise ratio is measured over the whole of the "
+      "audio, it is processed as a single block: buffer_size is ignored, "
+      "for this plugin and for every other plugin in the same chain "
+      "(including VST3 and Audio Unit plugins, which are prepared with a "
+      "block as long as the audio).");
+
+  py::enum_<NoiseColor>(addNoise, "Color")
+      .value("White", NoiseColor::White, "flat spectrum")
+      .value("Pink", NoiseColor::Pink, "falls by 3 dB/octave")
+      .value("Brown", NoiseColor::Brown, "falls by 6 dB/octave")
+      .export_values();
+
+  addNoise
+      .def(py::init([](float snrDecibels, NoiseColor color,
+                       std::optional<NoiseArray> noise,
+                       std::optional<std::string> noiseFilename,
+                       std::optional<uint64_t> seed) {
+             if (noise && noiseFilename) {
+               throw std::invalid_argument(
+                   "Only one of noise or noise_filename can be provided.");
+             }
+
+             auto plugin = std::make_unique<AddNoise>();
+             plugin->setSnrDecibels(snrDecibels);
+             plugin->setColor(color);
+             if (seed)
+               plugin->seed(*seed);
+
+             if (noise) {
+               plugin->setNoise(noiseFromArray(*noise), 0);
+             } else if (noiseFilename) {
+               py::gil_scoped_release release;
+               auto [buffer, sampleRate] = noiseFromFile(*noiseFilename);
+               plugin->setNoise(std::move(buffer), sampleRate);
+             }
+             return plugin;
+           }),
+           py::arg("snr_db") = 20.0, py::arg("color") = NoiseColor::White,
+           py::arg("noise") = py::none(),
+           py::arg("noise_filename") = py::none(),
+           py::arg("seed") = py::none())
+      .def("__repr__",
+           [](const AddNoise &plugin) {
+             std::ostringstream ss;
+             ss << "<pedalboard.AddNoise";
+             ss << " snr_db=" << plugin.getSnrDecibels();
+             const auto &noise = plugin.getNoise();
+             if (noise.getNumChannels() > 0) {
+               ss << " noise=<" << noise.getNumChannels() << " channel(s), "
+                  << noise.getNumSamples() << " samples>";
+             } else {
+               ss << " color=";
+               switch (plugin.getColor()) {
+               case NoiseColor::White:
+                 ss << "pedalboard.AddNoise.White";
+                 break;
+               case NoiseColor::Pink:
+                 ss << "pedalboard.AddNoise.Pink";
+                 break;
+               case NoiseColor::Brown:
+                 ss << "pedalboard.AddNoise.Brown";
+                 break;
+               }
+             }
+             ss << " at " << &plugin;
+             ss << ">";
+             return ss.str();
+           })
+      .def_property("snr_db", &AddNoise::getSnrDecibels,
+                    &AddNoise::setSnrDecibels)
+      .def_property("color", &AddNoise::getColor, &AddNoise::setColor)
+      .def("seed", &AddNoise::seed,
+           "Reseed the noise generator, so that the following calls to "
+           "process add the same noise as they did the last time this seed "
+           "was used.",
+           py::arg("seed"));
+}
+}; // namespace Pedalboard
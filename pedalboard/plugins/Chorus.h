@@ -23,8 +23,277 @@ namespace py = pybind11;
 #include "../JucePlugin.h"
 
 namespace Pedalboard {
+
+/**
+ * A chorus (or flanger) with the same parameters and sound as
+ * juce::dsp::Chorus, but that does its work a block at a time instead of a
+ * sample at a time. For each block, the LFO (a polynomial sine approximation,
+ * rather than a per-sample call to std::sin) and the resulting delay times
+ * are computed up front, and the delay line is read with simple loops over
+ * the block that the compiler can vectorize.
+ *
+ * Buffers are only allocated when first prepared, and are freed again when
+ * released.
+ */
+template <typename SampleType> class ReleasableChorus {
+public:
+  void setRate(SampleType newRate) { rate = newRate; }
+  void setDepth(SampleType newDepth) { depth = newDepth; }
+  void setCentreDelay(SampleType newCentreDelay) {
+    centreDelay = newCentreDelay;
+  }
+  void setFeedback(SampleType newFeedback) { feedback = newFeedback; }
+  void setMix(SampleType newMix) { mix = newMix; }
+
+  void prepare(const juce::dsp::ProcessSpec &spec) {
+    if (buffers && buffers->sampleRate == spec.sampleRate &&
+        buffers->delayLines.getNumChannels() == (int)spec.numChannels)
+      return;
+
+    buffers = std::make_unique<Buffers>();
+    buffers->sampleRate = spec.sampleRate;
+
+    // Like juce::dsp::Chorus, make the delay line long enough for the
+    // longest delay possible at the maximum depth and centre delay:
+    buffers->delayLineSize = juce::jmax(
+        4, static_cast<int>(std::ceil((maximumDelayModulation * 0.5 +
+                                       maximumCentreDelayMs) *
+                                      spec.sampleRate / 1000.0)) +
+               1);
+
+    // Each block is written to the delay line before being read back, so
+    // leave room for a whole block on top of the longest delay. Every sample
+    // is stored twice, ringSize apart, so that reads never have to wrap.
+    buffers->ringSize = buffers->delayLineSize + blockSize;
+    buffers->delayLines.setSize(spec.numChannels, buffers->ringSize * 2);
+    buffers->lastOutput.resize(spec.numChannels);
+    reset();
+  }
+
+  void reset() noexcept {
+    if (!buffers)
+      return;
+
+    buffers->delayLines.clear();
+    std::fill(buffers->lastOutput.begin(), buffers->lastOutput.end(), 0);
+    buffers->writePosition = 0;
+    buffers->phase = 0;
+  }
+
+  template <typename ProcessContext>
+  void process(const ProcessContext &context) noexcept {
+    const auto &inputBlock = context.getInputBlock();
+    auto &outputBlock = context.getOutputBlock();
+    const auto numChannels = outputBlock.getNumChannels();
+    const auto numSamples = outputBlock.getNumSamples();
+
+    jassert(inputBlock.getNumChannels() == numChannels);
+    jassert(inputBlock.getNumSamples() == numSamples);
+
+    if (context.isBypassed) {
+      if (context.usesSeparateInputAndOutputBlocks())
+        outputBlock.copyFrom(inputBlock);
+      return;
+    }
+
+    for (size_t start = 0; start < numSamples; start += blockSize) {
+      const int numInBlock =
+          static_cast<int>(std::min<size_t>(blockSize, numSamples - start));
+      const int minimumDelay = computeDelays(numInBlock);
+
+      for (size_t channel = 0; channel < numChannels; channel++) {
+        processChannel(inputBlock.getChannelPointer(channel) + start,
+                       outputBlock.getChannelPointer(channel) + start,
+                       static_cast<int>(channel), numInBlock, minimumDelay);
+      }
+
+      buffers->writePosition += numInBlock;
+      if (buffers->writePosition >= buffers->ringSize)
+        buffers->writePosition -= buffers->ringSize;
+    }
+  }
+
+  void release() { buffers.reset(); }
+
+private:
+  /**
+   * Fills delayIndices and delayFractions with the (fractional) delay, in
+   * samples, for each of the next numSamples samples, and advances the LFO.
+   * Returns the shortest whole-sample delay in the block.
+   */
+  int computeDelays(int numSamples) noexcept {
+    auto &b = *buffers;
+
+    const double increment =
+        juce::MathConstants<double>::twoPi * rate / b.sampleRate;
+    const SampleType startPhase = static_cast<SampleType>(b.phase);
+    const SampleType phaseIncrement = static_cast<SampleType>(increment);
+    const SampleType modulation = maximumDelayModulation * depth * 0.5;
+    const SampleType samplesPerMs =
+        static_cast<SampleType>(b.sampleRate / 1000.0);
+    const SampleType maximumDelay =
+        static_cast<SampleType>(b.delayLineSize - 1);
+
+    for (int i = 0; i < numSamples; i++) {
+      // juce::dsp::Chorus's LFO is sin(phase - pi), or -sin(phase).
+      const SampleType lfo =
+          -fastSin(startPhase + phaseIncrement * static_cast<SampleType>(i));
+      const SampleType delayMs = juce::jmax(static_cast<SampleType>(1),
+                                            modulation * lfo + centreDelay);
+      const SampleType delay = juce::jlimit(
+          static_cast<SampleType>(0), maximumDelay, delayMs * samplesPerMs);
+      const int index = static_cast<int>(delay);
+      b.delayIndices[i] = index;
+      b.delayFractions[i] = delay - static_cast<SampleType>(index);
+    }
+
+    b.phase = std::fmod(b.phase + increment * numSamples,
+                        juce::MathConstants<double>::twoPi);
+    return *std::min_element(b.delayIndices, b.delayIndices + numSamples);
+  }
+
+  void processChannel(const SampleType *input, SampleType *output, int channel,
+                      int numSamples, int minimumDelay) noexcept {
+    auto &b = *buffers;
+    SampleType *wet = b.wet;
+
+    if (feedback == 0) {
+      writeToDelayLine(channel, input, 0, numSamples);
+      readFromDelayLine(channel, 0, numSamples);
+      b.lastOutput[channel] = 0;
+    } else {
+      // With feedback, each sample pushed into the delay line depends on the
+      // previous delayed sample. However, that delayed sample only depends on
+      // samples pushed at least (minimumDelay + 1) samples earlier, so the
+      // block can still be processed in runs of that length, where each run
+      // only reads samples written by previous runs.
+      SampleType *pushed = b.pushed;
+      const int runLength = minimumDelay + 1;
+      for (int i = 0; i < numSamples; i += runLength) {
+        const int numInRun = std::min(runLength, numSamples - i);
+        readFromDelayLine(channel, i, numInRun - 1);
+
+        pushed[i] = input[i] - b.lastOutput[channel];
+        for (int j = i + 1; j < i + numInRun; j++)
+          pushed[j] = input[j] - wet[j - 1] * feedback;
+
+        writeToDelayLine(channel, pushed + i, i, numInRun);
+        readFromDelayLine(channel, i + numInRun - 1, 1);
+        b.lastOutput[channel] = wet[i + numInRun - 1] * feedback;
+      }
+    }
+
+    // juce::dsp::Chorus uses a linear dry/wet mix:
+    const SampleType wetGain = mix;
+    const SampleType dryGain = 1 - mix;
+    for (int i = 0; i < numSamples; i++)
+      output[i] = input[i] * dryGain + wet[i] * wetGain;
+  }
+
+  /**
+   * Writes numSamples samples to the delay line, starting at the given offset
+   * into the current block.
+   */
+  void writeToDelayLine(int channel, const SampleType *samples, int offset,
+                        int numSamples) noexcept {
+    auto &b = *buffers;
+    SampleType *line = b.delayLines.getWritePointer(channel);
+
+    int position = b.writePosition + offset;
+    if (position >= b.ringSize)
+      position -= b.ringSize;
+
+    const int numBeforeWrap = std::min(numSamples, b.ringSize - position);
+    for (int copy = 0; copy < 2; copy++) {
+      SampleType *destination = line + copy * b.ringSize;
+      juce::FloatVectorOperations::copy(destination + position, samples,
+                                        numBeforeWrap);
+      juce::FloatVectorOperations::copy(destination, samples + numBeforeWrap,
+                                        numSamples - numBeforeWrap);
+    }
+  }
+
+  /**
+   * Reads numSamples delayed samples (starting at the given offset into the
+   * current block) into the wet buffer, using linear interpolation between
+   * the two samples either side of each sample's delay time.
+   */
+  void readFromDelayLine(int channel, int offset, int numSamples) noexcept {
+    auto &b = *buffers;
+    const SampleType *line = b.delayLines.getReadPointer(channel);
+    const int ringSize = b.ringSize;
+    const int writePosition = b.writePosition;
+
+    for (int i = offset; i < offset + numSamples; i++) {
+      int position = writePosition + i;
+      position = position >= ringSize ? position - ringSize : position;
+      position += ringSize - b.delayIndices[i];
+
+      const SampleType newer = line[position];
+      const SampleType older = line[position - 1];
+      b.wet[i] = newer + b.delayFractions[i] * (older - newer);
+    }
+  }
+
+  /**
+   * A branchless sine approximation, accurate to within float precision,
+   * that the compiler can vectorize (unlike std::sin).
+   */
+  static SampleType fastSin(SampleType x) noexcept {
+    constexpr SampleType pi = juce::MathConstants<SampleType>::pi;
+    constexpr SampleType twoPi = juce::MathConstants<SampleType>::twoPi;
+    constexpr SampleType halfPi = juce::MathConstants<SampleType>::halfPi;
+
+    // Wrap into [-pi, pi], then fold into [-pi/2, pi/2]:
+    x -= twoPi * static_cast<SampleType>(static_cast<int>(x / twoPi));
+    x = x > pi ? x - twoPi : x;
+    x = x < -pi ? x + twoPi : x;
+    x = x > halfPi ? pi - x : x;
+    x = x < -halfPi ? -pi - x : x;
+
+    // A Taylor series to x^11 is within 6e-8 of sin(x) on [-pi/2, pi/2].
+    const SampleType x2 = x * x;
+    return x *
+           (1 +
+            x2 * (-1 / SampleType(6) +
+                  x2 * (1 / SampleType(120) +
+                        x2 * (-1 / SampleType(5040) +
+                              x2 * (1 / SampleType(362880) +
+                                    x2 * (-1 / SampleType(39916800)))))));
+  }
+
+  // The number of samples processed at a time.
+  static constexpr int blockSize = 256;
+
+  // As in juce::dsp::Chorus: the delay time swings by up to this many
+  // milliseconds (times the depth) either side of the centre delay.
+  static constexpr SampleType maximumDelayModulation = 20;
+  static constexpr double maximumCentreDelayMs = 100;
+
+  struct Buffers {
+    double sampleRate = 0;
+    int delayLineSize = 0;
+    int ringSize = 0;
+    int writePosition = 0;
+    double phase = 0;
+
+    juce::AudioBuffer<SampleType> delayLines;
+    std::vector<SampleType> lastOutput;
+
+    int delayIndices[blockSize];
+    SampleType delayFractions[blockSize];
+    SampleType pushed[blockSize];
+    SampleType wet[blockSize];
+  };
+
+  // Defaults match those of juce::dsp::Chorus.
+  SampleType rate = 1.0, depth = 0.25, centreDelay = 7.0, feedback = 0.0,
+             mix = 0.5;
+  std::unique_ptr<Buffers> buffers;
+};
+
 template <typename SampleType>
-class Chorus : public JucePlugin<juce::dsp::Chorus<SampleType>> {
+class Chorus : public JucePlugin<ReleasableChorus<SampleType>> {
   DEFINE_DSP_SETTER_AND_GETTER(SampleType, Rate, {});
   DEFINE_DSP_SETTER_AND_GETTER(SampleType, Depth, {});
   DEFINE_DSP_SETTER_AND_GETTER(SampleType, CentreDelay, {});
@@ -36,6 +305,18 @@ class Chorus : public JucePlugin<juce::dsp::Chorus<SampleType>> {
   });
 };
 
+/**
+ * juce::dsp::Chorus, which computes its LFO and delay a sample at a time.
+ * Only exposed (privately) so that Chorus can be benchmarked against it.
+ */
+class ReferenceChorus : public JucePlugin<juce::dsp::Chorus<float>> {
+  DEFINE_DSP_SETTER_AND_GETTER(float, Rate, {});
+  DEFINE_DSP_SETTER_AND_GETTER(float, Depth, {});
+  DEFINE_DSP_SETTER_AND_GETTER(float, CentreDelay, {});
+  DEFINE_DSP_SETTER_AND_GETTER(float, Feedback, {});
+  DEFINE_DSP_SETTER_AND_GETTER(float, Mix, {});
+};
+
 inline void init_chorus(py::module &m) {
   py::class_<Chorus<float>, Plugin>(
       m, "Chorus",
@@ -80,6 +361,22 @@ inline void init_chorus(py::module &m) {
       .def_property("feedback", &Chorus<float>::getFeedback,
                     &Chorus<float>::setFeedback)
       .def_property("mix", &Chorus<float>::getMix, &Chorus<float>::setMix);
-  ;
+
+  py::class_<ReferenceChorus, Plugin>(
+      m, "_ReferenceChorus",
+      "juce::dsp::Chorus, for benchmarking Chorus against.")
+      .def(py::init([](float rateHz, float depth, float centreDelayMs,
+                       float feedback, float mix) {
+             auto plugin = new ReferenceChorus();
+             plugin->setRate(rateHz);
+             plugin->setDepth(depth);
+             plugin->setCentreDelay(centreDelayMs);
+             plugin->setFeedback(feedback);
+             plugin->setMix(mix);
+             return plugin;
+           }),
+           py::arg("rate_hz") = 1.0, py::arg("depth") = 0.25,
+           py::arg("centre_delay_ms") = 7.0, py::arg("feedback") = 0.0,
+           py::arg("mix") = 0.5);
 }
 }; // namespace Pedalboard
\ No newline at end of file
@@ -20,7 +20,14 @@
 
 namespace py = pybind11;
 
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
 #include "../JucePlugin.h"
+#include "../process.h"
 
 #include "../juce_overrides/juce_BlockingConvolution.h"
 
@@ -35,56 +42,190 @@ public:
   ConvolutionWithMix() = default;
 
   juce::dsp::BlockingConvolution &getConvolution() { return convolution; }
+  const juce::dsp::BlockingConvolution &getConvolution() const {
+    return convolution;
+  }
 
   void setMix(double newMix) noexcept {
-    mixer.setWetMixProportion(newMix);
     mix = newMix;
+    if (mixer)
+      mixer->setWetMixProportion(newMix);
   }
 
   double getMix() const noexcept { return mix; }
 
-  void setImpulseResponseFilename(std::string &filename) {
-    impulseResponseFilename = filename;
+  // The filename has its own lock, as it can be replaced (by
+  // set_impulse_response) while audio is being processed with the plugin's
+  // lock held, and read from any thread.
+  void setImpulseResponseFilename(std::string filename) {
+    std::lock_guard<std::mutex> lock(filenameMutex);
+    impulseResponseFilename = std::move(filename);
   }
 
-  const std::string &getImpulseResponseFilename() const {
+  std::string getImpulseResponseFilename() const {
+    std::lock_guard<std::mutex> lock(filenameMutex);
     return impulseResponseFilename;
   }
 
   void prepare(const juce::dsp::ProcessSpec &spec) {
     convolution.prepare(spec);
-    mixer.prepare(spec);
-    mixer.setWetMixProportion(mix);
+    if (!mixer)
+      mixer.emplace();
+    // Set before preparing, which snaps the mixer's gains to their targets;
+    // setting it afterwards would ramp from the mixer's default of 1.0.
+    mixer->setWetMixProportion(mix);
+    mixer->prepare(spec);
   }
 
   void reset() noexcept {
     convolution.reset();
-    mixer.reset();
-    mixer.setWetMixProportion(mix);
+    if (mixer) {
+      mixer->reset();
+      mixer->setWetMixProportion(mix);
+    }
   }
 
   template <typename ProcessContext>
   void process(const ProcessContext &context) noexcept {
-    mixer.pushDrySamples(context.getInputBlock());
+    mixer->pushDrySamples(context.getInputBlock());
     convolution.process(context);
-    mixer.mixWetSamples(context.getOutputBlock());
+    mixer->mixWetSamples(context.getOutputBlock());
+  }
+
+  // Free the convolution engine and mixing buffers until next prepared.
+  void release() {
+    convolution.release();
+    mixer.reset();
   }
 
 private:
   juce::dsp::BlockingConvolution convolution;
-  juce::dsp::DryWetMixer<float> mixer;
-  float mix = 1.0;
+  // Only constructed when prepared, as its dry buffer is sized to the block.
+  std::optional<juce::dsp::DryWetMixer<float>> mixer;
+  std::atomic<float> mix{1.0f};
+
+  mutable std::mutex filenameMutex;
   std::string impulseResponseFilename;
 };
 
+/**
+ * The Convolution plugin itself, which can optionally run in offline mode
+ * (processing each input as a single block).
+ */
+class Convolution : public JucePlugin<ConvolutionWithMix> {
+public:
+  bool processesWholeBuffer() const override {
+    return getDSP().getConvolution().isOffline();
+  }
+};
+
+/**
+ * Run many clips through the same impulse response in parallel, using up to
+ * numThreads threads. As convolution is stateful, each thread gets its own
+ * copy of the plugin. The copies share the already-loaded impulse response
+ * and, for uniformly partitioned engines, its transformed partitions: the
+ * first copy prepared for each block size transforms them, and the others
+ * reuse them. (Engines with a disk-backed tail aren't shared.)
+ */
+inline std::vector<py::array_t<float>> processBatch(
+    Convolution &plugin,
+    const std::vector<py::array_t<float, py::array::c_style>> &clips,
+    double sampleRate, unsigned int bufferSize, unsigned int numThreads) {
+  if (numThreads == 0)
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  numThreads = std::min(numThreads, (unsigned int)clips.size());
+
+  std::vector<std::unique_ptr<Convolution>> copies;
+  {
+    py::gil_scoped_release release;
+    std::lock_guard<std::mutex> lock(plugin.mutex);
+    for (unsigned int i = 0; i < numThreads; i++) {
+      auto copy = std::make_unique<Convolution>();
+      auto &convolution = copy->getDSP().getConvolution();
+      convolution.copyImpulseResponseFrom(plugin.getDSP().getConvolution());
+      convolution.setOfflineMode(plugin.getDSP().getConvolution().isOffline());
+      copy->getDSP().setMix(plugin.getDSP().getMix());
+      copy->getDSP().setImpulseResponseFilename(
+          plugin.getDSP().getImpulseResponseFilename());
+      copies.push_back(std::move(copy));
+    }
+  }
+
+  std::vector<py::array_t<float>> results(clips.size());
+  std::vector<std::exception_ptr> errors(numThreads);
+  std::atomic<size_t> nextClip{0};
+
+  {
+    py::gil_scoped_release release;
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < numThreads; i++) {
+      threads.emplace_back([&, i]() {
+        try {
+          // process() needs the GIL to create its output array, but
+          // releases it while running the convolution itself.
+          py::gil_scoped_acquire acquire;
+          std::vector<Plugin *> chain{copies[i].get()};
+          for (size_t clip = nextClip++; clip < clips.size();
+               clip = nextClip++) {
+            results[clip] = process(clips[clip], sampleRate, chain, bufferSize);
+          }
+        } catch (...) {
+          errors[i] = std::current_exception();
+        }
+      });
+    }
+
+    for (auto &thread : threads)
+      thread.join();
+  }
+
+  for (auto &error : errors) {
+    if (error)
+      std::rethrow_exception(error);
+  }
+
+  return results;
+}
+
 inline void init_convolution(py::module &m) {
-  py::class_<JucePlugin<ConvolutionWithMix>, Plugin>(
+  // Exposed for benchmarking the convolution engine against JUCE's original
+  // complex multiply-accumulate:
+  m.def("_set_use_reference_convolution_kernel",
+        &juce::dsp::BlockingConvolution::setUseReferenceMultiplyAccumulate,
+        py::arg("use_reference"));
+  m.def("_get_direct_form_crossover_length",
+        &juce::dsp::BlockingConvolution::getDirectFormCrossoverLength);
+
+  py::class_<Convolution, Plugin>(
       m, "Convolution",
       "An audio convolution, suitable for things like speaker simulation or "
-      "reverb modeling.")
-      .def(py::init([](std::string &impulseResponseFilename, float mix) {
+      "reverb modeling.\n\nFour-channel impulse responses are treated as "
+      "true stereo, with channels for the L->L, L->R, R->L and R->R paths "
+      "(in that order).\n\nIf offline is True, each input is processed as a "
+      "single block (ignoring buffer_size) using partitions sized to the "
+      "impulse response, which is much faster when rendering whole files.\n\n"
+      "If load_async is True, the impulse response is decoded on a background "
+      "thread; the first call to process waits for it to finish loading.\n\n"
+      "If partition_cache_directory is provided, the impulse response's "
+      "frequency-domain partitions are cached in that directory for each "
+      "sample rate and buffer size it's used with, and later Convolution "
+      "plugins (in any process) load them from there instead of decoding and "
+      "transforming the impulse response again.\n\n"
+      "If disk_backed_tail_after_seconds is provided, only that much of the "
+      "impulse response is kept in memory; the rest is kept in a temporary, "
+      "memory-mapped file and paged in as needed. This reduces the memory "
+      "used by very long impulse responses, at some cost in speed.\n\n"
+      "If tail_truncation_db is provided (i.e.: -60), the impulse response is "
+      "cut off (with a short fade) where the energy remaining in it falls "
+      "below that level relative to its total energy. This keeps early "
+      "reflections exact while making long reverbs much cheaper to apply.")
+      .def(py::init([](std::string &impulseResponseFilename, float mix,
+                       bool offline, bool loadAsync,
+                       std::optional<std::string> partitionCacheDirectory,
+                       std::optional<double> diskBackedTailAfterSeconds,
+                       std::optional<float> tailTruncationDecibels) {
              py::gil_scoped_release release;
-             auto plugin = std::make_unique<JucePlugin<ConvolutionWithMix>>();
+             auto plugin = std::make_unique<Convolution>();
              // Load the IR file on construction, to handle errors
              auto inputFile = juce::File(impulseResponseFilename);
              // Test opening the file before we pass it to
@@ -97,36 +238,148 @@ inline void init_convolution(py::module &m) {
                }
              }
 
-             plugin->getDSP().getConvolution().loadImpulseResponse(
-                 inputFile, juce::dsp::Convolution::Stereo::yes,
-                 juce::dsp::Convolution::Trim::no, 0);
+             if (tailTruncationDecibels) {
+               if (*tailTruncationDecibels >= 0) {
+                 throw std::range_error("tail_truncation_db must be negative.");
+               }
+               plugin->getDSP().getConvolution().setTailTruncation(
+                   tailTruncationDecibels);
+             }
+
+             if (diskBackedTailAfterSeconds) {
+               if (*diskBackedTailAfterSeconds < 0) {
+                 throw std::range_error(
+                     "disk_backed_tail_after_seconds must be non-negative.");
+               }
+               plugin->getDSP()
+                   .getConvolution()
+                   .setResidentImpulseResponseLength(
+                       *diskBackedTailAfterSeconds);
+             }
+
+             if (partitionCacheDirectory) {
+               plugin->getDSP().getConvolution().setPartitionCacheDirectory(
+                   juce::File(*partitionCacheDirectory));
+             }
+
+             if (loadAsync) {
+               plugin->getDSP().getConvolution().loadImpulseResponseAsync(
+                   inputFile, juce::dsp::Convolution::Stereo::yes,
+                   juce::dsp::Convolution::Trim::no, 0);
+             } else {
+               plugin->getDSP().getConvolution().loadImpulseResponse(
+                   inputFile, juce::dsp::Convolution::Stereo::yes,
+                   juce::dsp::Convolution::Trim::no, 0);
+             }
+             plugin->getDSP().getConvolution().setOfflineMode(offline);
+             plugin->getDSP().setImpulseResponseFilename(
+                 impulseResponseFilename);
              plugin->getDSP().setMix(mix);
              return plugin;
            }),
-           py::arg("impulse_response_filename"), py::arg("mix") = 1.0)
+           py::arg("impulse_response_filename"), py::arg("mix") = 1.0,
+           py::arg("offline") = false, py::arg("load_async") = false,
+           py::arg("partition_cache_directory") = py::none(),
+           py::arg("disk_backed_tail_after_seconds") = py::none(),
+           py::arg("tail_truncation_db") = py::none())
       .def("__repr__",
-           [](JucePlugin<ConvolutionWithMix> &plugin) {
+           [](Convolution &plugin) {
              std::ostringstream ss;
              ss << "<pedalboard.Convolution";
              ss << " impulse_response_filename="
                 << plugin.getDSP().getImpulseResponseFilename();
              ss << " mix=" << plugin.getDSP().getMix();
+             if (plugin.processesWholeBuffer())
+               ss << " offline=True";
              ss << " at " << &plugin;
              ss << ">";
              return ss.str();
            })
-      .def_property_readonly(
-          "impulse_response_filename",
-          [](JucePlugin<ConvolutionWithMix> &plugin) {
-            return plugin.getDSP().getImpulseResponseFilename();
-          })
+      .def_property_readonly("impulse_response_filename",
+                             [](Convolution &plugin) {
+                               return plugin.getDSP()
+                                   .getImpulseResponseFilename();
+                             })
       .def_property(
-          "mix",
-          [](JucePlugin<ConvolutionWithMix> &plugin) {
-            return plugin.getDSP().getMix();
-          },
-          [](JucePlugin<ConvolutionWithMix> &plugin, double newMix) {
+          "mix", [](Convolution &plugin) { return plugin.getDSP().getMix(); },
+          [](Convolution &plugin, double newMix) {
+            ScopedGILReleasingLock lock(plugin.mutex);
             return plugin.getDSP().setMix(newMix);
-          });
+          })
+      .def_property_readonly("offline",
+                             [](Convolution &plugin) {
+                               return plugin.processesWholeBuffer();
+                             })
+      .def(
+          "set_impulse_response",
+          [](Convolution &plugin, std::string impulseResponseFilename,
+             double crossfadeSeconds) {
+            if (crossfadeSeconds < 0) {
+              throw std::range_error("Crossfade length must be non-negative.");
+            }
+
+            auto inputFile = juce::File(impulseResponseFilename);
+            {
+              juce::FileInputStream stream(inputFile);
+              if (!stream.openedOk()) {
+                throw std::runtime_error("Unable to load impulse response: " +
+                                         impulseResponseFilename);
+              }
+            }
+
+            plugin.getDSP().setImpulseResponseFilename(impulseResponseFilename);
+
+            // Deliberately doesn't take the plugin's lock, as this may be
+            // called while audio is being processed on another thread.
+            py::gil_scoped_release release;
+            plugin.getDSP()
+                .getConvolution()
+                .loadImpulseResponseWithCrossfade(
+                    inputFile, juce::dsp::Convolution::Stereo::yes,
+                    juce::dsp::Convolution::Trim::no, 0,
+                    juce::dsp::Convolution::Normalise::yes, crossfadeSeconds);
+          },
+          "Replace this plugin's impulse response without interrupting "
+          "processing. The new impulse response is prepared on a background "
+          "thread; if audio is being processed on another thread, it switches "
+          "to the new impulse response (crossfading over crossfade_seconds) "
+          "as soon as it's ready. Otherwise, the next call to process will "
+          "use the new impulse response from the start.",
+          py::arg("impulse_response_filename"),
+          py::arg("crossfade_seconds") = 0.05)
+      .def("process_batch", &processBatch,
+           "Convolve each of a list of clips with this plugin's impulse "
+           "response, using up to num_threads threads (or one per CPU core, "
+           "if 0). Returns a list of processed clips, in the same order.",
+           py::arg("clips"), py::arg("sample_rate"),
+           py::arg("buffer_size") = DEFAULT_BUFFER_SIZE,
+           py::arg("num_threads") = 0);
+
+  m.def(
+      "preload_impulse_responses",
+      [](std::vector<std::string> filenames) {
+        py::gil_scoped_release release;
+        std::vector<juce::File> files;
+        for (const auto &filename : filenames)
+          files.emplace_back(filename);
+        juce::dsp::BlockingConvolution::preloadImpulseResponses(files);
+      },
+      "Decode a list of impulse response files in parallel and keep them in "
+      "memory, so that Convolution plugins created from these files later "
+      "don't need to read them from disk again. Up to 1 GiB of decoded "
+      "audio is kept, after which the least recently used files are "
+      "discarded.",
+      py::arg("impulse_response_filenames"));
+
+  m.def(
+      "clear_preloaded_impulse_responses",
+      []() {
+        juce::dsp::BlockingConvolution::clearPreloadedImpulseResponses();
+      },
+      "Discard every impulse response file kept in memory by "
+      "preload_impulse_responses.");
+
+  m.def("_get_preloaded_impulse_responses_size",
+        &juce::dsp::BlockingConvolution::getPreloadedImpulseResponsesSize);
 }
-}; // namespace Pedalboard
\ No newline at end of file
+}; // namespace Pedalboard
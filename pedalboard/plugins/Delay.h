@@ -0,0 +1,365 @@
+/*
+ * pedalboard
+ * Copyright 2021 Spotify AB
+ *
+ * Licensed under the GNU Public License, Version 3.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+
+#include <optional>
+
+#include "../JucePlugin.h"
+
+namespace Pedalboard {
+
+/**
+ * A feedback delay line with one or more output taps, spaced evenly at
+ * multiples of the delay time:
+ *
+ *   line[n] = input[n] + feedback * line[n - delay]
+ *   wet[n] = sum(tapGains[k] * line[n - (k + 1) * delay])
+ *
+ * Rather than indexing the circular buffer one sample at a time, each block
+ * is read and written as (at most) two contiguous spans. Blocks are never
+ * longer than the delay time, so the samples fed back within a block were
+ * always written by an earlier block.
+ *
+ * The circular buffer is only allocated when prepared (and is reallocated if
+ * the delay time or number of taps changes), and is freed when released.
+ */
+template <typename SampleType> class MultiTapDelay {
+public:
+  void setDelaySeconds(SampleType newDelaySeconds) {
+    delaySeconds = newDelaySeconds;
+  }
+  void setFeedback(SampleType newFeedback) { feedback = newFeedback; }
+  void setMix(SampleType newMix) { mix = newMix; }
+
+  // If both the tempo and the number of beats are non-zero, they're used to
+  // calculate the delay time in place of delaySeconds.
+  void setTempoBpm(SampleType newTempoBpm) { tempoBpm = newTempoBpm; }
+  void setDelayBeats(SampleType newDelayBeats) { delayBeats = newDelayBeats; }
+
+  // If empty, a single tap with a gain of 1 is used.
+  void setTapGains(std::vector<SampleType> newTapGains) {
+    tapGains = std::move(newTapGains);
+  }
+  const std::vector<SampleType> &getTapGains() const { return tapGains; }
+
+  void prepare(const juce::dsp::ProcessSpec &spec) {
+    const int newNumTaps = tapGains.empty() ? 1 : (int)tapGains.size();
+
+    // The longest tap is limited to maximumDelaySeconds:
+    const double seconds = std::min(getEffectiveDelaySeconds(),
+                                    maximumDelaySeconds / newNumTaps);
+    const int newDelay =
+        std::max(1, static_cast<int>(std::round(seconds * spec.sampleRate)));
+    const int newChunkSize =
+        std::min(newDelay, static_cast<int>(spec.maximumBlockSize));
+    const int newRingSize = newNumTaps * newDelay + newChunkSize;
+
+    if (ring.getNumChannels() == (int)spec.numChannels &&
+        ring.getNumSamples() == newRingSize && delay == newDelay &&
+        numTaps == newNumTaps)
+      return;
+
+    delay = newDelay;
+    numTaps = newNumTaps;
+    chunkSize = newChunkSize;
+    ring.setSize(spec.numChannels, newRingSize);
+    wet.setSize(1, chunkSize);
+    fedBack.setSize(1, chunkSize);
+    reset();
+  }
+
+  void reset() noexcept {
+    ring.clear();
+    writePosition = 0;
+  }
+
+  template <typename ProcessContext>
+  void process(const ProcessContext &context) noexcept {
+    const auto &inputBlock = context.getInputBlock();
+    auto &outputBlock = context.getOutputBlock();
+    const auto numChannels = outputBlock.getNumChannels();
+    const auto numSamples = outputBlock.getNumSamples();
+
+    jassert(inputBlock.getNumChannels() == numChannels);
+    jassert(inputBlock.getNumSamples() == numSamples);
+    jassert((int)numChannels <= ring.getNumChannels());
+
+    if (context.isBypassed) {
+      if (context.usesSeparateInputAndOutputBlocks())
+        outputBlock.copyFrom(inputBlock);
+      return;
+    }
+
+    SampleType *wetData = wet.getWritePointer(0);
+    SampleType *fedBackData = fedBack.getWritePointer(0);
+    const SampleType dryGain = 1 - mix;
+
+    for (size_t start = 0; start < numSamples; start += chunkSize) {
+      const int numInChunk =
+          static_cast<int>(std::min<size_t>(chunkSize, numSamples - start));
+
+      for (size_t channel = 0; channel < numChannels; channel++) {
+        const SampleType *input = inputBlock.getChannelPointer(channel) + start;
+        SampleType *output = outputBlock.getChannelPointer(channel) + start;
+        SampleType *line = ring.getWritePointer((int)channel);
+
+        if (feedback != 0) {
+          readFromRing(line, writePosition - delay, fedBackData, numInChunk);
+          juce::FloatVectorOperations::multiply(fedBackData, feedback,
+                                                numInChunk);
+          juce::FloatVectorOperations::add(fedBackData, input, numInChunk);
+          writeToRing(line, writePosition, fedBackData, numInChunk);
+        } else {
+          writeToRing(line, writePosition, input, numInChunk);
+        }
+
+        juce::FloatVectorOperations::clear(wetData, numInChunk);
+        for (int tap = 0; tap < numTaps; tap++) {
+          const SampleType gain = tapGains.empty() ? 1 : tapGains[tap];
+          addFromRing(line, writePosition - (tap + 1) * delay, wetData, gain,
+                      numInChunk);
+        }
+
+        juce::FloatVectorOperations::multiply(output, input, dryGain,
+                                              numInChunk);
+        juce::FloatVectorOperations::addWithMultiply(output, wetData, mix,
+                                                     numInChunk);
+      }
+
+      writePosition = (writePosition + numInChunk) % ring.getNumSamples();
+    }
+  }
+
+  void release() {
+    ring = juce::AudioBuffer<SampleType>();
+    wet = juce::AudioBuffer<SampleType>();
+    fedBack = juce::AudioBuffer<SampleType>();
+    delay = 0;
+  }
+
+  static constexpr double maximumDelaySeconds = 30.0;
+
+private:
+  double getEffectiveDelaySeconds() const {
+    if (tempoBpm > 0 && delayBeats > 0)
+      return delayBeats * 60.0 / tempoBpm;
+    return delaySeconds;
+  }
+
+  /**
+   * Calls function(ringPosition, offset, numSamples) once or twice, to cover
+   * numSamples samples of the ring starting at position (which may be
+   * negative or past the end of the ring) without wrapping.
+   */
+  template <typename Function>
+  void forEachSpan(int position, int numSamples, Function &&function) const {
+    const int ringSize = ring.getNumSamples();
+    position = ((position % ringSize) + ringSize) % ringSize;
+    const int numBeforeWrap = std::min(numSamples, ringSize - position);
+    function(position, 0, numBeforeWrap);
+    if (numBeforeWrap < numSamples)
+      function(0, numBeforeWrap, numSamples - numBeforeWrap);
+  }
+
+  void writeToRing(SampleType *line, int position, const SampleType *source,
+                   int numSamples) const noexcept {
+    forEachSpan(position, numSamples, [&](int at, int offset, int count) {
+      juce::FloatVectorOperations::copy(line + at, source + offset, count);
+    });
+  }
+
+  void readFromRing(const SampleType *line, int position,
+                    SampleType *destination, int numSamples) const noexcept {
+    forEachSpan(position, numSamples, [&](int at, int offset, int count) {
+      juce::FloatVectorOperations::copy(destination + offset, line + at,
+                                        count);
+    });
+  }
+
+  void addFromRing(const SampleType *line, int position,
+                   SampleType *destination, SampleType gain,
+                   int numSamples) const noexcept {
+    forEachSpan(position, numSamples, [&](int at, int offset, int count) {
+      juce::FloatVectorOperations::addWithMultiply(destination + offset,
+                                                   line + at, gain, count);
+    });
+  }
+
+  SampleType delaySeconds = 0.5, feedback = 0.0, mix = 0.5, tempoBpm = 0,
+             delayBeats = 0;
+  std::vector<SampleType> tapGains;
+
+  int delay = 0, numTaps = 1, chunkSize = 1, writePosition = 0;
+  juce::AudioBuffer<SampleType> ring, wet, fedBack;
+};
+
+template <typename SampleType>
+class Delay : public JucePlugin<MultiTapDelay<SampleType>> {
+  DEFINE_DSP_SETTER_AND_GETTER(SampleType, DelaySeconds, {
+    if (!(value > 0.0 &&
+          value <= MultiTapDelay<SampleType>::maximumDelaySeconds)) {
+      throw std::range_error(
+          "Delay must be greater than 0 and at most 30 seconds.");
+    }
+  });
+  DEFINE_DSP_SETTER_AND_GETTER(SampleType, Feedback, {
+    if (value < 0.0 || value > 1.0) {
+      throw std::range_error("Feedback must be between 0.0 and 1.0.");
+    }
+  });
+  DEFINE_DSP_SETTER_AND_GETTER(SampleType, Mix, {
+    if (value < 0.0 || value > 1.0) {
+      throw std::range_error("Mix must be between 0.0 and 1.0.");
+    }
+  });
+  // Zero if not tempo-synced.
+  DEFINE_DSP_SETTER_AND_GETTER(SampleType, TempoBpm, {
+    if (value < 0.0) {
+      throw std::range_error("Tempo must be positive.");
+    }
+  });
+  DEFINE_DSP_SETTER_AND_GETTER(SampleType, DelayBeats, {
+    if (value < 0.0) {
+      throw std::range_error("Delay (in beats) must be positive.");
+    }
+  });
+
+  std::vector<SampleType> getTapGains() {
+    ScopedGILReleasingLock lock(this->mutex);
+    return this->getDSP().getTapGains();
+  }
+
+  void setTapGains(std::vector<SampleType> tapGains) {
+    ScopedGILReleasingLock lock(this->mutex);
+    this->getDSP().setTapGains(std::move(tapGains));
+  }
+};
+
+inline void init_delay(py::module &m) {
+  // Tempo and beats are stored as zero when not set, but exposed as None.
+  auto zeroToNone = [](float value) -> std::optional<float> {
+    if (value == 0)
+      return {};
+    return value;
+  };
+  auto noneToZero = [](std::optional<float> value, const char *name) {
+    if (!value)
+      return 0.0f;
+    if (!(*value > 0))
+      throw std::range_error(std::string(name) + " must be positive.");
+    return *value;
+  };
+
+  py::class_<Delay<float>, Plugin>(
+      m, "Delay",
+      "A digital delay (echo) effect, with feedback, a dry/wet mix control, "
+      "and delay times of up to 30 seconds.\n\n"
+      "To synchronize the delay to a tempo, pass tempo_bpm and delay_beats "
+      "(i.e.: delay_beats=0.75 for a dotted eighth note) instead of "
+      "delay_seconds.\n\n"
+      "To use multiple taps, pass a list of gains as tap_gains: the Nth gain "
+      "is applied to an echo delayed by N times the delay time. (If the "
+      "longest tap would be longer than 30 seconds, the delay time is "
+      "shortened to fit.)")
+      .def(py::init([noneToZero](float delaySeconds, float feedback, float mix,
+                       std::optional<float> tempoBpm,
+                       std::optional<float> delayBeats,
+                       std::optional<std::vector<float>> tapGains) {
+             if (tempoBpm.has_value() != delayBeats.has_value()) {
+               throw std::range_error(
+                   "tempo_bpm and delay_beats must be provided together.");
+             }
+             if (tapGains && tapGains->empty()) {
+               throw std::range_error("tap_gains must not be empty.");
+             }
+
+             auto plugin = std::make_unique<Delay<float>>();
+             plugin->setDelaySeconds(delaySeconds);
+             plugin->setFeedback(feedback);
+             plugin->setMix(mix);
+             plugin->setTempoBpm(noneToZero(tempoBpm, "tempo_bpm"));
+             plugin->setDelayBeats(noneToZero(delayBeats, "delay_beats"));
+             plugin->setTapGains(tapGains.value_or(std::vector<float>()));
+             return plugin;
+           }),
+           py::arg("delay_seconds") = 0.5, py::arg("feedback") = 0.0,
+           py::arg("mix") = 0.5, py::arg("tempo_bpm") = py::none(),
+           py::arg("delay_beats") = py::none(),
+           py::arg("tap_gains") = py::none())
+      .def("__repr__",
+           [](Delay<float> &plugin) {
+             std::ostringstream ss;
+             ss << "<pedalboard.Delay";
+             ss << " delay_seconds=" << plugin.getDelaySeconds();
+             ss << " feedback=" << plugin.getFeedback();
+             ss << " mix=" << plugin.getMix();
+             if (plugin.getTempoBpm() > 0) {
+               ss << " tempo_bpm=" << plugin.getTempoBpm();
+               ss << " delay_beats=" << plugin.getDelayBeats();
+             }
+             auto tapGains = plugin.getTapGains();
+             if (!tapGains.empty()) {
+               ss << " tap_gains=[";
+               for (size_t i = 0; i < tapGains.size(); i++)
+                 ss << (i ? ", " : "") << tapGains[i];
+               ss << "]";
+             }
+             ss << " at " << &plugin;
+             ss << ">";
+             return ss.str();
+           })
+      .def_property("delay_seconds", &Delay<float>::getDelaySeconds,
+                    &Delay<float>::setDelaySeconds)
+      .def_property("feedback", &Delay<float>::getFeedback,
+                    &Delay<float>::setFeedback)
+      .def_property("mix", &Delay<float>::getMix, &Delay<float>::setMix)
+      .def_property(
+          "tempo_bpm",
+          [zeroToNone](const Delay<float> &plugin) {
+            return zeroToNone(plugin.getTempoBpm());
+          },
+          [noneToZero](Delay<float> &plugin, std::optional<float> tempoBpm) {
+            plugin.setTempoBpm(noneToZero(tempoBpm, "tempo_bpm"));
+          })
+      .def_property(
+          "delay_beats",
+          [zeroToNone](const Delay<float> &plugin) {
+            return zeroToNone(plugin.getDelayBeats());
+          },
+          [noneToZero](Delay<float> &plugin, std::optional<float> delayBeats) {
+            plugin.setDelayBeats(noneToZero(delayBeats, "delay_beats"));
+          })
+      .def_property(
+          "tap_gains",
+          [](Delay<float> &plugin) -> std::optional<std::vector<float>> {
+            auto tapGains = plugin.getTapGains();
+            if (tapGains.empty())
+              return {};
+            return tapGains;
+          },
+          [](Delay<float> &plugin, std::optional<std::vector<float>> gains) {
+            if (gains && gains->empty()) {
+              throw std::range_error("tap_gains must not be empty.");
+            }
+            plugin.setTapGains(gains.value_or(std::vector<float>()));
+          });
+}
+}; // namespace Pedalboard
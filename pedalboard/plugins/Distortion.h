@@ -42,7 +42,7 @@ public:
   }
 
 private:
-  SampleType driveDecibels;
+  std::atomic<SampleType> driveDecibels;
 
   enum { gainIndex, waveshaperIndex };
 };
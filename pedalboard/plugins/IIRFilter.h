@@ -0,0 +1,168 @@
+/*
+ * pedalboard
+ * Copyright 2021 Spotify AB
+ *
+ * Licensed under the GNU Public License, Version 3.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "../JuceHeader.h"
+
+namespace Pedalboard {
+
+/**
+ * A juce::dsp::IIR::Filter that can optionally filter each block it's given
+ * forwards and then backwards (like scipy.signal.filtfilt), which cancels
+ * out the filter's phase shift and squares its magnitude response.
+ *
+ * As in filtfilt, each channel is padded at both ends with an odd extension
+ * of itself (3 * (order + 1) samples long), and the filter's state is
+ * initialized to its steady-state response to the first sample of each
+ * pass, to minimize transients at the edges. The padded copy of each
+ * channel is kept in a scratch buffer that's allocated when prepared.
+ *
+ * Zero-phase filtering is non-causal, so it's only useful when each block
+ * is a whole signal (i.e.: when the plugin processes whole buffers).
+ */
+template <typename SampleType>
+class IIRFilter : public juce::dsp::IIR::Filter<SampleType> {
+public:
+  void setZeroPhase(bool newZeroPhase) noexcept { zeroPhase = newZeroPhase; }
+  bool isZeroPhase() const noexcept { return zeroPhase; }
+
+  void prepare(const juce::dsp::ProcessSpec &spec) {
+    juce::dsp::IIR::Filter<SampleType>::prepare(spec);
+    if (!zeroPhase)
+      return;
+
+    const int order = static_cast<int>(this->coefficients->getFilterOrder());
+    const SampleType *b = this->coefficients->getRawCoefficients();
+    const SampleType *a = b + order;
+
+    // The state of a transposed direct form II filter that's been fed a
+    // constant 1.0 for long enough to settle (at its DC gain):
+    SampleType sumOfB = 0, sumOfA = 1;
+    for (int i = 0; i <= order; i++)
+      sumOfB += b[i];
+    for (int i = 1; i <= order; i++)
+      sumOfA += a[i];
+    const SampleType dcGain = sumOfB / sumOfA;
+
+    initialState.resize(order);
+    state.resize(order);
+    SampleType sum = 0;
+    for (int i = order; i >= 1; i--) {
+      sum += b[i] - a[i] * dcGain;
+      initialState[i - 1] = sum;
+    }
+
+    padLength = 3 * (order + 1);
+    scratch.resize(spec.maximumBlockSize + 2 * padLength);
+  }
+
+  void release() {
+    scratch = std::vector<SampleType>();
+    initialState = std::vector<SampleType>();
+    state = std::vector<SampleType>();
+  }
+
+  template <typename ProcessContext>
+  void process(const ProcessContext &context) noexcept {
+    if (!zeroPhase) {
+      juce::dsp::IIR::Filter<SampleType>::process(context);
+      return;
+    }
+
+    const auto &inputBlock = context.getInputBlock();
+    auto &outputBlock = context.getOutputBlock();
+    if (context.usesSeparateInputAndOutputBlocks())
+      outputBlock.copyFrom(inputBlock);
+    if (context.isBypassed)
+      return;
+
+    const int numSamples = static_cast<int>(outputBlock.getNumSamples());
+    if (numSamples < 2)
+      return;
+
+    // Like filtfilt, pad by less than usual if the signal is shorter:
+    const int pad = std::min(padLength, numSamples - 1);
+    const int paddedLength = numSamples + 2 * pad;
+    jassert(paddedLength <= static_cast<int>(scratch.size()));
+
+    const int order = static_cast<int>(this->coefficients->getFilterOrder());
+    const SampleType *coefficients = this->coefficients->getRawCoefficients();
+
+    for (size_t channel = 0; channel < outputBlock.getNumChannels();
+         channel++) {
+      SampleType *samples = outputBlock.getChannelPointer(channel);
+      SampleType *padded = scratch.data();
+
+      // Extend the signal by rotating it 180 degrees around each end:
+      const SampleType first = samples[0];
+      const SampleType last = samples[numSamples - 1];
+      for (int i = 0; i < pad; i++) {
+        padded[i] = 2 * first - samples[pad - i];
+        padded[pad + numSamples + i] = 2 * last - samples[numSamples - 2 - i];
+      }
+      std::copy(samples, samples + numSamples, padded + pad);
+
+      filterInPlace<false>(padded, paddedLength, order, coefficients);
+      filterInPlace<true>(padded, paddedLength, order, coefficients);
+
+      std::copy(padded + pad, padded + pad + numSamples, samples);
+    }
+  }
+
+private:
+  /**
+   * Filters samples in place (backwards, if Backwards is true) from the
+   * steady state for the first sample filtered.
+   */
+  template <bool Backwards>
+  void filterInPlace(SampleType *samples, int numSamples, int order,
+                     const SampleType *coefficients) noexcept {
+    const SampleType *b = coefficients;
+    const SampleType *a = coefficients + order;
+    const SampleType firstSample =
+        Backwards ? samples[numSamples - 1] : samples[0];
+    for (int i = 0; i < order; i++)
+      state[i] = initialState[i] * firstSample;
+
+    for (int n = 0; n < numSamples; n++) {
+      SampleType &sample = samples[Backwards ? numSamples - 1 - n : n];
+      const SampleType input = sample;
+      if (order == 0) {
+        sample = b[0] * input;
+        continue;
+      }
+
+      const SampleType output = b[0] * input + state[0];
+      for (int i = 0; i < order - 1; i++)
+        state[i] = b[i + 1] * input - a[i + 1] * output + state[i + 1];
+      state[order - 1] = b[order] * input - a[order] * output;
+      sample = output;
+    }
+  }
+
+  bool zeroPhase = false;
+  int padLength = 0;
+
+  // The filter's state for an input of 1.0, after settling:
+  std::vector<SampleType> initialState;
+  std::vector<SampleType> state;
+  std::vector<SampleType> scratch;
+};
+} // namespace Pedalboard
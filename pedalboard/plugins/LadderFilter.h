@@ -15,16 +15,289 @@
  * limitations under the License.
  */
 
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
 namespace py = pybind11;
 
+#include <optional>
+
 #include "../JucePlugin.h"
 
 namespace Pedalboard {
+/**
+ * A Moog-style ladder filter, implementing the same algorithm (and sound) as
+ * juce::dsp::LadderFilter, but with two additions:
+ *
+ *  - The cutoff frequency can be given per sample, as an array of
+ *    frequencies (in Hz) that starts at the beginning of each call to
+ *    process(). This allows audio-rate filter sweeps without having to
+ *    process audio in tiny chunks.
+ *  - Both channels of stereo audio are processed together, in SIMD lanes,
+ *    and the saturation stages use a rational tanh approximation that can
+ *    be computed for every lane at once (instead of a lookup table).
+ */
+template <typename SampleType> class LadderFilterEngine {
+public:
+  LadderFilterEngine() {
+    setMode(juce::dsp::LadderFilterMode::LPF12);
+    setDrive(SampleType(1.2));
+  }
+
+  void setMode(juce::dsp::LadderFilterMode newMode) {
+    using Mode = juce::dsp::LadderFilterMode;
+    switch (newMode) {
+    case Mode::LPF12:
+      outputWeights = {0, 0, 1, 0, 0};
+      compensation = 0.5;
+      break;
+    case Mode::HPF12:
+      outputWeights = {1, -2, 1, 0, 0};
+      compensation = 0;
+      break;
+    case Mode::BPF12:
+      outputWeights = {0, 0, -1, 1, 0};
+      compensation = 0.5;
+      break;
+    case Mode::LPF24:
+      outputWeights = {0, 0, 0, 0, 1};
+      compensation = 0.5;
+      break;
+    case Mode::HPF24:
+      outputWeights = {1, -4, 6, -4, 1};
+      compensation = 0;
+      break;
+    case Mode::BPF24:
+      outputWeights = {0, 0, 1, -2, 1};
+      compensation = 0.5;
+      break;
+    default:
+      jassertfalse;
+      break;
+    }
+
+    for (auto &weight : outputWeights)
+      weight *= outputGain;
+
+    if (mode != newMode) {
+      mode = newMode;
+      reset();
+    }
+  }
+
+  void setCutoffFrequencyHz(SampleType newCutoff) { cutoffHz = newCutoff; }
+
+  void setResonance(SampleType newResonance) { resonance = newResonance; }
+
+  void setDrive(SampleType newDrive) {
+    drive = newDrive;
+    gain = std::pow(drive, SampleType(-2.642)) * SampleType(0.6103) +
+           SampleType(0.3903);
+    drive2 = drive * SampleType(0.04) + SampleType(0.96);
+    gain2 = std::pow(drive2, SampleType(-2.642)) * SampleType(0.6103) +
+            SampleType(0.3903);
+  }
+
+  /**
+   * Sets the cutoff frequency (in Hz) for each sample, counted from the
+   * start of each call to process(). After the last value, the cutoff stays
+   * at that value. If empty, the constant cutoff frequency is used instead.
+   */
+  void setCutoffFrequencyHzModulation(std::vector<SampleType> newModulation) {
+    cutoffModulation = std::move(newModulation);
+  }
+
+  const std::vector<SampleType> &getCutoffFrequencyHzModulation() const {
+    return cutoffModulation;
+  }
+
+  void prepare(const juce::dsp::ProcessSpec &spec) {
+    sampleRate = spec.sampleRate;
+
+    const size_t numGroups = (spec.numChannels + numLanes - 1) / numLanes;
+    if (groups.size() != numGroups) {
+      groups.resize(numGroups);
+      reset();
+    }
+  }
+
+  void reset() noexcept {
+    for (auto &group : groups)
+      group = {};
+    samplePosition = 0;
+  }
+
+  template <typename ProcessContext>
+  void process(const ProcessContext &context) noexcept {
+    const auto &inputBlock = context.getInputBlock();
+    auto &outputBlock = context.getOutputBlock();
+    const auto numChannels = outputBlock.getNumChannels();
+    const auto numSamples = outputBlock.getNumSamples();
+
+    jassert(inputBlock.getNumChannels() == numChannels);
+    jassert(inputBlock.getNumSamples() == numSamples);
+    jassert(numChannels <= groups.size() * numLanes);
+
+    if (context.isBypassed) {
+      if (context.usesSeparateInputAndOutputBlocks())
+        outputBlock.copyFrom(inputBlock);
+      return;
+    }
+
+    for (size_t start = 0; start < numSamples; start += blockSize) {
+      const int numInBlock =
+          static_cast<int>(std::min<size_t>(blockSize, numSamples - start));
+      computeCutoffTransforms(numInBlock);
+
+      for (size_t group = 0; group * numLanes < numChannels; group++) {
+        const size_t firstChannel = group * numLanes;
+        const size_t numInGroup =
+            std::min<size_t>(numLanes, numChannels - firstChannel);
+
+        const SampleType *inputs[numLanes];
+        SampleType *outputs[numLanes];
+        for (size_t lane = 0; lane < numLanes; lane++) {
+          // Unused lanes just process a copy of the group's first channel.
+          const size_t channel = firstChannel + (lane < numInGroup ? lane : 0);
+          inputs[lane] = inputBlock.getChannelPointer(channel) + start;
+          outputs[lane] = outputBlock.getChannelPointer(channel) + start;
+        }
+
+        processGroup(groups[group], inputs, outputs, numInGroup, numInBlock);
+      }
+
+      samplePosition += numInBlock;
+    }
+  }
+
+private:
+  static constexpr size_t numLanes = 4;
+
+  // The number of samples processed at a time.
+  static constexpr int blockSize = 256;
+
+  static constexpr SampleType outputGain = 1.2;
+
+  struct LaneGroup {
+    SampleType state[5][numLanes] = {};
+  };
+
+  /**
+   * Fills cutoffTransforms with the one-pole coefficient for the cutoff
+   * frequency of each of the next numSamples samples.
+   */
+  void computeCutoffTransforms(int numSamples) noexcept {
+    const SampleType cutoffScaler = static_cast<SampleType>(
+        -2.0 * juce::MathConstants<double>::pi / sampleRate);
+
+    if (cutoffModulation.empty()) {
+      std::fill(cutoffTransforms, cutoffTransforms + numSamples,
+                std::exp(cutoffHz * cutoffScaler));
+      return;
+    }
+
+    const size_t last = cutoffModulation.size() - 1;
+    for (int i = 0; i < numSamples; i++) {
+      const SampleType cutoff =
+          cutoffModulation[std::min(samplePosition + i, last)];
+      cutoffTransforms[i] = std::exp(cutoff * cutoffScaler);
+    }
+  }
+
+  void processGroup(LaneGroup &group, const SampleType *const *inputs,
+                    SampleType *const *outputs, size_t numInGroup,
+                    int numSamples) noexcept {
+    const SampleType scaledResonance =
+        SampleType(0.1) + resonance * SampleType(0.9);
+    const SampleType feedbackGain = scaledResonance * SampleType(-4);
+    const SampleType inputGain = gain, inputDrive = drive;
+    const SampleType outputStageGain = gain2, outputStageDrive = drive2;
+    const SampleType comp = compensation;
+    const std::array<SampleType, 5> weights = outputWeights;
+    auto &s = group.state;
+
+    for (int i = 0; i < numSamples; i++) {
+      const SampleType a1 = cutoffTransforms[i];
+      const SampleType g = 1 - a1;
+      const SampleType b0 = g * SampleType(0.76923076923);
+      const SampleType b1 = g * SampleType(0.23076923076);
+
+      SampleType y[numLanes];
+      for (size_t lane = 0; lane < numLanes; lane++) {
+        const SampleType dx =
+            inputGain * fastTanh(inputDrive * inputs[lane][i]);
+        const SampleType a =
+            dx + feedbackGain * (outputStageGain *
+                                     fastTanh(outputStageDrive * s[4][lane]) -
+                                 dx * comp);
+        const SampleType b = b1 * s[0][lane] + a1 * s[1][lane] + b0 * a;
+        const SampleType c = b1 * s[1][lane] + a1 * s[2][lane] + b0 * b;
+        const SampleType d = b1 * s[2][lane] + a1 * s[3][lane] + b0 * c;
+        const SampleType e = b1 * s[3][lane] + a1 * s[4][lane] + b0 * d;
+
+        s[0][lane] = a;
+        s[1][lane] = b;
+        s[2][lane] = c;
+        s[3][lane] = d;
+        s[4][lane] = e;
+
+        y[lane] = a * weights[0] + b * weights[1] + c * weights[2] +
+                  d * weights[3] + e * weights[4];
+      }
+
+      for (size_t lane = 0; lane < numInGroup; lane++)
+        outputs[lane][i] = y[lane];
+    }
+  }
+
+  /**
+   * A [7/6] Pade approximant of tanh, within 1e-4 of tanh(x) once its input
+   * is clamped to [-5, 5] (the same range as juce::dsp::LadderFilter's
+   * lookup table, which is itself only accurate to about 6e-4).
+   */
+  static SampleType fastTanh(SampleType x) noexcept {
+    x = juce::jlimit(SampleType(-5), SampleType(5), x);
+    const SampleType x2 = x * x;
+    const SampleType numerator =
+        x * (135135 + x2 * (17325 + x2 * (378 + x2)));
+    const SampleType denominator =
+        135135 + x2 * (62370 + x2 * (3150 + x2 * 28));
+    return juce::jlimit(SampleType(-1), SampleType(1), numerator / denominator);
+  }
+
+  // Defaults match those of juce::dsp::LadderFilter.
+  juce::dsp::LadderFilterMode mode = juce::dsp::LadderFilterMode::LPF12;
+  std::array<SampleType, 5> outputWeights;
+  SampleType compensation;
+  SampleType cutoffHz = 200, resonance = 0, drive, gain, drive2, gain2;
+  std::vector<SampleType> cutoffModulation;
+
+  double sampleRate = 44100.0;
+  size_t samplePosition = 0;
+  SampleType cutoffTransforms[blockSize] = {};
+  std::vector<LaneGroup> groups;
+};
+
 template <typename SampleType>
-class LadderFilter : public JucePlugin<juce::dsp::LadderFilter<SampleType>> {
+class LadderFilter : public JucePlugin<LadderFilterEngine<SampleType>> {
+public:
+  std::vector<SampleType> getCutoffFrequencyHzModulation() {
+    ScopedGILReleasingLock lock(this->mutex);
+    return this->getDSP().getCutoffFrequencyHzModulation();
+  }
+
+  void setCutoffFrequencyHzModulation(std::vector<SampleType> modulation) {
+    for (auto cutoff : modulation) {
+      if (!(cutoff > 0)) {
+        throw std::range_error(
+            "Cutoff frequency modulation must only contain positive values.");
+      }
+    }
+    ScopedGILReleasingLock lock(this->mutex);
+    this->getDSP().setCutoffFrequencyHzModulation(std::move(modulation));
+  }
+
   DEFINE_DSP_SETTER_AND_GETTER(SampleType, CutoffFrequencyHz, {});
   DEFINE_DSP_SETTER_AND_GETTER(SampleType, Drive, {
     if (value < 1.0) {
@@ -57,11 +330,28 @@ class LadderFilter : public JucePlugin<juce::dsp::LadderFilter<SampleType>> {
   });
 };
 
+using CutoffModulationArray =
+    py::array_t<float, py::array::c_style | py::array::forcecast>;
+
+inline std::vector<float>
+cutoffModulationFromArray(const CutoffModulationArray &array) {
+  if (array.ndim() != 1) {
+    throw std::range_error(
+        "Cutoff frequency modulation must be a one-dimensional array.");
+  }
+  return std::vector<float>(array.data(), array.data() + array.size());
+}
+
 inline void init_ladderfilter(py::module &m) {
   py::class_<LadderFilter<float>, Plugin> ladderFilter(
       m, "LadderFilter",
       "Multi-mode audio filter based on the classic Moog synthesizer ladder "
-      "filter.");
+      "filter.\n\n"
+      "To sweep the filter, pass a one-dimensional array of cutoff "
+      "frequencies (in Hz) as cutoff_hz_modulation: the Nth sample of the "
+      "audio passed to each call to process() is filtered with the Nth "
+      "cutoff frequency (or the last one, if the audio is longer than the "
+      "array), in place of cutoff_hz.");
 
   py::enum_<juce::dsp::LadderFilterMode>(ladderFilter, "Mode")
       .value("LPF12", juce::dsp::LadderFilterMode::LPF12,
@@ -80,17 +370,22 @@ inline void init_ladderfilter(py::module &m) {
 
   ladderFilter
       .def(py::init([](juce::dsp::LadderFilterMode mode, float cutoffHz,
-                       float resonance, float drive) {
-             auto plugin = new LadderFilter<float>();
+                       float resonance, float drive,
+                       std::optional<CutoffModulationArray> cutoffModulation) {
+             auto plugin = std::make_unique<LadderFilter<float>>();
              plugin->setMode(mode);
              plugin->setCutoffFrequencyHz(cutoffHz);
              plugin->setResonance(resonance);
              plugin->setDrive(drive);
+             if (cutoffModulation) {
+               plugin->setCutoffFrequencyHzModulation(
+                   cutoffModulationFromArray(*cutoffModulation));
+             }
              return plugin;
            }),
            py::arg("mode") = juce::dsp::LadderFilterMode::LPF12,
            py::arg("cutoff_hz") = 200, py::arg("resonance") = 0,
-           py::arg("drive") = 1.0)
+           py::arg("drive") = 1.0, py::arg("cutoff_hz_modulation") = py::none())
       .def("__repr__",
            [](const LadderFilter<float> &plugin) {
              std::ostringstream ss;
@@ -133,7 +428,20 @@ inline void init_ladderfilter(py::module &m) {
       .def_property("resonance", &LadderFilter<float>::getResonance,
                     &LadderFilter<float>::setResonance)
       .def_property("drive", &LadderFilter<float>::getDrive,
-                    &LadderFilter<float>::setDrive);
-  ;
+                    &LadderFilter<float>::setDrive)
+      .def_property(
+          "cutoff_hz_modulation",
+          [](LadderFilter<float> &plugin) -> std::optional<py::array_t<float>> {
+            auto modulation = plugin.getCutoffFrequencyHzModulation();
+            if (modulation.empty())
+              return {};
+            return py::array_t<float>(modulation.size(), modulation.data());
+          },
+          [](LadderFilter<float> &plugin,
+             std::optional<CutoffModulationArray> cutoffModulation) {
+            plugin.setCutoffFrequencyHzModulation(
+                cutoffModulation ? cutoffModulationFromArray(*cutoffModulation)
+                                 : std::vector<float>());
+          });
 }
 }; // namespace Pedalboard
\ No newline at end of file
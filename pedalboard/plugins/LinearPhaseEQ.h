@@ -0,0 +1,324 @@
+/*
+ * pedalboard
+ * Copyright 2021 Spotify AB
+ *
+ * Licensed under the GNU Public License, Version 3.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <tuple>
+
+#include "../JucePlugin.h"
+
+#include "../juce_overrides/juce_BlockingConvolution.h"
+
+namespace Pedalboard {
+
+/**
+ * Designs a linear-phase FIR filter with numTaps (odd) taps, whose gain at
+ * each of the given frequencies is the corresponding gain (in decibels).
+ * Between frequencies, the gain is interpolated linearly (in decibels) over
+ * log-frequency; outside of them, it's held constant.
+ *
+ * Uses the frequency sampling method: the desired (zero-phase) response is
+ * sampled on a grid four times as fine as the filter's length, transformed
+ * to an impulse response, then centred, truncated and Blackman-windowed.
+ */
+inline std::vector<float>
+designLinearPhaseFIR(const std::vector<float> &frequencies,
+                     const std::vector<float> &gainsDecibels,
+                     double sampleRate, int numTaps) {
+  jassert(numTaps % 2 == 1);
+  jassert(!frequencies.empty() && frequencies.size() == gainsDecibels.size());
+
+  const int fftOrder =
+      juce::jmax(4, juce::roundToInt(std::ceil(std::log2(numTaps))) + 2);
+  const int fftSize = 1 << fftOrder;
+
+  // JUCE's real-only inverse transform takes (and scales by 1 / fftSize) a
+  // full spectrum of interleaved complex bins. A zero-phase response is real
+  // and symmetric:
+  std::vector<float> spectrum(2 * fftSize, 0.0f);
+  size_t band = 0;
+  for (int bin = 0; bin <= fftSize / 2; bin++) {
+    const double frequency = bin * sampleRate / fftSize;
+    while (band < frequencies.size() && frequencies[band] < frequency)
+      band++;
+
+    double gainDecibels;
+    if (band == 0) {
+      gainDecibels = gainsDecibels.front();
+    } else if (band == frequencies.size()) {
+      gainDecibels = gainsDecibels.back();
+    } else {
+      const double position =
+          std::log2(frequency / frequencies[band - 1]) /
+          std::log2(frequencies[band] / frequencies[band - 1]);
+      gainDecibels = gainsDecibels[band - 1] +
+                     position * (gainsDecibels[band] - gainsDecibels[band - 1]);
+    }
+
+    const float gain =
+        juce::Decibels::decibelsToGain(static_cast<float>(gainDecibels));
+    spectrum[2 * bin] = gain;
+    if (bin > 0 && bin < fftSize / 2)
+      spectrum[2 * (fftSize - bin)] = gain;
+  }
+
+  juce::dsp::FFT(fftOrder).performRealOnlyInverseTransform(spectrum.data());
+
+  std::vector<float> window(numTaps);
+  juce::dsp::WindowingFunction<float>::fillWindowingTables(
+      window.data(), numTaps, juce::dsp::WindowingFunction<float>::blackman,
+      false);
+
+  // The impulse response is centred on sample zero (and wraps around), so
+  // rotate it to be centred on the middle tap:
+  std::vector<float> taps(numTaps);
+  const int centre = (numTaps - 1) / 2;
+  for (int i = 0; i < numTaps; i++) {
+    const int index = (i - centre + fftSize) % fftSize;
+    taps[i] = spectrum[index] * window[i];
+  }
+  return taps;
+}
+
+/**
+ * A process-wide cache of linear-phase FIR designs, keyed by every
+ * parameter of the design, so that the same filter is never designed twice
+ * (i.e.: when randomly choosing from a set of EQ curves for augmentation).
+ * Designs are shared (and immutable) once made. The oldest designs are
+ * evicted once there are more than maximumNumEntries.
+ *
+ * Taps are kept in std::vectors rather than AudioBuffers, as this cache
+ * lives until the process exits (after JUCE's leak detectors have run).
+ */
+class LinearPhaseFIRCache {
+public:
+  using Key = std::tuple<double, int, std::vector<float>, std::vector<float>>;
+  using Taps = std::shared_ptr<const std::vector<float>>;
+
+  static constexpr size_t maximumNumEntries = 1024;
+
+  static LinearPhaseFIRCache &getInstance() {
+    static LinearPhaseFIRCache instance;
+    return instance;
+  }
+
+  Taps get(const std::vector<float> &frequencies,
+           const std::vector<float> &gainsDecibels, double sampleRate,
+           int numTaps) {
+    Key key{sampleRate, numTaps, frequencies, gainsDecibels};
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = entries.find(key);
+      if (it != entries.end())
+        return it->second;
+    }
+
+    // Design outside of the lock; if another thread designs the same filter
+    // at the same time, the first to finish wins.
+    Taps taps = std::make_shared<const std::vector<float>>(
+        designLinearPhaseFIR(frequencies, gainsDecibels, sampleRate, numTaps));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto [it, inserted] = entries.emplace(key, taps);
+    if (inserted) {
+      insertionOrder.push_back(it);
+      if (insertionOrder.size() > maximumNumEntries) {
+        entries.erase(insertionOrder.front());
+        insertionOrder.pop_front();
+      }
+    }
+    return it->second;
+  }
+
+private:
+  std::mutex mutex;
+  std::map<Key, Taps> entries;
+  std::deque<std::map<Key, Taps>::iterator> insertionOrder;
+};
+
+/**
+ * Applies a linear-phase FIR filter, designed from a set of band gains,
+ * using BlockingConvolution. The filter is (re)designed when prepared, if
+ * its parameters or the sample rate have changed since it was last loaded.
+ *
+ * The filter delays its input by half of its length, which is reported as
+ * this plugin's latency (and removed by pedalboard.process).
+ */
+class LinearPhaseFilter {
+public:
+  void setBands(std::vector<float> newFrequencies,
+                std::vector<float> newGainsDecibels) {
+    frequencies = std::move(newFrequencies);
+    gainsDecibels = std::move(newGainsDecibels);
+  }
+  const std::vector<float> &getFrequencies() const { return frequencies; }
+  const std::vector<float> &getGainsDecibels() const { return gainsDecibels; }
+
+  void setNumTaps(int newNumTaps) { numTaps = newNumTaps; }
+  int getNumTaps() const { return numTaps; }
+
+  void prepare(const juce::dsp::ProcessSpec &spec) {
+    auto taps = LinearPhaseFIRCache::getInstance().get(
+        frequencies, gainsDecibels, spec.sampleRate, numTaps);
+
+    if (taps != loadedTaps) {
+      juce::AudioBuffer<float> impulseResponse(1, numTaps);
+      impulseResponse.copyFrom(0, 0, taps->data(), numTaps);
+      convolution.loadImpulseResponse(
+          std::move(impulseResponse), spec.sampleRate,
+          juce::dsp::Convolution::Stereo::no, juce::dsp::Convolution::Trim::no,
+          juce::dsp::Convolution::Normalise::no);
+      loadedTaps = taps;
+      loadedNumTaps = numTaps;
+    }
+
+    convolution.prepare(spec);
+  }
+
+  void reset() noexcept { convolution.reset(); }
+
+  template <typename ProcessContext>
+  void process(const ProcessContext &context) noexcept {
+    convolution.process(context);
+  }
+
+  void release() { convolution.release(); }
+
+  // BlockingConvolution is zero-latency by default, so only the filter's
+  // own delay counts.
+  int getLatencySamples() const { return (loadedNumTaps - 1) / 2; }
+
+private:
+  std::vector<float> frequencies = {1000.0f};
+  std::vector<float> gainsDecibels = {0.0f};
+  int numTaps = 1023;
+
+  juce::dsp::BlockingConvolution convolution;
+  LinearPhaseFIRCache::Taps loadedTaps;
+  int loadedNumTaps = 1;
+};
+
+class LinearPhaseEQ : public JucePlugin<LinearPhaseFilter> {
+public:
+  static constexpr int maximumNumTaps = 65535;
+
+  std::vector<float> getBandFrequencies() {
+    ScopedGILReleasingLock lock(this->mutex);
+    return this->getDSP().getFrequencies();
+  }
+
+  std::vector<float> getBandGainsDecibels() {
+    ScopedGILReleasingLock lock(this->mutex);
+    return this->getDSP().getGainsDecibels();
+  }
+
+  void setBands(std::vector<float> frequencies,
+                std::vector<float> gainsDecibels) {
+    if (frequencies.empty() || frequencies.size() != gainsDecibels.size()) {
+      throw std::range_error("band_frequencies_hz and band_gains_db must be "
+                             "non-empty and the same length.");
+    }
+    for (size_t i = 0; i < frequencies.size(); i++) {
+      if (!(frequencies[i] > 0) ||
+          (i > 0 && frequencies[i] <= frequencies[i - 1])) {
+        throw std::range_error(
+            "Band frequencies must be positive and in increasing order.");
+      }
+      if (!std::isfinite(gainsDecibels[i])) {
+        throw std::range_error("Band gains must be finite.");
+      }
+    }
+
+    ScopedGILReleasingLock lock(this->mutex);
+    this->getDSP().setBands(std::move(frequencies), std::move(gainsDecibels));
+  }
+
+  int getNumTaps() {
+    ScopedGILReleasingLock lock(this->mutex);
+    return this->getDSP().getNumTaps();
+  }
+
+  void setNumTaps(int numTaps) {
+    if (numTaps < 3 || numTaps > maximumNumTaps || numTaps % 2 == 0) {
+      throw std::range_error(
+          "Number of taps must be odd, and between 3 and 65535.");
+    }
+    ScopedGILReleasingLock lock(this->mutex);
+    this->getDSP().setNumTaps(numTaps);
+  }
+};
+
+inline void init_linearphaseeq(py::module &m) {
+  py::class_<LinearPhaseEQ, Plugin>(
+      m, "LinearPhaseEQ",
+      "A linear-phase equalizer, which applies the given gains (in dB) at "
+      "the given frequencies (in Hz) without changing the phase of its "
+      "input. The gain between frequencies is interpolated linearly (in dB) "
+      "over log-frequency, and held constant outside of them.\n\n"
+      "The EQ curve is applied with an FIR filter of num_taps taps, designed "
+      "by frequency sampling and windowing; more taps give a more accurate "
+      "curve at low frequencies, at the cost of speed. Filter designs are "
+      "cached (by curve, length and sample rate) for the lifetime of the "
+      "process, so switching between a set of curves doesn't redesign them "
+      "each time.\n\n"
+      "The filter delays audio by (num_taps - 1) / 2 samples. This is "
+      "reported as the plugin's latency, so the output of process is "
+      "aligned with its input.")
+      .def(py::init([](std::vector<float> bandFrequencies,
+                       std::vector<float> bandGainsDecibels, int numTaps) {
+             auto plugin = std::make_unique<LinearPhaseEQ>();
+             plugin->setBands(std::move(bandFrequencies),
+                              std::move(bandGainsDecibels));
+             plugin->setNumTaps(numTaps);
+             return plugin;
+           }),
+           py::arg("band_frequencies_hz"), py::arg("band_gains_db"),
+           py::arg("num_taps") = 1023)
+      .def("__repr__",
+           [](LinearPhaseEQ &plugin) {
+             std::ostringstream ss;
+             ss << "<pedalboard.LinearPhaseEQ";
+             auto frequencies = plugin.getBandFrequencies();
+             auto gains = plugin.getBandGainsDecibels();
+             ss << " bands=[";
+             for (size_t i = 0; i < frequencies.size(); i++) {
+               ss << (i ? ", " : "") << frequencies[i] << "Hz: " << gains[i]
+                  << "dB";
+             }
+             ss << "]";
+             ss << " num_taps=" << plugin.getNumTaps();
+             ss << " at " << &plugin;
+             ss << ">";
+             return ss.str();
+           })
+      .def_property_readonly("band_frequencies_hz",
+                             &LinearPhaseEQ::getBandFrequencies)
+      .def_property_readonly("band_gains_db",
+                             &LinearPhaseEQ::getBandGainsDecibels)
+      .def("set_bands", &LinearPhaseEQ::setBands,
+           "Change the frequencies (in Hz) and gains (in dB) of the EQ curve.",
+           py::arg("band_frequencies_hz"), py::arg("band_gains_db"))
+      .def_property("num_taps", &LinearPhaseEQ::getNumTaps,
+                    &LinearPhaseEQ::setNumTaps);
+}
+}; // namespace Pedalboard
@@ -21,23 +21,45 @@
 namespace py = pybind11;
 
 #include "../JucePlugin.h"
+#include "IIRFilter.h"
 
 namespace Pedalboard {
 template <typename SampleType>
-class LowpassFilter : public JucePlugin<juce::dsp::IIR::Filter<SampleType>> {
+class LowpassFilter : public JucePlugin<IIRFilter<SampleType>> {
 public:
   void setCutoffFrequencyHz(float f) noexcept { cutoffFrequencyHz = f; }
   float getCutoffFrequencyHz() const noexcept { return cutoffFrequencyHz; }
+  void setZeroPhase(bool newZeroPhase) noexcept { zeroPhase = newZeroPhase; }
+  bool isZeroPhase() const noexcept { return zeroPhase; }
 
   virtual void prepare(const juce::dsp::ProcessSpec &spec) override {
-    JucePlugin<juce::dsp::IIR::Filter<SampleType>>::prepare(spec);
-    this->getDSP().coefficients =
-        juce::dsp::IIR::Coefficients<SampleType>::makeFirstOrderLowPass(
-            spec.sampleRate, cutoffFrequencyHz);
+    // Only allocate new coefficients if they've actually changed, and do so
+    // before preparing the filter so that its state is sized correctly here
+    // rather than on the first call to process().
+    const float cutoff = cutoffFrequencyHz.load();
+    if (spec.sampleRate != coefficientsSampleRate ||
+        cutoff != coefficientsCutoffFrequencyHz) {
+      this->getDSP().coefficients =
+          juce::dsp::IIR::Coefficients<SampleType>::makeFirstOrderLowPass(
+              spec.sampleRate, cutoff);
+      coefficientsSampleRate = spec.sampleRate;
+      coefficientsCutoffFrequencyHz = cutoff;
+    }
+    this->getDSP().setZeroPhase(zeroPhase);
+    JucePlugin<IIRFilter<SampleType>>::prepare(spec);
   }
 
+  // Zero-phase filtering runs backwards over the whole buffer.
+  bool processesWholeBuffer() const override { return zeroPhase; }
+
 private:
-  float cutoffFrequencyHz;
+  // Can be set from any thread; only read by prepare().
+  std::atomic<float> cutoffFrequencyHz;
+  std::atomic<bool> zeroPhase{false};
+
+  // The parameters used to compute the filter's current coefficients.
+  double coefficientsSampleRate = 0;
+  float coefficientsCutoffFrequencyHz = 0;
 };
 
 inline void init_lowpass(py::module &m) {
@@ -45,24 +67,34 @@ inline void init_lowpass(py::module &m) {
       m, "LowpassFilter",
       "Apply a first-order low-pass filter with a roll-off of 6dB/octave. "
       "The cutoff frequency will be attenuated by -3dB (i.e.: 0.707x as "
-      "loud).")
-      .def(py::init([](float cutoff_frequency_hz) {
+      "loud).\n\n"
+      "If zero_phase is True, the filter is run forwards and then "
+      "backwards over the whole buffer (like scipy.signal.filtfilt), which "
+      "removes its phase shift and doubles its roll-off (attenuating the "
+      "cutoff frequency by -6dB). As this requires the whole buffer at "
+      "once, buffer_size is ignored.")
+      .def(py::init([](float cutoff_frequency_hz, bool zero_phase) {
              auto plugin = new LowpassFilter<float>();
              plugin->setCutoffFrequencyHz(cutoff_frequency_hz);
+             plugin->setZeroPhase(zero_phase);
              return plugin;
            }),
-           py::arg("cutoff_frequency_hz") = 50)
+           py::arg("cutoff_frequency_hz") = 50, py::arg("zero_phase") = false)
       .def("__repr__",
            [](const LowpassFilter<float> &plugin) {
              std::ostringstream ss;
              ss << "<pedalboard.Lowpass";
              ss << " cutoff_frequency_hz=" << plugin.getCutoffFrequencyHz();
+             if (plugin.isZeroPhase())
+               ss << " zero_phase=True";
              ss << " at " << &plugin;
              ss << ">";
              return ss.str();
            })
       .def_property("cutoff_frequency_hz",
                     &LowpassFilter<float>::getCutoffFrequencyHz,
-                    &LowpassFilter<float>::setCutoffFrequencyHz);
+                    &LowpassFilter<float>::setCutoffFrequencyHz)
+      .def_property("zero_phase", &LowpassFilter<float>::isZeroPhase,
+                    &LowpassFilter<float>::setZeroPhase);
 }
 }; // namespace Pedalboard
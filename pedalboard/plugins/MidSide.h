@@ -0,0 +1,210 @@
+/*
+ * pedalboard
+ * Copyright 2021 Spotify AB
+ *
+ * Licensed under the GNU Public License, Version 3.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+
+#include <optional>
+
+#include "../Plugin.h"
+
+namespace Pedalboard {
+
+/**
+ * Encodes stereo audio as mid (L + R) / 2 and side (L - R) / 2 channels,
+ * processes each with its own (mono) plugin, and decodes the result back to
+ * left and right. Mono audio is passed through the mid plugin only.
+ *
+ * Either plugin may be null, in which case that channel is left unprocessed.
+ * If the two plugins have different latencies, the channel with less latency
+ * is delayed to match the other.
+ *
+ * As with Mix, the wrapped plugins are kept alive by the Python bindings and
+ * are locked along with this plugin by process().
+ */
+class MidSide : public Plugin {
+public:
+  MidSide(Plugin *midPlugin, Plugin *sidePlugin)
+      : midPlugin(midPlugin), sidePlugin(sidePlugin) {}
+  virtual ~MidSide(){};
+
+  void prepare(const juce::dsp::ProcessSpec &spec) override {
+    numChannels = spec.numChannels;
+
+    juce::dsp::ProcessSpec monoSpec = spec;
+    monoSpec.numChannels = 1;
+    if (midPlugin)
+      midPlugin->prepare(monoSpec);
+    if (sidePlugin)
+      sidePlugin->prepare(monoSpec);
+
+    const int latencyDifference = getSideLatency() - getMidLatency();
+    alignmentDelay = std::abs(latencyDifference);
+    delayMidChannel = latencyDifference > 0;
+    if (numChannels == 2 && alignmentDelay > 0) {
+      if (!delayLine || alignmentDelay > maximumAlignmentDelay) {
+        delayLine.emplace(alignmentDelay);
+        maximumAlignmentDelay = alignmentDelay;
+      }
+      delayLine->prepare(monoSpec);
+      delayLine->setDelay(static_cast<float>(alignmentDelay));
+    }
+  }
+
+  void process(
+      const juce::dsp::ProcessContextReplacing<float> &context) override {
+    auto ioBlock = context.getOutputBlock();
+    if (context.usesSeparateInputAndOutputBlocks())
+      ioBlock.copyFrom(context.getInputBlock());
+
+    if (ioBlock.getNumChannels() < 2) {
+      if (midPlugin)
+        midPlugin->process(juce::dsp::ProcessContextReplacing<float>(ioBlock));
+      return;
+    }
+
+    float *left = ioBlock.getChannelPointer(0);
+    float *right = ioBlock.getChannelPointer(1);
+    const size_t numSamples = ioBlock.getNumSamples();
+
+    // Encode and decode in place, with loops simple enough to vectorize.
+    for (size_t i = 0; i < numSamples; i++) {
+      const float mid = (left[i] + right[i]) * 0.5f;
+      const float side = (left[i] - right[i]) * 0.5f;
+      left[i] = mid;
+      right[i] = side;
+    }
+
+    auto midBlock = ioBlock.getSingleChannelBlock(0);
+    auto sideBlock = ioBlock.getSingleChannelBlock(1);
+    juce::dsp::ProcessContextReplacing<float> midContext(midBlock);
+    juce::dsp::ProcessContextReplacing<float> sideContext(sideBlock);
+
+    if (midPlugin)
+      midPlugin->process(midContext);
+    if (sidePlugin)
+      sidePlugin->process(sideContext);
+
+    if (alignmentDelay > 0)
+      delayLine->process(delayMidChannel ? midContext : sideContext);
+
+    for (size_t i = 0; i < numSamples; i++) {
+      const float mid = left[i];
+      const float side = right[i];
+      left[i] = mid + side;
+      right[i] = mid - side;
+    }
+  }
+
+  void reset() override {
+    if (midPlugin)
+      midPlugin->reset();
+    if (sidePlugin)
+      sidePlugin->reset();
+    if (delayLine)
+      delayLine->reset();
+  }
+
+  // Free the alignment delay line until next prepared. (The wrapped plugins
+  // are released by the caller, which must lock them too.)
+  void release() override { delayLine.reset(); }
+
+  bool processesWholeBuffer() const override {
+    return (midPlugin && midPlugin->processesWholeBuffer()) ||
+           (sidePlugin && sidePlugin->processesWholeBuffer());
+  }
+
+  int getLatencySamples() const override {
+    if (numChannels < 2)
+      return getMidLatency();
+    return std::max(getMidLatency(), getSideLatency());
+  }
+
+  void appendNestedPlugins(std::vector<Plugin *> &plugins) const override {
+    for (Plugin *plugin : {midPlugin, sidePlugin}) {
+      if (plugin == nullptr)
+        continue;
+      plugins.push_back(plugin);
+      plugin->appendNestedPlugins(plugins);
+    }
+  }
+
+  Plugin *getMidPlugin() const { return midPlugin; }
+  Plugin *getSidePlugin() const { return sidePlugin; }
+
+private:
+  int getMidLatency() const {
+    return midPlugin ? midPlugin->getLatencySamples() : 0;
+  }
+
+  int getSideLatency() const {
+    return sidePlugin ? sidePlugin->getLatencySamples() : 0;
+  }
+
+  Plugin *const midPlugin;
+  Plugin *const sidePlugin;
+
+  unsigned int numChannels = 0;
+
+  // Applied to whichever of the mid or side channels has less latency.
+  int alignmentDelay = 0;
+  int maximumAlignmentDelay = 0;
+  bool delayMidChannel = false;
+  std::optional<juce::dsp::DelayLine<
+      float, juce::dsp::DelayLineInterpolationTypes::None>>
+      delayLine;
+};
+
+inline void init_midside(py::module &m) {
+  py::class_<MidSide, Plugin>(
+      m, "MidSide",
+      "Converts stereo audio into mid (L + R) and side (L - R) channels, "
+      "processes each of them with a separate plugin, then converts the "
+      "result back to stereo. Either plugin may be None to leave its channel "
+      "unprocessed. Mono audio is processed by the mid plugin only.\n\n"
+      "Each plugin receives a single channel of audio.")
+      .def(py::init([](Plugin *midPlugin, Plugin *sidePlugin) {
+             return std::make_unique<MidSide>(midPlugin, sidePlugin);
+           }),
+           py::arg("plugin_mid") = py::none(),
+           py::arg("plugin_side") = py::none(), py::keep_alive<1, 2>(),
+           py::keep_alive<1, 3>())
+      .def("__repr__",
+           [](const MidSide &plugin) {
+             std::ostringstream ss;
+             ss << "<pedalboard.MidSide";
+             py::object mid = py::cast(plugin.getMidPlugin(),
+                                       py::return_value_policy::reference);
+             py::object side = py::cast(plugin.getSidePlugin(),
+                                        py::return_value_policy::reference);
+             ss << " plugin_mid=" << py::repr(mid).cast<std::string>();
+             ss << " plugin_side=" << py::repr(side).cast<std::string>();
+             ss << " at " << &plugin;
+             ss << ">";
+             return ss.str();
+           })
+      .def_property_readonly("plugin_mid", &MidSide::getMidPlugin,
+                             py::return_value_policy::reference,
+                             "The plugin applied to the mid channel, if any.")
+      .def_property_readonly(
+          "plugin_side", &MidSide::getSidePlugin,
+          py::return_value_policy::reference,
+          "The plugin applied to the side channel, if any.");
+}
+}; // namespace Pedalboard
@@ -0,0 +1,147 @@
+/*
+ * pedalboard
+ * Copyright 2021 Spotify AB
+ *
+ * Licensed under the GNU Public License, Version 3.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+
+#include <atomic>
+#include <optional>
+
+#include "../Plugin.h"
+
+namespace Pedalboard {
+
+/**
+ * Mixes the output of any other plugin with its (unprocessed) input, with a
+ * juce::dsp::DryWetMixer. The dry signal is delayed by the wrapped plugin's
+ * latency, so that both signals line up.
+ *
+ * The wrapped plugin is not owned by this object; the Python bindings keep
+ * it alive for as long as this object is. It's locked (along with this
+ * plugin) by process().
+ */
+class Mix : public Plugin {
+public:
+  Mix(Plugin *plugin, float mix) : plugin(plugin), mix(mix) {}
+  virtual ~Mix(){};
+
+  void prepare(const juce::dsp::ProcessSpec &spec) override {
+    plugin->prepare(spec);
+
+    const int latency = plugin->getLatencySamples();
+    if (!mixer || latency > maximumLatency) {
+      mixer.emplace(latency);
+      maximumLatency = latency;
+    }
+    // Set before preparing, which snaps the mixer's gains to their targets;
+    // setting it afterwards would ramp from the mixer's default of 1.0.
+    mixer->setWetMixProportion(mix);
+    mixer->prepare(spec);
+    mixer->setWetLatency(static_cast<float>(latency));
+  }
+
+  void process(
+      const juce::dsp::ProcessContextReplacing<float> &context) override {
+    mixer->pushDrySamples(context.getInputBlock());
+    plugin->process(context);
+    mixer->mixWetSamples(context.getOutputBlock());
+  }
+
+  void reset() override {
+    plugin->reset();
+    if (mixer) {
+      mixer->reset();
+      mixer->setWetMixProportion(mix);
+    }
+  }
+
+  // Free the mixing buffers until next prepared. (The wrapped plugin is
+  // released by the caller, which must lock it too.)
+  void release() override { mixer.reset(); }
+
+  bool processesWholeBuffer() const override {
+    return plugin->processesWholeBuffer();
+  }
+
+  int getLatencySamples() const override {
+    return plugin->getLatencySamples();
+  }
+
+  void appendNestedPlugins(std::vector<Plugin *> &plugins) const override {
+    plugins.push_back(plugin);
+    plugin->appendNestedPlugins(plugins);
+  }
+
+  Plugin *getPlugin() const { return plugin; }
+
+  float getMix() const { return mix; }
+  void setMix(float newMix) {
+    if (newMix < 0.0 || newMix > 1.0) {
+      throw std::range_error("Mix must be between 0.0 and 1.0.");
+    }
+    ScopedGILReleasingLock lock(mutex);
+    mix = newMix;
+    if (mixer)
+      mixer->setWetMixProportion(newMix);
+  }
+
+private:
+  Plugin *const plugin;
+  std::atomic<float> mix;
+
+  // Only constructed when prepared, as its dry buffer is sized to the block
+  // and its delay line to the wrapped plugin's latency.
+  std::optional<juce::dsp::DryWetMixer<float>> mixer;
+  int maximumLatency = 0;
+};
+
+inline void init_mix(py::module &m) {
+  py::class_<Mix, Plugin>(
+      m, "Mix",
+      "Mixes the output of another plugin with its input, in proportion to "
+      "the mix parameter (0.0 being entirely unprocessed, and 1.0 being "
+      "entirely processed). The unprocessed signal is delayed to match any "
+      "latency added by the plugin.\n\n"
+      "The plugin can still be used on its own, but can't be used elsewhere "
+      "in the same chain of plugins as this Mix.")
+      .def(py::init([](Plugin *plugin, float mix) {
+             auto wrapper = std::make_unique<Mix>(plugin, mix);
+             wrapper->setMix(mix);
+             return wrapper;
+           }),
+           py::arg("plugin").none(false), py::arg("mix") = 0.5,
+           py::keep_alive<1, 2>())
+      .def("__repr__",
+           [](const Mix &plugin) {
+             std::ostringstream ss;
+             ss << "<pedalboard.Mix";
+             py::object wrapped = py::cast(
+                 plugin.getPlugin(), py::return_value_policy::reference);
+             ss << " plugin=" << py::repr(wrapped).cast<std::string>();
+             ss << " mix=" << plugin.getMix();
+             ss << " at " << &plugin;
+             ss << ">";
+             return ss.str();
+           })
+      .def_property_readonly(
+          "plugin", &Mix::getPlugin, py::return_value_policy::reference,
+          "The plugin whose output is mixed with its input.")
+      .def_property("mix", &Mix::getMix, &Mix::setMix);
+}
+}; // namespace Pedalboard
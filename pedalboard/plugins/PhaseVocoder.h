@@ -0,0 +1,385 @@
+/*
+ * pedalboard
+ * Copyright 2021 Spotify AB
+ *
+ * Licensed under the GNU Public License, Version 3.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "../JuceHeader.h"
+
+namespace Pedalboard {
+
+/**
+ * A streaming phase vocoder, used by TimeStretch and PitchShift to change
+ * the duration of audio without changing its pitch.
+ *
+ * Frames of fftSize samples are analysed every (rate * synthesisHopSize)
+ * input samples, and resynthesised every synthesisHopSize output samples,
+ * with identity phase locking (Laroche & Dolson, 1999): only the phases of
+ * spectral peaks are advanced by their measured frequency, and every other
+ * bin keeps its phase relative to the nearest peak. This avoids most of the
+ * "phasiness" of a plain phase vocoder.
+ *
+ * Input can be pushed in blocks of any size; output becomes available one
+ * hop at a time. Output sample i corresponds to input time
+ * (i - outputOffset) * rate: the first frame is centred one hop before the
+ * first input sample (so that every output sample is made up of a full set
+ * of overlapping frames), so the output starts with (near) silence.
+ *
+ * Buffers are only allocated when first prepared, and are freed again when
+ * released.
+ */
+class PhaseVocoder {
+public:
+  static constexpr int fftOrder = 11;
+  static constexpr int fftSize = 1 << fftOrder;
+  static constexpr int numBins = fftSize / 2 + 1;
+  static constexpr int synthesisHopSize = fftSize / 4;
+  static constexpr int outputOffset = fftSize / 2 + synthesisHopSize;
+
+  /**
+   * Prepares to consume blocks of up to maximumInputBlockSize samples, at
+   * the given rate (the number of input samples consumed for every output
+   * sample produced). Also resets all state.
+   */
+  void prepare(int numChannels, int maximumInputBlockSize, double rate) {
+    analysisHopSize = synthesisHopSize * rate;
+
+    // The input buffer holds the padding before the first frame, or less
+    // than one frame that hasn't been analysed yet, plus the incoming block.
+    // The output buffer holds the unread output, which lags behind the input
+    // by up to two frames:
+    const int inputSize = 2 * fftSize +
+                          static_cast<int>(std::ceil(analysisHopSize)) +
+                          maximumInputBlockSize;
+    const int outputSize =
+        static_cast<int>(
+            std::ceil((maximumInputBlockSize + 2 * fftSize) / rate)) +
+        4 * fftSize;
+
+    if (!buffers || buffers->input.getNumChannels() != numChannels ||
+        buffers->input.getNumSamples() < inputSize ||
+        buffers->output.getNumSamples() < outputSize) {
+      buffers = std::make_unique<Buffers>();
+      buffers->fft = std::make_unique<juce::dsp::FFT>(fftOrder);
+
+      // A periodic Hann window is used for both analysis and synthesis. At a
+      // hop of a quarter of the frame, the squared windows sum to 1.5.
+      buffers->analysisWindow.resize(fftSize);
+      buffers->synthesisWindow.resize(fftSize);
+      for (int i = 0; i < fftSize; i++) {
+        const float window = static_cast<float>(
+            0.5 - 0.5 * std::cos(juce::MathConstants<double>::twoPi * i /
+                                 fftSize));
+        buffers->analysisWindow[i] = window;
+        buffers->synthesisWindow[i] = window / 1.5f;
+      }
+
+      buffers->fftData.resize(2 * fftSize);
+      buffers->magnitudes.resize(numBins);
+      buffers->phases.resize(numBins);
+      buffers->peaks.resize(numBins);
+      buffers->input.setSize(numChannels, inputSize);
+      buffers->output.setSize(numChannels, outputSize);
+      buffers->analysisPhases.setSize(numChannels, numBins);
+      buffers->synthesisPhases.setSize(numChannels, numBins);
+    }
+
+    reset();
+  }
+
+  void reset() noexcept {
+    if (!buffers)
+      return;
+
+    auto &b = *buffers;
+    b.input.clear();
+    b.output.clear();
+
+    // The first frame is centred one hop before the first input sample, so
+    // start with half a frame (and a hop) of silence:
+    b.inputStart = 0;
+    b.inputLength = fftSize / 2 + static_cast<int>(getFramePosition(1));
+    b.outputStart = 0;
+    b.readPosition = 0;
+    b.numFrames = 0;
+    b.previousFramePosition = 0;
+  }
+
+  void release() { buffers.reset(); }
+
+  /**
+   * Zeroes every bin above the given fraction of the Nyquist frequency
+   * before resynthesis, so that the output can be resampled to a lower
+   * sample rate without aliasing.
+   */
+  void setBandwidth(double fractionOfNyquist) noexcept {
+    maximumBin = juce::jlimit(0, numBins - 1,
+                              static_cast<int>(fractionOfNyquist *
+                                               (numBins - 1)));
+  }
+
+  /**
+   * Consumes a block of input, analysing and resynthesising every frame
+   * that it completes.
+   */
+  void push(const juce::dsp::AudioBlock<const float> &block) noexcept {
+    auto &b = *buffers;
+    const int numSamples = static_cast<int>(block.getNumSamples());
+
+    // Drop any input that no future frame will read. (If frames are further
+    // apart than they are long, some of the incoming block is skipped too.)
+    const juce::int64 incomingStart = b.inputStart + b.inputLength;
+    const juce::int64 keepFrom =
+        std::max(b.inputStart, std::min(getFramePosition(b.numFrames),
+                                        incomingStart + numSamples));
+    const int numKept = static_cast<int>(
+        std::max<juce::int64>(0, incomingStart - keepFrom));
+    const int firstIncoming = static_cast<int>(
+        std::max<juce::int64>(0, keepFrom - incomingStart));
+
+    for (int channel = 0; channel < b.input.getNumChannels(); channel++) {
+      float *input = b.input.getWritePointer(channel);
+      std::memmove(input, input + (b.inputLength - numKept),
+                   sizeof(float) * numKept);
+      juce::FloatVectorOperations::copy(
+          input + numKept, block.getChannelPointer(channel) + firstIncoming,
+          numSamples - firstIncoming);
+    }
+    b.inputStart = keepFrom;
+    b.inputLength = numKept + numSamples - firstIncoming;
+
+    for (;;) {
+      const juce::int64 framePosition = getFramePosition(b.numFrames);
+      if (framePosition + fftSize > b.inputStart + b.inputLength)
+        break;
+
+      if (!makeRoomForFrame()) {
+        // The output hasn't been read quickly enough; try again later.
+        jassertfalse;
+        break;
+      }
+
+      processFrame(framePosition);
+    }
+  }
+
+  /**
+   * Returns the position just after the last output sample that's been
+   * completely resynthesised.
+   */
+  juce::int64 getNumOutputSamplesReady() const noexcept {
+    return buffers->numFrames * synthesisHopSize;
+  }
+
+  /**
+   * Returns a pointer to the output sample at the given position, which must
+   * not have been discarded yet. Samples are valid up to
+   * getNumOutputSamplesReady().
+   */
+  const float *getOutput(int channel, juce::int64 position) const noexcept {
+    jassert(position >= buffers->readPosition);
+    return buffers->output.getReadPointer(channel) +
+           (position - buffers->outputStart);
+  }
+
+  /**
+   * Frees up the space used by output samples before the given position,
+   * which will not be read again.
+   */
+  void discardOutputBefore(juce::int64 position) noexcept {
+    auto &b = *buffers;
+    b.readPosition = std::max(
+        b.readPosition, std::min(position, getNumOutputSamplesReady()));
+  }
+
+private:
+  juce::int64 getFramePosition(juce::int64 frame) const noexcept {
+    return std::llround(static_cast<double>(frame) * analysisHopSize);
+  }
+
+  // Shifts unread output to the start of the output buffer if the next
+  // frame wouldn't otherwise fit. Returns false if it still doesn't fit.
+  bool makeRoomForFrame() noexcept {
+    auto &b = *buffers;
+    const int capacity = b.output.getNumSamples();
+    const juce::int64 frameEnd =
+        b.numFrames * synthesisHopSize + fftSize - b.outputStart;
+    if (frameEnd <= capacity)
+      return true;
+
+    const int shift = static_cast<int>(b.readPosition - b.outputStart);
+    for (int channel = 0; channel < b.output.getNumChannels(); channel++) {
+      float *output = b.output.getWritePointer(channel);
+      std::memmove(output, output + shift,
+                   sizeof(float) * (capacity - shift));
+      juce::FloatVectorOperations::clear(output + capacity - shift, shift);
+    }
+    b.outputStart = b.readPosition;
+    return frameEnd - shift <= capacity;
+  }
+
+  static float wrapPhase(float phase) noexcept {
+    return phase - juce::MathConstants<float>::twoPi *
+                       std::round(phase / juce::MathConstants<float>::twoPi);
+  }
+
+  // Finds the local maxima of the magnitude spectrum, and returns how many
+  // there are. If there are none (i.e.: in silence), every bin is treated as
+  // its own peak.
+  int findPeaks() noexcept {
+    auto &b = *buffers;
+    const float *m = b.magnitudes.data();
+    int numPeaks = 0;
+    for (int bin = 2; bin < numBins - 2; bin++) {
+      if (m[bin] > m[bin - 1] && m[bin] > m[bin - 2] && m[bin] >= m[bin + 1] &&
+          m[bin] >= m[bin + 2])
+        b.peaks[numPeaks++] = bin;
+    }
+
+    if (numPeaks == 0) {
+      for (int bin = 0; bin < numBins; bin++)
+        b.peaks[bin] = bin;
+      numPeaks = numBins;
+    }
+    return numPeaks;
+  }
+
+  void processFrame(juce::int64 framePosition) noexcept {
+    auto &b = *buffers;
+    float *fftData = b.fftData.data();
+    float *magnitudes = b.magnitudes.data();
+    float *phases = b.phases.data();
+
+    const int inputIndex = static_cast<int>(framePosition - b.inputStart);
+    const int outputIndex = static_cast<int>(
+        b.numFrames * synthesisHopSize - b.outputStart);
+    const float analysisHop =
+        static_cast<float>(framePosition - b.previousFramePosition);
+    const float binFrequency =
+        juce::MathConstants<float>::twoPi / static_cast<float>(fftSize);
+
+    for (int channel = 0; channel < b.input.getNumChannels(); channel++) {
+      juce::FloatVectorOperations::multiply(
+          fftData, b.input.getReadPointer(channel, inputIndex),
+          b.analysisWindow.data(), fftSize);
+      juce::FloatVectorOperations::clear(fftData + fftSize, fftSize);
+      b.fft->performRealOnlyForwardTransform(fftData, true);
+
+      for (int bin = 0; bin < numBins; bin++) {
+        const float real = fftData[bin * 2];
+        const float imag = fftData[bin * 2 + 1];
+        magnitudes[bin] = std::sqrt(real * real + imag * imag);
+        phases[bin] = std::atan2(imag, real);
+      }
+
+      float *previousPhases = b.analysisPhases.getWritePointer(channel);
+      float *synthesisPhases = b.synthesisPhases.getWritePointer(channel);
+
+      if (b.numFrames == 0) {
+        juce::FloatVectorOperations::copy(synthesisPhases, phases, numBins);
+      } else {
+        const int numPeaks = findPeaks();
+
+        // Advance the phase of each peak by its instantaneous frequency,
+        // measured from the change in phase since the previous frame:
+        for (int i = 0; i < numPeaks; i++) {
+          const int peak = b.peaks[i];
+          const float expected = binFrequency * peak * analysisHop;
+          const float deviation =
+              wrapPhase(phases[peak] - previousPhases[peak] - expected);
+          const float frequency = binFrequency * peak + deviation / analysisHop;
+          synthesisPhases[peak] =
+              wrapPhase(synthesisPhases[peak] + frequency * synthesisHopSize);
+        }
+
+        // ...and lock every other bin to the peak whose region it's in.
+        for (int i = 0; i < numPeaks; i++) {
+          const int peak = b.peaks[i];
+          const int start = i == 0 ? 0 : (b.peaks[i - 1] + peak) / 2 + 1;
+          const int end =
+              i == numPeaks - 1 ? numBins : (peak + b.peaks[i + 1]) / 2 + 1;
+          for (int bin = start; bin < end; bin++) {
+            if (bin != peak)
+              synthesisPhases[bin] =
+                  synthesisPhases[peak] + phases[bin] - phases[peak];
+          }
+        }
+      }
+
+      juce::FloatVectorOperations::copy(previousPhases, phases, numBins);
+
+      for (int bin = 0; bin < numBins; bin++) {
+        const float magnitude = bin <= maximumBin ? magnitudes[bin] : 0.0f;
+        fftData[bin * 2] = magnitude * std::cos(synthesisPhases[bin]);
+        fftData[bin * 2 + 1] = magnitude * std::sin(synthesisPhases[bin]);
+      }
+
+      // Fill in the negative frequencies, so that the output is real:
+      for (int bin = 1; bin < numBins - 1; bin++) {
+        fftData[(fftSize - bin) * 2] = fftData[bin * 2];
+        fftData[(fftSize - bin) * 2 + 1] = -fftData[bin * 2 + 1];
+      }
+
+      b.fft->performRealOnlyInverseTransform(fftData);
+      juce::FloatVectorOperations::addWithMultiply(
+          b.output.getWritePointer(channel, outputIndex), fftData,
+          b.synthesisWindow.data(), fftSize);
+    }
+
+    b.previousFramePosition = framePosition;
+    b.numFrames++;
+  }
+
+  double analysisHopSize = synthesisHopSize;
+  int maximumBin = numBins - 1;
+
+  struct Buffers {
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::vector<float> analysisWindow;
+    std::vector<float> synthesisWindow;
+
+    // Scratch space for the frame being processed.
+    std::vector<float> fftData;
+    std::vector<float> magnitudes;
+    std::vector<float> phases;
+    std::vector<int> peaks;
+
+    // The input buffer holds input samples from inputStart (counted from
+    // the start of the zero-padded input); the output buffer holds output
+    // samples from outputStart. Both positions only ever increase.
+    juce::AudioBuffer<float> input;
+    juce::AudioBuffer<float> output;
+    juce::int64 inputStart = 0;
+    int inputLength = 0;
+    juce::int64 outputStart = 0;
+    juce::int64 readPosition = 0;
+
+    // The phase of each bin in the previous analysis frame, and in the most
+    // recent synthesis frame, for each channel.
+    juce::AudioBuffer<float> analysisPhases;
+    juce::AudioBuffer<float> synthesisPhases;
+
+    juce::int64 numFrames = 0;
+    juce::int64 previousFramePosition = 0;
+  };
+  std::unique_ptr<Buffers> buffers;
+};
+}; // namespace Pedalboard
@@ -23,37 +23,254 @@ namespace py = pybind11;
 #include "../JucePlugin.h"
 
 namespace Pedalboard {
+/**
+ * A phaser with the same parameters and sound as juce::dsp::Phaser, but with
+ * a configurable number of all-pass stages, and a faster implementation:
+ *
+ *  - Like juce::dsp::Phaser, the all-pass filters' cutoff frequency is only
+ *    updated every few samples. Each update is computed once and shared by
+ *    every stage and channel (juce::dsp::Phaser recalculates it separately
+ *    for each filter and channel, calling std::tan every time).
+ *  - Channels are processed together, in SIMD lanes, so that each stage of
+ *    the cascade is computed for both channels of stereo audio at once.
+ *    (There are four lanes, to fill a vector of floats; as pedalboard only
+ *    processes mono or stereo audio, the others just duplicate a channel.)
+ */
+template <typename SampleType> class PhaserEngine {
+public:
+  void setRate(SampleType newRate) { rate = newRate; }
+  void setDepth(SampleType newDepth) { depth = newDepth; }
+  void setCentreFrequency(SampleType newCentreFrequency) {
+    centreFrequency = newCentreFrequency;
+  }
+  void setFeedback(SampleType newFeedback) { feedback = newFeedback; }
+  void setMix(SampleType newMix) { mix = newMix; }
+  void setStages(int newStages) { stages = newStages; }
+
+  void prepare(const juce::dsp::ProcessSpec &spec) {
+    sampleRate = spec.sampleRate;
+
+    const size_t numGroups = (spec.numChannels + numLanes - 1) / numLanes;
+    if (groups.size() != numGroups) {
+      groups.resize(numGroups);
+      reset();
+    }
+  }
+
+  void reset() noexcept {
+    for (auto &group : groups)
+      group = {};
+    phase = 0;
+    updateCounter = 0;
+    coefficient = 0;
+  }
+
+  template <typename ProcessContext>
+  void process(const ProcessContext &context) noexcept {
+    const auto &inputBlock = context.getInputBlock();
+    auto &outputBlock = context.getOutputBlock();
+    const auto numChannels = outputBlock.getNumChannels();
+    const auto numSamples = outputBlock.getNumSamples();
+
+    jassert(inputBlock.getNumChannels() == numChannels);
+    jassert(inputBlock.getNumSamples() == numSamples);
+    jassert(numChannels <= groups.size() * numLanes);
+
+    if (context.isBypassed) {
+      if (context.usesSeparateInputAndOutputBlocks())
+        outputBlock.copyFrom(inputBlock);
+      return;
+    }
+
+    const SampleType wetGain = mix;
+    const SampleType dryGain = 1 - mix;
+
+    for (size_t start = 0; start < numSamples; start += blockSize) {
+      const int numInBlock =
+          static_cast<int>(std::min<size_t>(blockSize, numSamples - start));
+      computeCoefficients(numInBlock);
+
+      for (size_t group = 0; group * numLanes < numChannels; group++) {
+        const size_t firstChannel = group * numLanes;
+        const size_t numInGroup =
+            std::min<size_t>(numLanes, numChannels - firstChannel);
+
+        const SampleType *inputs[numLanes];
+        SampleType *outputs[numLanes];
+        for (size_t lane = 0; lane < numLanes; lane++) {
+          // Unused lanes just process a copy of the group's first channel.
+          const size_t channel = firstChannel + (lane < numInGroup ? lane : 0);
+          inputs[lane] = inputBlock.getChannelPointer(channel) + start;
+          outputs[lane] = outputBlock.getChannelPointer(channel) + start;
+        }
+
+        processGroup(groups[group], inputs, numInBlock);
+
+        for (size_t lane = 0; lane < numInGroup; lane++) {
+          for (int i = 0; i < numInBlock; i++) {
+            outputs[lane][i] = inputs[lane][i] * dryGain +
+                               groups[group].wet[lane][i] * wetGain;
+          }
+        }
+      }
+    }
+  }
+
+private:
+  static constexpr size_t numLanes = 4;
+  static constexpr int maximumStages = 12;
+
+  // The number of samples processed at a time.
+  static constexpr int blockSize = 256;
+
+  // As in juce::dsp::Phaser, the all-pass filters' cutoff frequency is
+  // updated once every this many samples.
+  static constexpr int samplesPerUpdate = 4;
+
+  struct LaneGroup {
+    SampleType state[maximumStages][numLanes] = {};
+    SampleType lastOutput[numLanes] = {};
+    SampleType wet[numLanes][blockSize] = {};
+  };
+
+  /**
+   * Fills the coefficients array with each sample's all-pass coefficient,
+   * advancing the LFO once per update.
+   */
+  void computeCoefficients(int numSamples) noexcept {
+    // As in juce::dsp::Phaser, the centre frequency is mapped to [0, 1] over
+    // 20Hz-20kHz, but the LFO's output is mapped back over 20Hz-Nyquist:
+    const double logMinimum = std::log10(20.0);
+    const double logMaximum = std::log10(20000.0);
+    const double logLimit = std::log10(std::min(20000.0, 0.49 * sampleRate));
+    const SampleType normalisedCentre = static_cast<SampleType>(
+        (std::log10(static_cast<double>(centreFrequency)) - logMinimum) /
+        (logMaximum - logMinimum));
+    const double increment = juce::MathConstants<double>::twoPi * rate /
+                             (sampleRate / samplesPerUpdate);
+    const SampleType volume = depth * static_cast<SampleType>(0.5);
+
+    for (int i = 0; i < numSamples; i++) {
+      if (updateCounter == 0) {
+        // juce::dsp::Phaser's LFO is sin(phase - pi), or -sin(phase).
+        const SampleType oscillator = static_cast<SampleType>(-std::sin(phase));
+        const SampleType lfo =
+            juce::jlimit(static_cast<SampleType>(0), static_cast<SampleType>(1),
+                         oscillator * volume + normalisedCentre);
+        const double frequency =
+            std::pow(10.0, lfo * (logLimit - logMinimum) + logMinimum);
+        const SampleType g = static_cast<SampleType>(
+            std::tan(juce::MathConstants<double>::pi * frequency / sampleRate));
+        coefficient = g / (1 + g);
+        phase =
+            std::fmod(phase + increment, juce::MathConstants<double>::twoPi);
+      }
+
+      coefficients[i] = coefficient;
+      updateCounter = (updateCounter + 1) % samplesPerUpdate;
+    }
+  }
+
+  /**
+   * Runs up to numLanes channels through the feedback loop and all-pass
+   * cascade (using the topology-preserving transform first-order all-pass
+   * filter, as juce::dsp::Phaser does), leaving the result in group.wet.
+   */
+  void processGroup(LaneGroup &group, const SampleType *const *inputs,
+                    int numSamples) noexcept {
+    const int numStages = stages;
+    const SampleType feedbackGain = feedback;
+
+    for (int i = 0; i < numSamples; i++) {
+      const SampleType G = coefficients[i];
+
+      SampleType x[numLanes];
+      for (size_t lane = 0; lane < numLanes; lane++)
+        x[lane] = inputs[lane][i] - group.lastOutput[lane];
+
+      for (int stage = 0; stage < numStages; stage++) {
+        SampleType *state = group.state[stage];
+        for (size_t lane = 0; lane < numLanes; lane++) {
+          const SampleType v = G * (x[lane] - state[lane]);
+          const SampleType y = v + state[lane];
+          state[lane] = y + v;
+          x[lane] = 2 * y - x[lane];
+        }
+      }
+
+      for (size_t lane = 0; lane < numLanes; lane++) {
+        group.wet[lane][i] = x[lane];
+        group.lastOutput[lane] = x[lane] * feedbackGain;
+      }
+    }
+  }
+
+  // Defaults match those of juce::dsp::Phaser.
+  SampleType rate = 1.0, depth = 0.5, centreFrequency = 1300.0, feedback = 0.0,
+             mix = 0.5;
+  int stages = 6;
+
+  double sampleRate = 44100.0;
+  double phase = 0;
+  int updateCounter = 0;
+  SampleType coefficient = 0;
+  SampleType coefficients[blockSize] = {};
+  std::vector<LaneGroup> groups;
+};
+
 template <typename SampleType>
-class Phaser : public JucePlugin<juce::dsp::Phaser<SampleType>> {
+class Phaser : public JucePlugin<PhaserEngine<SampleType>> {
   DEFINE_DSP_SETTER_AND_GETTER(SampleType, Rate, {});
   DEFINE_DSP_SETTER_AND_GETTER(SampleType, Depth, {});
   DEFINE_DSP_SETTER_AND_GETTER(SampleType, CentreFrequency, {});
   DEFINE_DSP_SETTER_AND_GETTER(SampleType, Feedback, {});
   DEFINE_DSP_SETTER_AND_GETTER(SampleType, Mix, {});
+  DEFINE_DSP_SETTER_AND_GETTER(int, Stages, {
+    if (value != 4 && value != 6 && value != 8 && value != 12) {
+      throw std::range_error("Phaser stages must be one of 4, 6, 8, or 12.");
+    }
+  });
+};
+
+/**
+ * juce::dsp::Phaser, which has six stages and computes each filter's
+ * coefficient separately for every channel. Only exposed (privately) so
+ * that Phaser can be benchmarked against it.
+ */
+class ReferencePhaser : public JucePlugin<juce::dsp::Phaser<float>> {
+  DEFINE_DSP_SETTER_AND_GETTER(float, Rate, {});
+  DEFINE_DSP_SETTER_AND_GETTER(float, Depth, {});
+  DEFINE_DSP_SETTER_AND_GETTER(float, CentreFrequency, {});
+  DEFINE_DSP_SETTER_AND_GETTER(float, Feedback, {});
+  DEFINE_DSP_SETTER_AND_GETTER(float, Mix, {});
 };
 
 inline void init_phaser(py::module &m) {
 
   py::class_<Phaser<float>, Plugin>(
       m, "Phaser",
-      "A 6 stage phaser that modulates first order all-pass filters to create "
-      "sweeping notches in the magnitude frequency response. This audio effect "
-      "can be controlled with standard phaser parameters: the speed and depth "
-      "of the LFO controlling the frequency response, a mix control, a "
-      "feedback control, and the centre frequency of the modulation.")
+      "A phaser that modulates a cascade of first order all-pass filters (6 "
+      "by default; 4, 8, or 12 can also be chosen with the stages argument) to "
+      "create sweeping notches in the magnitude frequency response. This "
+      "audio effect can be controlled with standard phaser parameters: the "
+      "speed and depth of the LFO controlling the frequency response, a mix "
+      "control, a feedback control, and the centre frequency of the "
+      "modulation. The cost of processing is proportional to the number of "
+      "stages.")
       .def(py::init([](float rateHz, float depth, float centreFrequency,
-                       float feedback, float mix) {
+                       float feedback, float mix, int stages) {
              auto plugin = new Phaser<float>();
              plugin->setRate(rateHz);
              plugin->setDepth(depth);
              plugin->setCentreFrequency(centreFrequency);
              plugin->setFeedback(feedback);
              plugin->setMix(mix);
+             plugin->setStages(stages);
              return plugin;
            }),
            py::arg("rate_hz") = 1.0, py::arg("depth") = 0.5,
            py::arg("centre_frequency_hz") = 1300.0, py::arg("feedback") = 0.0,
-           py::arg("mix") = 0.5)
+           py::arg("mix") = 0.5, py::arg("stages") = 6)
       .def("__repr__",
            [](const Phaser<float> &plugin) {
              std::ostringstream ss;
@@ -63,6 +280,7 @@ inline void init_phaser(py::module &m) {
              ss << " centre_frequency_hz=" << plugin.getCentreFrequency();
              ss << " feedback=" << plugin.getFeedback();
              ss << " mix=" << plugin.getMix();
+             ss << " stages=" << plugin.getStages();
              ss << " at " << &plugin;
              ss << ">";
              return ss.str();
@@ -73,6 +291,25 @@ inline void init_phaser(py::module &m) {
                     &Phaser<float>::setCentreFrequency)
       .def_property("feedback", &Phaser<float>::getFeedback,
                     &Phaser<float>::setFeedback)
-      .def_property("mix", &Phaser<float>::getMix, &Phaser<float>::setMix);
+      .def_property("mix", &Phaser<float>::getMix, &Phaser<float>::setMix)
+      .def_property("stages", &Phaser<float>::getStages,
+                    &Phaser<float>::setStages);
+
+  py::class_<ReferencePhaser, Plugin>(
+      m, "_ReferencePhaser",
+      "juce::dsp::Phaser, for benchmarking Phaser against.")
+      .def(py::init([](float rateHz, float depth, float centreFrequency,
+                       float feedback, float mix) {
+             auto plugin = new ReferencePhaser();
+             plugin->setRate(rateHz);
+             plugin->setDepth(depth);
+             plugin->setCentreFrequency(centreFrequency);
+             plugin->setFeedback(feedback);
+             plugin->setMix(mix);
+             return plugin;
+           }),
+           py::arg("rate_hz") = 1.0, py::arg("depth") = 0.5,
+           py::arg("centre_frequency_hz") = 1300.0, py::arg("feedback") = 0.0,
+           py::arg("mix") = 0.5);
 }
 }; // namespace Pedalboard
\ No newline at end of file
@@ -0,0 +1,161 @@
+/*
+ * pedalboard
+ * Copyright 2021 Spotify AB
+ *
+ * Licensed under the GNU Public License, Version 3.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+
+#include "../JucePlugin.h"
+#include "PhaseVocoder.h"
+
+namespace Pedalboard {
+
+/**
+ * Changes the pitch of audio without changing its duration, by stretching
+ * it with a PhaseVocoder (to make it 2^(semitones / 12) times as long) and
+ * reading the result back at 2^(semitones / 12) times the speed, with cubic
+ * interpolation. When shifting upwards, the vocoder discards everything that
+ * would alias once read back faster.
+ *
+ * The output is delayed by enough that the vocoder always has enough input
+ * to produce it; this delay is reported as the plugin's latency.
+ */
+class PitchShifter {
+public:
+  void setSemitones(float newSemitones) { semitones = newSemitones; }
+
+  void prepare(const juce::dsp::ProcessSpec &spec) {
+    speed = std::pow(2.0, semitones / 12.0);
+    vocoder.prepare(spec.numChannels, spec.maximumBlockSize, 1.0 / speed);
+    vocoder.setBandwidth(std::min(1.0, 1.0 / speed));
+
+    // Output sample n is read from around n * speed in the vocoder's output,
+    // which can only be resynthesised once the vocoder's seen the half frame
+    // of input after it. (Interpolation also needs two samples after it.)
+    constexpr int halfFrame = PhaseVocoder::fftSize / 2;
+    latency = halfFrame + static_cast<int>(std::ceil((halfFrame + 3) / speed));
+    reset();
+  }
+
+  void reset() noexcept {
+    vocoder.reset();
+    numSamplesProcessed = 0;
+  }
+
+  void release() { vocoder.release(); }
+
+  int getLatencySamples() const noexcept { return latency; }
+
+  template <typename ProcessContext>
+  void process(const ProcessContext &context) noexcept {
+    const auto &inputBlock = context.getInputBlock();
+    auto &outputBlock = context.getOutputBlock();
+    const auto numChannels = outputBlock.getNumChannels();
+    const auto numSamples = outputBlock.getNumSamples();
+
+    jassert(inputBlock.getNumChannels() == numChannels);
+    jassert(inputBlock.getNumSamples() == numSamples);
+
+    if (context.isBypassed) {
+      if (context.usesSeparateInputAndOutputBlocks())
+        outputBlock.copyFrom(inputBlock);
+      return;
+    }
+
+    vocoder.push(inputBlock);
+    const juce::int64 ready = vocoder.getNumOutputSamplesReady();
+
+    const double start =
+        PhaseVocoder::outputOffset +
+        static_cast<double>(numSamplesProcessed - latency) * speed;
+
+    for (size_t channel = 0; channel < numChannels; channel++) {
+      float *output = outputBlock.getChannelPointer(channel);
+
+      for (size_t i = 0; i < numSamples; i++) {
+        const double position = start + static_cast<double>(i) * speed;
+        const juce::int64 index = static_cast<juce::int64>(position);
+
+        // Before the latency has passed, there's nothing to read yet.
+        if (position < 1 || index + 2 >= ready) {
+          jassert(position < 1);
+          output[i] = 0;
+          continue;
+        }
+
+        const float *y =
+            vocoder.getOutput(static_cast<int>(channel), index - 1);
+        const float x = static_cast<float>(position - index);
+
+        // A Catmull-Rom spline through y[0] to y[3], between y[1] and y[2]:
+        output[i] =
+            y[1] + 0.5f * x *
+                       (y[2] - y[0] +
+                        x * (2.0f * y[0] - 5.0f * y[1] + 4.0f * y[2] - y[3] +
+                             x * (3.0f * (y[1] - y[2]) + y[3] - y[0])));
+      }
+    }
+
+    numSamplesProcessed += numSamples;
+    const double next = start + static_cast<double>(numSamples) * speed;
+    vocoder.discardOutputBefore(static_cast<juce::int64>(next) - 1);
+  }
+
+private:
+  float semitones = 0;
+  double speed = 1.0;
+  int latency = 0;
+  juce::int64 numSamplesProcessed = 0;
+
+  PhaseVocoder vocoder;
+};
+
+class PitchShift : public JucePlugin<PitchShifter> {
+  DEFINE_DSP_SETTER_AND_GETTER(float, Semitones, {
+    if (value < -24.0 || value > 24.0) {
+      throw std::range_error("Semitones must be between -24.0 and 24.0.");
+    }
+  });
+};
+
+inline void init_pitchshift(py::module &m) {
+  py::class_<PitchShift, Plugin>(
+      m, "PitchShift",
+      "Shifts the pitch of audio by a number of semitones (up to two octaves "
+      "up or down) without changing its duration, using a phase vocoder with "
+      "identity phase locking. Audio is streamed through the vocoder one "
+      "block at a time, and the output is aligned to the start of the input.")
+      .def(py::init([](float semitones) {
+             auto plugin = std::make_unique<PitchShift>();
+             plugin->setSemitones(semitones);
+             return plugin;
+           }),
+           py::arg("semitones") = 0.0)
+      .def("__repr__",
+           [](const PitchShift &plugin) {
+             std::ostringstream ss;
+             ss << "<pedalboard.PitchShift";
+             ss << " semitones=" << plugin.getSemitones();
+             ss << " at " << &plugin;
+             ss << ">";
+             return ss.str();
+           })
+      .def_property("semitones", &PitchShift::getSemitones,
+                    &PitchShift::setSemitones);
+}
+}; // namespace Pedalboard
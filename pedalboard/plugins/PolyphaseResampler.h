@@ -0,0 +1,264 @@
+/*
+ * pedalboard
+ * Copyright 2021 Spotify AB
+ *
+ * Licensed under the GNU Public License, Version 3.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "../JuceHeader.h"
+
+namespace Pedalboard {
+
+/**
+ * Returns the fraction (numerator, denominator) closest to ratio with
+ * neither term larger than maximumTerm, using continued fractions.
+ */
+inline std::pair<int, int> getRationalApproximation(double ratio,
+                                                    int maximumTerm) {
+  jassert(ratio > 0);
+  long long previousNumerator = 0, numerator = 1;
+  long long previousDenominator = 1, denominator = 0;
+  double remainder = ratio;
+
+  while (true) {
+    const long long term = static_cast<long long>(std::floor(remainder));
+    const long long nextNumerator = term * numerator + previousNumerator;
+    const long long nextDenominator = term * denominator + previousDenominator;
+    if (nextNumerator > maximumTerm || nextDenominator > maximumTerm)
+      break;
+
+    previousNumerator = numerator;
+    previousDenominator = denominator;
+    numerator = nextNumerator;
+    denominator = nextDenominator;
+
+    const double fraction = remainder - term;
+    if (std::abs(static_cast<double>(numerator) / denominator - ratio) <=
+            1e-12 * ratio ||
+        fraction <= 0)
+      break;
+    remainder = 1.0 / fraction;
+  }
+
+  // Ratios too extreme to approximate at all are clamped:
+  if (denominator == 0)
+    return {maximumTerm, 1};
+  if (numerator == 0)
+    return {1, maximumTerm};
+  return {static_cast<int>(numerator), static_cast<int>(denominator)};
+}
+
+/**
+ * Streams audio through a rational sample rate converter, which upsamples
+ * by upsamplingFactor (L) and then downsamples by downsamplingFactor (M)
+ * without computing any of the samples it would discard.
+ *
+ * A single low-pass prototype filter (a Kaiser-windowed sinc, cut off just
+ * below the Nyquist frequency of the lower of the two rates) is split into
+ * L phases. Each output sample is a dot product of one phase with the most
+ * recent input samples; the phases are stored reversed so that this reads
+ * both contiguously.
+ *
+ * Output sample m is taken at time (m * M + timeOffset) / L in input
+ * samples, so the output lags the input by getLatencySamples(), which may
+ * be fractional. (Callers can choose timeOffset to round it off.)
+ */
+class PolyphaseResampler {
+public:
+  // The length of the prototype filter, in samples of the lower rate. The
+  // Kaiser window's beta gives roughly 80dB of stopband attenuation.
+  static constexpr int tapsPerLowRateSample = 64;
+  static constexpr float kaiserBeta = 8.0f;
+  static constexpr double passbandFraction = 0.92;
+
+  /**
+   * Returns the number of taps in each phase of the filter for the given
+   * factors (rounded up to an even number).
+   */
+  static int getTapsPerPhase(int upsamplingFactor, int downsamplingFactor) {
+    const int taps = (tapsPerLowRateSample *
+                          std::max(upsamplingFactor, downsamplingFactor) +
+                      upsamplingFactor - 1) /
+                     upsamplingFactor;
+    return taps + (taps % 2);
+  }
+
+  void prepare(int numChannels, int newUpsamplingFactor,
+               int newDownsamplingFactor, int newTimeOffset,
+               int maximumInputBlockSize) {
+    if (newUpsamplingFactor != upsamplingFactor ||
+        newDownsamplingFactor != downsamplingFactor) {
+      upsamplingFactor = newUpsamplingFactor;
+      downsamplingFactor = newDownsamplingFactor;
+      tapsPerPhase = getTapsPerPhase(upsamplingFactor, downsamplingFactor);
+      designFilter();
+    }
+
+    timeOffset = newTimeOffset;
+    history.setSize(numChannels, tapsPerPhase - 1 + maximumInputBlockSize);
+    reset();
+  }
+
+  void reset() noexcept {
+    // Start with a filter's worth of silence:
+    history.clear();
+    numInputSamples = 0;
+    numOutputSamples = 0;
+  }
+
+  void release() {
+    history = juce::AudioBuffer<float>();
+    phases = std::vector<float>();
+    upsamplingFactor = downsamplingFactor = 0;
+  }
+
+  /**
+   * Returns the most output samples that can be produced from a block of
+   * the given size.
+   */
+  int getMaximumOutputBlockSize(int inputBlockSize) const {
+    return static_cast<int>(
+               (static_cast<juce::int64>(inputBlockSize) * upsamplingFactor +
+                downsamplingFactor - 1) /
+               downsamplingFactor) +
+           1;
+  }
+
+  double getLatencySamples() const {
+    return ((tapsPerPhase * upsamplingFactor - 1) / 2.0 - timeOffset) /
+           downsamplingFactor;
+  }
+
+  /**
+   * Consumes every sample of input, and writes every output sample that can
+   * be produced from it to output (which must have room for at least
+   * getMaximumOutputBlockSize() samples per channel). Returns the number of
+   * samples written.
+   */
+  int process(const juce::dsp::AudioBlock<const float> &input,
+              float *const *output) noexcept {
+    const int numSamples = static_cast<int>(input.getNumSamples());
+    const int historyLength = tapsPerPhase - 1;
+    jassert(historyLength + numSamples <= history.getNumSamples());
+
+    for (int channel = 0; channel < history.getNumChannels(); channel++) {
+      juce::FloatVectorOperations::copy(
+          history.getWritePointer(channel, historyLength),
+          input.getChannelPointer(channel), numSamples);
+    }
+
+    // history[i] holds input sample (numInputSamples - historyLength + i).
+    const juce::int64 endOfInput = numInputSamples + numSamples;
+    int numWritten = 0;
+    while (true) {
+      const juce::int64 time =
+          numOutputSamples * downsamplingFactor + timeOffset;
+      const juce::int64 newestSample = time / upsamplingFactor;
+      if (newestSample >= endOfInput)
+        break;
+
+      const float *phase =
+          phases.data() + (time % upsamplingFactor) * tapsPerPhase;
+      const int start = static_cast<int>(newestSample - numInputSamples);
+      for (int channel = 0; channel < history.getNumChannels(); channel++) {
+        output[channel][numWritten] = dotProduct(
+            phase, history.getReadPointer(channel, start), tapsPerPhase);
+      }
+
+      numWritten++;
+      numOutputSamples++;
+    }
+
+    for (int channel = 0; channel < history.getNumChannels(); channel++) {
+      float *samples = history.getWritePointer(channel);
+      std::memmove(samples, samples + numSamples,
+                   historyLength * sizeof(float));
+    }
+    numInputSamples = endOfInput;
+    return numWritten;
+  }
+
+private:
+  static float dotProduct(const float *a, const float *b, int n) noexcept {
+    // Accumulate in several independent lanes so that this vectorizes.
+    float lanes[8] = {};
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+      for (int lane = 0; lane < 8; lane++)
+        lanes[lane] += a[i + lane] * b[i + lane];
+    }
+
+    float sum = 0;
+    for (; i < n; i++)
+      sum += a[i] * b[i];
+    for (float lane : lanes)
+      sum += lane;
+    return sum;
+  }
+
+  void designFilter() {
+    const int length = tapsPerPhase * upsamplingFactor;
+    const double cutoff = passbandFraction * 0.5 /
+                          std::max(upsamplingFactor, downsamplingFactor);
+
+    std::vector<float> window(length);
+    juce::dsp::WindowingFunction<float>::fillWindowingTables(
+        window.data(), length, juce::dsp::WindowingFunction<float>::kaiser,
+        false, kaiserBeta);
+
+    std::vector<double> prototype(length);
+    double sum = 0;
+    for (int i = 0; i < length; i++) {
+      const double x = 2.0 * cutoff * (i - (length - 1) / 2.0);
+      const double sinc =
+          x == 0 ? 1.0
+                 : std::sin(juce::MathConstants<double>::pi * x) /
+                       (juce::MathConstants<double>::pi * x);
+      prototype[i] = sinc * window[i];
+      sum += prototype[i];
+    }
+
+    // Each phase should have a gain of 1 at DC; as only one in every L
+    // samples of the (zero-stuffed) upsampled signal is non-zero, the
+    // prototype needs a gain of L.
+    phases.resize(length);
+    for (int phase = 0; phase < upsamplingFactor; phase++) {
+      for (int i = 0; i < tapsPerPhase; i++) {
+        phases[phase * tapsPerPhase + i] = static_cast<float>(
+            prototype[phase + (tapsPerPhase - 1 - i) * upsamplingFactor] *
+            upsamplingFactor / sum);
+      }
+    }
+  }
+
+  int upsamplingFactor = 0, downsamplingFactor = 0;
+  int tapsPerPhase = 0, timeOffset = 0;
+
+  // The phases of the prototype filter, each reversed and stored one after
+  // another: phase p's taps are prototype[p + k * L], for k from
+  // tapsPerPhase - 1 down to 0.
+  std::vector<float> phases;
+
+  // The last (tapsPerPhase - 1) input samples, followed by the current block.
+  juce::AudioBuffer<float> history;
+  juce::int64 numInputSamples = 0, numOutputSamples = 0;
+};
+} // namespace Pedalboard
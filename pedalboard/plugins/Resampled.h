@@ -0,0 +1,323 @@
+/*
+ * pedalboard
+ * Copyright 2021 Spotify AB
+ *
+ * Licensed under the GNU Public License, Version 3.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../Plugin.h"
+#include "PolyphaseResampler.h"
+
+namespace Pedalboard {
+
+/**
+ * Runs a chain of other plugins at a different (usually lower) sample rate:
+ * audio is resampled to internalSampleRate with a PolyphaseResampler,
+ * processed, and then resampled back.
+ *
+ * The ratio between the two rates is approximated by a fraction L / M with
+ * neither term larger than maximumResamplingFactor; the wrapped plugins are
+ * prepared with the exact rate that results.
+ *
+ * The downsampler's time offset is chosen so that the total latency (of
+ * both resamplers, plus that of the wrapped plugins, scaled back to this
+ * plugin's sample rate) is a whole number of samples. As each block of
+ * input may produce one fewer block of output than it's long, one extra
+ * sample of latency is added by starting a small output FIFO with silence.
+ *
+ * This object holds references to the wrapped plugins' Python objects, so
+ * that they stay alive even if they're removed from the sequence (say, a
+ * Pedalboard) that they were passed in. Like any Python objects, these must
+ * only be touched with the GIL held, as they are when this object is
+ * constructed or destroyed.
+ */
+class Resampled : public Plugin {
+public:
+  static constexpr int maximumResamplingFactor = 1024;
+
+  Resampled(py::tuple pluginObjects, double internalSampleRate)
+      : pluginObjects(std::move(pluginObjects)),
+        plugins(getPluginPointers(this->pluginObjects)) {
+    setInternalSampleRate(internalSampleRate);
+  }
+  virtual ~Resampled(){};
+
+  void prepare(const juce::dsp::ProcessSpec &spec) override {
+    const auto [upsamplingFactor, downsamplingFactor] =
+        getRationalApproximation(internalSampleRate / spec.sampleRate,
+                                 maximumResamplingFactor);
+    bypassResampling = upsamplingFactor == downsamplingFactor;
+
+    juce::dsp::ProcessSpec internalSpec = spec;
+    if (!bypassResampling) {
+      internalSpec.sampleRate =
+          spec.sampleRate * upsamplingFactor / downsamplingFactor;
+      internalSpec.maximumBlockSize = static_cast<juce::uint32>(
+          (static_cast<juce::int64>(spec.maximumBlockSize) *
+               upsamplingFactor +
+           downsamplingFactor - 1) /
+              downsamplingFactor +
+          1);
+    }
+
+    int internalLatency = 0;
+    for (auto *plugin : plugins) {
+      if (plugin == nullptr)
+        continue;
+      plugin->prepare(internalSpec);
+      if (plugin->getLengthRatio() != 1.0) {
+        throw std::runtime_error(
+            "Plugins that change the length of their input can't be used "
+            "within Resampled.");
+      }
+      internalLatency += plugin->getLatencySamples();
+    }
+
+    if (bypassResampling) {
+      latency = internalLatency;
+      release();
+      return;
+    }
+
+    // The total latency, in units of 1 / upsamplingFactor samples:
+    const juce::int64 latencyNumerator =
+        (static_cast<juce::int64>(PolyphaseResampler::getTapsPerPhase(
+             upsamplingFactor, downsamplingFactor)) *
+             upsamplingFactor +
+         static_cast<juce::int64>(PolyphaseResampler::getTapsPerPhase(
+             downsamplingFactor, upsamplingFactor)) *
+             downsamplingFactor) /
+            2 -
+        1 + static_cast<juce::int64>(internalLatency) * downsamplingFactor;
+    const int timeOffset =
+        static_cast<int>(latencyNumerator % upsamplingFactor);
+    latency =
+        static_cast<int>(latencyNumerator / upsamplingFactor) + fifoPadding;
+
+    const int numChannels = static_cast<int>(spec.numChannels);
+    const int maximumBlockSize = static_cast<int>(spec.maximumBlockSize);
+    downsampler.prepare(numChannels, upsamplingFactor, downsamplingFactor,
+                        timeOffset, maximumBlockSize);
+    upsampler.prepare(numChannels, downsamplingFactor, upsamplingFactor, 0,
+                      static_cast<int>(internalSpec.maximumBlockSize));
+
+    internalBuffer.setSize(numChannels,
+                           static_cast<int>(internalSpec.maximumBlockSize));
+    // Each block may leave up to M / L + 2 samples behind in the FIFO:
+    outputFifo.setSize(
+        numChannels,
+        maximumBlockSize +
+            upsampler.getMaximumOutputBlockSize(
+                static_cast<int>(internalSpec.maximumBlockSize)) +
+            downsamplingFactor / upsamplingFactor + fifoPadding + 2);
+    resetFifo();
+  }
+
+  void process(
+      const juce::dsp::ProcessContextReplacing<float> &context) override {
+    if (bypassResampling) {
+      processChain(context);
+      return;
+    }
+
+    auto &block = context.getOutputBlock();
+    const int numChannels = static_cast<int>(block.getNumChannels());
+    const int numSamples = static_cast<int>(block.getNumSamples());
+
+    const int numInternalSamples = downsampler.process(
+        context.getInputBlock(), internalBuffer.getArrayOfWritePointers());
+    if (numInternalSamples > 0) {
+      juce::dsp::AudioBlock<float> internalBlock(
+          internalBuffer.getArrayOfWritePointers(), numChannels,
+          numInternalSamples);
+      processChain(juce::dsp::ProcessContextReplacing<float>(internalBlock));
+
+      jassert(numChannels <= 2);
+      float *fifoPointers[2];
+      for (int channel = 0; channel < numChannels; channel++) {
+        fifoPointers[channel] =
+            outputFifo.getWritePointer(channel, fifoLength);
+      }
+      fifoLength += upsampler.process(internalBlock, fifoPointers);
+    }
+
+    jassert(fifoLength >= numSamples);
+    const int numToCopy = std::min(numSamples, fifoLength);
+    for (int channel = 0; channel < numChannels; channel++) {
+      float *fifo = outputFifo.getWritePointer(channel);
+      float *output = block.getChannelPointer(channel);
+      juce::FloatVectorOperations::copy(output, fifo, numToCopy);
+      juce::FloatVectorOperations::clear(output + numToCopy,
+                                         numSamples - numToCopy);
+      std::memmove(fifo, fifo + numToCopy,
+                   (fifoLength - numToCopy) * sizeof(float));
+    }
+    fifoLength -= numToCopy;
+  }
+
+  void reset() override {
+    for (auto *plugin : plugins) {
+      if (plugin != nullptr)
+        plugin->reset();
+    }
+    downsampler.reset();
+    upsampler.reset();
+    resetFifo();
+  }
+
+  // Free the resampling buffers until next prepared. (The wrapped plugins
+  // are released by the caller, which must lock them too.)
+  void release() override {
+    downsampler.release();
+    upsampler.release();
+    internalBuffer = juce::AudioBuffer<float>();
+    outputFifo = juce::AudioBuffer<float>();
+    fifoLength = 0;
+  }
+
+  bool processesWholeBuffer() const override {
+    for (auto *plugin : plugins) {
+      if (plugin != nullptr && plugin->processesWholeBuffer())
+        return true;
+    }
+    return false;
+  }
+
+  int getLatencySamples() const override { return latency; }
+
+  void appendNestedPlugins(std::vector<Plugin *> &nested) const override {
+    for (auto *plugin : plugins) {
+      if (plugin == nullptr)
+        continue;
+      nested.push_back(plugin);
+      plugin->appendNestedPlugins(nested);
+    }
+  }
+
+  const py::tuple &getPluginObjects() const { return pluginObjects; }
+
+  double getInternalSampleRate() const { return internalSampleRate; }
+  void setInternalSampleRate(double newInternalSampleRate) {
+    if (!(newInternalSampleRate > 0)) {
+      throw std::range_error("Internal sample rate must be greater than 0.");
+    }
+    internalSampleRate = newInternalSampleRate;
+  }
+
+private:
+  static constexpr int fifoPadding = 1;
+
+  // Nones are allowed (and skipped), as they are in a Pedalboard.
+  static std::vector<Plugin *>
+  getPluginPointers(const py::tuple &pluginObjects) {
+    std::vector<Plugin *> pointers;
+    for (auto object : pluginObjects) {
+      if (object.is_none()) {
+        pointers.push_back(nullptr);
+      } else if (py::isinstance<Plugin>(object)) {
+        pointers.push_back(object.cast<Plugin *>());
+      } else {
+        throw py::type_error("Resampled expects a plugin, or a list of "
+                             "plugins, but was passed " +
+                             py::repr(object).cast<std::string>() + ".");
+      }
+    }
+    return pointers;
+  }
+
+  void processChain(const juce::dsp::ProcessContextReplacing<float> &context) {
+    for (auto *plugin : plugins) {
+      if (plugin != nullptr)
+        plugin->process(context);
+    }
+  }
+
+  void resetFifo() {
+    outputFifo.clear();
+    fifoLength = std::min(fifoPadding, outputFifo.getNumSamples());
+  }
+
+  const py::tuple pluginObjects;
+  const std::vector<Plugin *> plugins;
+  std::atomic<double> internalSampleRate;
+
+  bool bypassResampling = true;
+  int latency = 0;
+
+  PolyphaseResampler downsampler, upsampler;
+  juce::AudioBuffer<float> internalBuffer;
+
+  // Resampled output that's waiting to be returned, starting with
+  // fifoPadding samples of silence.
+  juce::AudioBuffer<float> outputFifo;
+  int fifoLength = 0;
+};
+
+inline void init_resampled(py::module &m) {
+  py::class_<Resampled, Plugin>(
+      m, "Resampled",
+      "Runs a plugin, a list of plugins or a Pedalboard at a different "
+      "sample rate, by resampling its input to internal_sample_rate with a "
+      "polyphase filter, processing it, and then resampling it back. "
+      "Processing at a lower sample rate can save a lot of work for plugins "
+      "that only affect low frequencies; any content above half of the "
+      "lower of the two sample rates is removed."
+      "\n\n"
+      "The latency added by resampling is reported, so the output lines up "
+      "with the input. The list of plugins is copied, so changing it later "
+      "has no effect. The plugins can still be used on their own, but "
+      "can't be used elsewhere in the same chain of plugins as this "
+      "Resampled.")
+      .def(py::init([](py::object plugins, double internalSampleRate) {
+             // A single plugin is run as if in a list of its own. Anything
+             // else is copied, so later changes to it have no effect here.
+             py::tuple pluginObjects = py::isinstance<Plugin>(plugins)
+                                           ? py::make_tuple(plugins)
+                                           : py::tuple(plugins);
+             return std::make_unique<Resampled>(std::move(pluginObjects),
+                                                internalSampleRate);
+           }),
+           py::arg("plugins"), py::arg("internal_sample_rate"))
+      .def("__repr__",
+           [](const Resampled &plugin) {
+             std::ostringstream ss;
+             ss << "<pedalboard.Resampled";
+             py::list wrapped(plugin.getPluginObjects());
+             ss << " plugins=" << py::repr(wrapped).cast<std::string>();
+             ss << " internal_sample_rate="
+                << plugin.getInternalSampleRate();
+             ss << " at " << &plugin;
+             ss << ">";
+             return ss.str();
+           })
+      .def_property_readonly(
+          "plugins",
+          [](const Resampled &plugin) {
+            return py::list(plugin.getPluginObjects());
+          },
+          "The plugins that are run at the internal sample rate.")
+      .def_property("internal_sample_rate",
+                    &Resampled::getInternalSampleRate,
+                    &Resampled::setInternalSampleRate);
+}
+}; // namespace Pedalboard
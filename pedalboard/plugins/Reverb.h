@@ -23,55 +23,101 @@ namespace py = pybind11;
 #include "../JucePlugin.h"
 
 namespace Pedalboard {
-class Reverb : public JucePlugin<juce::dsp::Reverb> {
+
+/**
+ * A wrapper around juce::dsp::Reverb that only allocates the reverb's
+ * comb and allpass filter buffers when first prepared, and frees them
+ * again when released. (juce::Reverb allocates these buffers in its
+ * constructor, which adds up when many Reverb plugins are kept around.)
+ */
+class ReleasableReverb {
+public:
+  const juce::Reverb::Parameters &getParameters() const { return parameters; }
+
+  void setParameters(const juce::Reverb::Parameters &newParameters) {
+    parameters = newParameters;
+    if (reverb)
+      reverb->setParameters(parameters);
+  }
+
+  void prepare(const juce::dsp::ProcessSpec &spec) {
+    if (!reverb) {
+      reverb = std::make_unique<juce::dsp::Reverb>();
+      reverb->setParameters(parameters);
+    }
+    reverb->prepare(spec);
+  }
+
+  void reset() noexcept {
+    if (reverb)
+      reverb->reset();
+  }
+
+  template <typename ProcessContext>
+  void process(const ProcessContext &context) noexcept {
+    reverb->process(context);
+  }
+
+  void release() { reverb.reset(); }
+
+private:
+  juce::Reverb::Parameters parameters;
+  std::unique_ptr<juce::dsp::Reverb> reverb;
+};
+
+class Reverb : public JucePlugin<ReleasableReverb> {
 public:
-  float getRoomSize() { return this->getDSP().getParameters().roomSize; }
-  float getDamping() { return this->getDSP().getParameters().damping; }
-  float getWetLevel() { return this->getDSP().getParameters().wetLevel; }
-  float getDryLevel() { return this->getDSP().getParameters().dryLevel; }
-  float getWidth() { return this->getDSP().getParameters().width; }
-  float getFreezeMode() { return this->getDSP().getParameters().freezeMode; }
+  float getRoomSize() { return getParameters().roomSize; }
+  float getDamping() { return getParameters().damping; }
+  float getWetLevel() { return getParameters().wetLevel; }
+  float getDryLevel() { return getParameters().dryLevel; }
+  float getWidth() { return getParameters().width; }
+  float getFreezeMode() { return getParameters().freezeMode; }
 
   void setRoomSize(float value) {
     if (value < 0.0 || value > 1.0)
       throw std::range_error("Room Size value must be between 0.0 and 1.0.");
-    auto parameters = this->getDSP().getParameters();
-    parameters.roomSize = value;
-    this->getDSP().setParameters(parameters);
+    updateParameters([=](auto &parameters) { parameters.roomSize = value; });
   }
   void setDamping(float value) {
     if (value < 0.0 || value > 1.0)
       throw std::range_error("Damping value must be between 0.0 and 1.0.");
-    auto parameters = this->getDSP().getParameters();
-    parameters.damping = value;
-    this->getDSP().setParameters(parameters);
+    updateParameters([=](auto &parameters) { parameters.damping = value; });
   }
   void setWetLevel(float value) {
     if (value < 0.0 || value > 1.0)
       throw std::range_error("Wet Level must be between 0.0 and 1.0.");
-    auto parameters = this->getDSP().getParameters();
-    parameters.wetLevel = value;
-    this->getDSP().setParameters(parameters);
+    updateParameters([=](auto &parameters) { parameters.wetLevel = value; });
   }
   void setDryLevel(float value) {
     if (value < 0.0 || value > 1.0)
       throw std::range_error("Dry Level must be between 0.0 and 1.0.");
-    auto parameters = this->getDSP().getParameters();
-    parameters.dryLevel = value;
-    this->getDSP().setParameters(parameters);
+    updateParameters([=](auto &parameters) { parameters.dryLevel = value; });
   }
   void setWidth(float value) {
     if (value < 0.0 || value > 1.0)
       throw std::range_error("Width value must be between 0.0 and 1.0.");
-    auto parameters = this->getDSP().getParameters();
-    parameters.width = value;
-    this->getDSP().setParameters(parameters);
+    updateParameters([=](auto &parameters) { parameters.width = value; });
   }
   void setFreezeMode(float value) {
     if (value < 0.0 || value > 1.0)
       throw std::range_error("Freeze Mode value must be between 0.0 and 1.0.");
+    updateParameters([=](auto &parameters) { parameters.freezeMode = value; });
+  }
+
+private:
+  // Reverb parameters are stored together in a non-atomic struct, so
+  // all reads and writes go through the plugin's mutex, as parameters may be
+  // accessed from any thread while audio is being processed.
+  juce::Reverb::Parameters getParameters() {
+    ScopedGILReleasingLock lock(this->mutex);
+    return this->getDSP().getParameters();
+  }
+
+  template <typename Function> void updateParameters(Function update) {
+    ScopedGILReleasingLock lock(this->mutex);
     auto parameters = this->getDSP().getParameters();
-    parameters.freezeMode = value;
+    update(parameters);
     this->getDSP().setParameters(parameters);
   }
 };
@@ -0,0 +1,160 @@
+/*
+ * pedalboard
+ * Copyright 2021 Spotify AB
+ *
+ * Licensed under the GNU Public License, Version 3.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    https://www.gnu.org/licenses/gpl-3.0.html
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+
+#include <atomic>
+
+#include "../Plugin.h"
+#include "PhaseVocoder.h"
+
+namespace Pedalboard {
+
+/**
+ * Changes the duration of audio without changing its pitch, by streaming it
+ * through a PhaseVocoder. For every sample of input, (1 / rate) samples of
+ * output are produced; the output is delayed (and this delay reported as the
+ * plugin's latency) so that the vocoder always has enough input to produce
+ * them.
+ */
+class TimeStretch : public Plugin {
+public:
+  virtual ~TimeStretch(){};
+
+  void prepare(const juce::dsp::ProcessSpec &spec) override {
+    const double currentRate = rate;
+    vocoder.prepare(spec.numChannels, spec.maximumBlockSize, currentRate);
+
+    // After n samples of input, up to (n / rate + 0.5) samples of output are
+    // requested, but the vocoder can only resynthesise a frame once it's
+    // seen the half frame of input after its centre. Delaying the output by
+    // this much (plus some rounding) keeps it from running out:
+    constexpr int halfFrame = PhaseVocoder::fftSize / 2;
+    latency = halfFrame + 1 +
+              static_cast<int>(std::ceil((halfFrame + 1) / currentRate));
+    reset();
+  }
+
+  void process(
+      const juce::dsp::ProcessContextReplacing<float> &context) override {
+    // Only called when the rate is 1.0, unless wrapped by another plugin
+    // that expects its output to be as long as its input.
+    if (getLengthRatio() != 1.0) {
+      throw std::runtime_error(
+          "TimeStretch changes the length of its input, so can't be used "
+          "within another plugin unless its rate is 1.0.");
+    }
+
+    auto outputBlock = context.getOutputBlock();
+    processWithLengthChange(context.getInputBlock(), outputBlock);
+  }
+
+  void
+  processWithLengthChange(const juce::dsp::AudioBlock<const float> &input,
+                          juce::dsp::AudioBlock<float> &output) override {
+    vocoder.push(input);
+
+    // Output starts with silence (the latency), followed by whatever the
+    // vocoder has ready. Anything not ready in time is also left silent,
+    // although the latency should prevent that from happening.
+    const juce::int64 ready = vocoder.getNumOutputSamplesReady();
+    const int numSamples = static_cast<int>(output.getNumSamples());
+    const int numSilent = static_cast<int>(
+        juce::jlimit<juce::int64>(0, numSamples, -position));
+    const int numReady = static_cast<int>(juce::jlimit<juce::int64>(
+        0, numSamples - numSilent, ready - (position + numSilent)));
+    jassert(numSilent + numReady == numSamples);
+
+    for (size_t channel = 0; channel < output.getNumChannels(); channel++) {
+      float *channelOutput = output.getChannelPointer(channel);
+      juce::FloatVectorOperations::clear(channelOutput, numSilent);
+      if (numReady > 0) {
+        juce::FloatVectorOperations::copy(
+            channelOutput + numSilent,
+            vocoder.getOutput(static_cast<int>(channel), position + numSilent),
+            numReady);
+      }
+      juce::FloatVectorOperations::clear(channelOutput + numSilent + numReady,
+                                         numSamples - numSilent - numReady);
+    }
+
+    position += numSamples;
+    vocoder.discardOutputBefore(position);
+  }
+
+  void reset() override {
+    vocoder.reset();
+    position = PhaseVocoder::outputOffset - latency;
+  }
+
+  void release() override { vocoder.release(); }
+
+  int getLatencySamples() const override { return latency; }
+
+  double getLengthRatio() const override { return 1.0 / rate; }
+
+  float getRate() const { return rate; }
+  void setRate(float newRate) {
+    if (!(newRate >= 0.1 && newRate <= 10.0)) {
+      throw std::range_error("Rate must be between 0.1 and 10.0.");
+    }
+    ScopedGILReleasingLock lock(mutex);
+    rate = newRate;
+  }
+
+private:
+  std::atomic<float> rate{1.0f};
+
+  PhaseVocoder vocoder;
+  int latency = 0;
+
+  // The position in the vocoder's output of the next sample to be output.
+  // Negative until the latency has passed.
+  juce::int64 position = 0;
+};
+
+inline void init_timestretch(py::module &m) {
+  py::class_<TimeStretch, Plugin>(
+      m, "TimeStretch",
+      "Changes the speed of audio without changing its pitch, using a phase "
+      "vocoder with identity phase locking. A rate above 1.0 speeds audio up "
+      "(producing less output than input), while a rate below 1.0 slows it "
+      "down. Audio is streamed through the vocoder one block at a time, and "
+      "the output is aligned to the start of the input.\n\n"
+      "As its output is a different length than its input, TimeStretch "
+      "can't be wrapped by other plugins (like Mix) unless its rate is 1.0.")
+      .def(py::init([](float rate) {
+             auto plugin = std::make_unique<TimeStretch>();
+             plugin->setRate(rate);
+             return plugin;
+           }),
+           py::arg("rate") = 1.0)
+      .def("__repr__",
+           [](const TimeStretch &plugin) {
+             std::ostringstream ss;
+             ss << "<pedalboard.TimeStretch";
+             ss << " rate=" << plugin.getRate();
+             ss << " at " << &plugin;
+             ss << ">";
+             return ss.str();
+           })
+      .def_property("rate", &TimeStretch::getRate, &TimeStretch::setRate);
+}
+}; // namespace Pedalboard
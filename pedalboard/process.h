@@ -21,16 +21,307 @@
 #include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 
+#include "AllocationTracking.h"
 #include "Plugin.h"
 
 namespace py = pybind11;
 
 namespace Pedalboard {
+static constexpr int DEFAULT_BUFFER_SIZE = 8192;
+
 enum class ChannelLayout {
   Interleaved,
   NotInterleaved,
 };
 
+/**
+ * Scratch space used by process() that would otherwise be allocated on every
+ * call. Each thread gets its own instance, which only ever grows, so repeated
+ * calls to process() reuse the same memory rather than allocating.
+ */
+struct ProcessScratchSpace {
+  std::vector<Plugin *> uniquePluginsSortedByPointer;
+  std::vector<float *> ioBufferChannelPointers;
+
+  // Used by processInStages: one buffer per stage (of which there may be
+  // more than the current chain needs), and how many samples have been
+  // passed to each plugin that changes the length of its input.
+  std::vector<juce::AudioBuffer<float>> stageBuffers;
+  std::vector<juce::int64> numSamplesPassedToStage;
+};
+
+inline ProcessScratchSpace &getProcessScratchSpace() {
+  static thread_local ProcessScratchSpace scratchSpace;
+  return scratchSpace;
+}
+
+/**
+ * Locks the mutex of each plugin in the provided list (in order) and unlocks
+ * them (in reverse order) on destruction. The list must already be sorted
+ * to avoid deadlocks, and must outlive this object.
+ */
+class ScopedPluginLocks {
+public:
+  explicit ScopedPluginLocks(const std::vector<Plugin *> &pluginsToLock)
+      : plugins(pluginsToLock) {
+    try {
+      for (auto *plugin : plugins) {
+        plugin->mutex.lock();
+        numLocked++;
+      }
+    } catch (...) {
+      unlockAll();
+      throw;
+    }
+  }
+
+  ~ScopedPluginLocks() { unlockAll(); }
+
+  ScopedPluginLocks(const ScopedPluginLocks &) = delete;
+  ScopedPluginLocks &operator=(const ScopedPluginLocks &) = delete;
+
+private:
+  void unlockAll() noexcept {
+    while (numLocked > 0) {
+      numLocked--;
+      plugins[numLocked]->mutex.unlock();
+    }
+  }
+
+  const std::vector<Plugin *> &plugins;
+  size_t numLocked = 0;
+};
+
+/**
+ * Throws if any heap allocations were made within the given guard's scope.
+ * Only has an effect in builds with allocation tracking enabled.
+ */
+inline void throwIfAllocated(const ScopedAllocationGuard &allocationGuard) {
+  if (PEDALBOARD_TRACK_ALLOCATIONS && allocationGuard.getNumAllocations() > 0) {
+    throw std::runtime_error(
+        "Plugin::process performed " +
+        std::to_string(allocationGuard.getNumAllocations()) +
+        " heap allocation(s) while processing a block of audio.");
+  }
+}
+
+/**
+ * Copies samples [start, end) of each channel of the input array into the
+ * provided channel pointers.
+ */
+inline void copyInputSamples(const py::buffer_info &inputInfo,
+                             ChannelLayout inputChannelLayout,
+                             unsigned int numChannels, unsigned int numSamples,
+                             unsigned int start, unsigned int end,
+                             float *const *destination) {
+  // Depending on the input channel layout, we need to copy data
+  // differently. This loop is duplicated here to move the if statement
+  // outside of the tight loop, as we don't need to re-check that the input
+  // channel is still the same on every iteration of the loop.
+  switch (inputChannelLayout) {
+  case ChannelLayout::Interleaved:
+    for (unsigned int i = 0; i < numChannels; i++) {
+      // We're de-interleaving the data here, so we can't use std::copy.
+      for (unsigned int j = start; j < end; j++) {
+        destination[i][j - start] =
+            static_cast<float *>(inputInfo.ptr)[j * numChannels + i];
+      }
+    }
+    break;
+  case ChannelLayout::NotInterleaved:
+    for (unsigned int i = 0; i < numChannels; i++) {
+      const float *channelBuffer =
+          static_cast<float *>(inputInfo.ptr) + (i * numSamples);
+      std::copy(channelBuffer + start, channelBuffer + end, destination[i]);
+    }
+  }
+}
+
+/**
+ * Returns the most samples that a plugin with the given length ratio can
+ * output for a block of the given size. (As the number of samples requested
+ * is rounded, it may be one more than expected.)
+ */
+inline unsigned int getLengthChangedBlockSize(unsigned int blockSize,
+                                              double lengthRatio) {
+  return static_cast<unsigned int>(std::ceil(blockSize * lengthRatio)) + 1;
+}
+
+/**
+ * Runs audio through a chain of plugins one block at a time, in place in the
+ * output channels.
+ */
+inline void
+processInPlace(const py::buffer_info &inputInfo,
+               ChannelLayout inputChannelLayout, unsigned int numChannels,
+               unsigned int numSamples, unsigned int bufferSize,
+               const std::vector<Plugin *> &plugins,
+               const std::vector<float *> &ioBufferChannelPointers) {
+  for (unsigned int blockStart = 0; blockStart < numSamples;
+       blockStart += bufferSize) {
+    unsigned int blockEnd = std::min(blockStart + bufferSize,
+                                     static_cast<unsigned int>(numSamples));
+    unsigned int blockSize = blockEnd - blockStart;
+
+    // Copy the input audio into the ioBuffer, which will be used for
+    // processing and will be returned. (At most two channels are supported.)
+    float *blockChannelPointers[2];
+    for (unsigned int i = 0; i < numChannels; i++)
+      blockChannelPointers[i] = ioBufferChannelPointers[i] + blockStart;
+    copyInputSamples(inputInfo, inputChannelLayout, numChannels, numSamples,
+                     blockStart, blockEnd, blockChannelPointers);
+
+    auto ioBlock = juce::dsp::AudioBlock<float>(
+        ioBufferChannelPointers.data(), numChannels, blockStart, blockSize);
+    juce::dsp::ProcessContextReplacing<float> context(ioBlock);
+
+    // Now all of the pointers in context are pointing to valid input data,
+    // so let's run the plugins. None of them should allocate here; in
+    // builds with allocation tracking enabled, we check that they don't.
+    for (auto *plugin : plugins) {
+      if (plugin == nullptr)
+        continue;
+
+      ScopedAllocationGuard allocationGuard;
+      plugin->process(context);
+      throwIfAllocated(allocationGuard);
+    }
+  }
+}
+
+/**
+ * Runs audio through a chain of plugins that changes its length (i.e.: that
+ * contains a TimeStretch) or that has latency to remove, writing exactly
+ * numOutputSamples samples to the output channels. Each plugin that changes
+ * the length of its input starts a new stage of the chain, which is
+ * processed in its own buffer.
+ *
+ * Once the input runs out, silence is passed through the chain until enough
+ * output has been produced. The first (latency) samples of output are
+ * dropped, so that the output lines up with the input.
+ */
+inline void processInStages(const py::buffer_info &inputInfo,
+                            ChannelLayout inputChannelLayout,
+                            unsigned int numChannels, unsigned int numSamples,
+                            unsigned int bufferSize,
+                            const std::vector<Plugin *> &plugins,
+                            juce::int64 latency,
+                            const std::vector<float *> &outputChannels,
+                            unsigned int numOutputSamples,
+                            ProcessScratchSpace &scratchSpace) {
+  size_t numStages = 1;
+  for (auto *plugin : plugins) {
+    if (plugin != nullptr && plugin->getLengthRatio() != 1.0)
+      numStages++;
+  }
+
+  // Stage buffers are only resized (without reallocating, unless they need
+  // to grow) so that repeated calls reuse the same memory.
+  std::vector<juce::AudioBuffer<float>> &stageBuffers =
+      scratchSpace.stageBuffers;
+  if (stageBuffers.size() < numStages)
+    stageBuffers.resize(numStages);
+  stageBuffers[0].setSize(numChannels, bufferSize, false, false, true);
+
+  double totalLengthRatio = 1.0;
+  size_t numStagesSized = 1;
+  for (auto *plugin : plugins) {
+    if (plugin == nullptr || plugin->getLengthRatio() == 1.0)
+      continue;
+
+    const double lengthRatio = plugin->getLengthRatio();
+    stageBuffers[numStagesSized].setSize(
+        numChannels,
+        getLengthChangedBlockSize(
+            stageBuffers[numStagesSized - 1].getNumSamples(), lengthRatio),
+        false, false, true);
+    numStagesSized++;
+    totalLengthRatio *= lengthRatio;
+  }
+
+  std::vector<juce::int64> &numSamplesPassedToStage =
+      scratchSpace.numSamplesPassedToStage;
+  numSamplesPassedToStage.assign(numStages - 1, 0);
+
+  unsigned int inputPosition = 0;
+  unsigned int outputPosition = 0;
+  juce::int64 numSamplesToSkip = latency;
+
+  while (outputPosition < numOutputSamples) {
+    juce::AudioBuffer<float> &inputBuffer = stageBuffers.front();
+    unsigned int blockSize = 0;
+    if (inputPosition < numSamples) {
+      blockSize = std::min(bufferSize, numSamples - inputPosition);
+      copyInputSamples(inputInfo, inputChannelLayout, numChannels, numSamples,
+                       inputPosition, inputPosition + blockSize,
+                       inputBuffer.getArrayOfWritePointers());
+      inputPosition += blockSize;
+    } else {
+      // Pass no more silence than is needed to produce the remaining output:
+      const double numSamplesNeeded =
+          (numOutputSamples - outputPosition) + numSamplesToSkip;
+      blockSize = static_cast<unsigned int>(juce::jlimit(
+          1.0, static_cast<double>(bufferSize),
+          std::ceil(numSamplesNeeded / totalLengthRatio)));
+      inputBuffer.clear(0, blockSize);
+    }
+
+    size_t stage = 0;
+    size_t numSamplesInBlock = blockSize;
+    for (auto *plugin : plugins) {
+      if (plugin == nullptr)
+        continue;
+
+      // Plugins that shorten their input may not produce any output yet.
+      if (numSamplesInBlock == 0)
+        break;
+
+      auto block = juce::dsp::AudioBlock<float>(stageBuffers[stage])
+                       .getSubBlock(0, numSamplesInBlock);
+      const double lengthRatio = plugin->getLengthRatio();
+
+      ScopedAllocationGuard allocationGuard;
+      if (lengthRatio == 1.0) {
+        juce::dsp::ProcessContextReplacing<float> context(block);
+        plugin->process(context);
+      } else {
+        juce::int64 &numSamplesPassed = numSamplesPassedToStage[stage];
+        const juce::int64 numOutputBefore =
+            std::llround(numSamplesPassed * lengthRatio);
+        numSamplesPassed += numSamplesInBlock;
+        numSamplesInBlock = static_cast<size_t>(
+            std::llround(numSamplesPassed * lengthRatio) - numOutputBefore);
+
+        stage++;
+        auto outputBlock = juce::dsp::AudioBlock<float>(stageBuffers[stage])
+                               .getSubBlock(0, numSamplesInBlock);
+        plugin->processWithLengthChange(block, outputBlock);
+      }
+      throwIfAllocated(allocationGuard);
+    }
+
+    if (stage != numStages - 1)
+      continue;
+
+    const unsigned int numSkipped = static_cast<unsigned int>(
+        std::min<juce::int64>(numSamplesToSkip, numSamplesInBlock));
+    numSamplesToSkip -= numSkipped;
+    const unsigned int numToCopy =
+        std::min(static_cast<unsigned int>(numSamplesInBlock) - numSkipped,
+                 numOutputSamples - outputPosition);
+    if (numToCopy == 0)
+      continue;
+
+    for (unsigned int i = 0; i < numChannels; i++) {
+      const float *stageOutput =
+          stageBuffers[numStages - 1].getReadPointer(i, numSkipped);
+      std::copy(stageOutput, stageOutput + numToCopy,
+                outputChannels[i] + outputPosition);
+    }
+    outputPosition += numToCopy;
+  }
+}
+
 /**
  * Non-float32 overload.
  */
@@ -100,58 +391,74 @@ process<float>(const py::array_t<float, py::array::c_style> inputArray,
     throw std::runtime_error("More than two channels received!");
   }
 
+  // Some plugins need to see all of their input at once; if any are present,
+  // process everything as a single block.
+  for (auto *plugin : plugins) {
+    if (plugin != nullptr && plugin->processesWholeBuffer()) {
+      bufferSize = numSamples;
+      break;
+    }
+  }
+
   // Cap the buffer size in use to the size of the input data:
   bufferSize = std::min(bufferSize, numSamples);
 
+  // Some plugins (like TimeStretch) change the length of their input. (If
+  // their parameters are changed before they're locked below, their output
+  // is padded or truncated to this length.)
+  unsigned int numOutputSamples = numSamples;
+  for (auto *plugin : plugins) {
+    if (plugin != nullptr) {
+      numOutputSamples = static_cast<unsigned int>(
+          std::llround(numOutputSamples * plugin->getLengthRatio()));
+    }
+  }
+
   // JUCE uses separate channel buffers, so the output shape is (num_channels,
   // num_samples)
   py::array_t<float> outputArray =
-      inputInfo.ndim == 2 ? py::array_t<float>({numChannels, numSamples})
-                          : py::array_t<float>(numSamples);
+      inputInfo.ndim == 2
+          ? py::array_t<float>({numChannels, numOutputSamples})
+          : py::array_t<float>(numOutputSamples);
   py::buffer_info outputInfo = outputArray.request();
 
   {
     py::gil_scoped_release release;
 
-    unsigned int countOfPluginsIgnoringNull = 0;
-    for (auto *plugin : plugins) {
-      if (plugin == nullptr)
-        continue;
-      countOfPluginsIgnoringNull++;
-    }
+    ProcessScratchSpace &scratchSpace = getProcessScratchSpace();
 
     // We'd pass multiple arguments to scoped_lock here, but we don't know how
     // many plugins have been passed at compile time - so instead, we do our own
     // deadlock-avoiding multiple-lock algorithm here. By locking each plugin
     // only in order of its pointers, we're guaranteed to avoid deadlocks with
     // other threads that may be running this same code on the same plugins.
-    std::vector<Plugin *> uniquePluginsSortedByPointer;
+    // Plugins nested within others (i.e.: by Mix) are locked too, as they're
+    // called into by their containers.
+    std::vector<Plugin *> &uniquePluginsSortedByPointer =
+        scratchSpace.uniquePluginsSortedByPointer;
+    uniquePluginsSortedByPointer.clear();
     for (auto *plugin : plugins) {
       if (plugin == nullptr)
         continue;
 
-      if (std::find(uniquePluginsSortedByPointer.begin(),
-                    uniquePluginsSortedByPointer.end(),
-                    plugin) == uniquePluginsSortedByPointer.end())
-        uniquePluginsSortedByPointer.push_back(plugin);
-    }
-
-    if (uniquePluginsSortedByPointer.size() < countOfPluginsIgnoringNull) {
-      throw std::runtime_error(
-          "The same plugin instance is being used multiple times in the same "
-          "chain of plugins, which would cause undefined results.");
+      uniquePluginsSortedByPointer.push_back(plugin);
+      plugin->appendNestedPlugins(uniquePluginsSortedByPointer);
     }
 
     std::sort(uniquePluginsSortedByPointer.begin(),
               uniquePluginsSortedByPointer.end(),
               [](const Plugin *lhs, const Plugin *rhs) { return lhs < rhs; });
 
-    std::vector<std::unique_ptr<std::scoped_lock<std::mutex>>> pluginLocks;
-    for (auto *plugin : uniquePluginsSortedByPointer) {
-      pluginLocks.push_back(
-          std::make_unique<std::scoped_lock<std::mutex>>(plugin->mutex));
+    if (std::adjacent_find(uniquePluginsSortedByPointer.begin(),
+                           uniquePluginsSortedByPointer.end()) !=
+        uniquePluginsSortedByPointer.end()) {
+      throw std::runtime_error(
+          "The same plugin instance is being used multiple times in the same "
+          "chain of plugins, which would cause undefined results.");
     }
 
+    ScopedPluginLocks pluginLocks(uniquePluginsSortedByPointer);
+
     for (auto *plugin : plugins) {
       if (plugin == nullptr)
         continue;
@@ -163,64 +470,42 @@ process<float>(const py::array_t<float, py::array::c_style> inputArray,
     spec.maximumBlockSize = static_cast<juce::uint32>(bufferSize);
     spec.numChannels = static_cast<juce::uint32>(numChannels);
 
+    // Plugins after one that changes the length of its input may be passed
+    // more samples at once than bufferSize. The latency of the whole chain
+    // is counted in output samples.
+    bool changesLength = false;
+    double latency = 0;
     for (auto *plugin : plugins) {
       if (plugin == nullptr)
         continue;
       plugin->prepare(spec);
+
+      const double lengthRatio = plugin->getLengthRatio();
+      if (lengthRatio != 1.0) {
+        changesLength = true;
+        spec.maximumBlockSize =
+            getLengthChangedBlockSize(spec.maximumBlockSize, lengthRatio);
+      }
+      latency = latency * lengthRatio + plugin->getLatencySamples();
     }
 
     // Manually construct channel pointers to pass to AudioBuffer.
-    std::vector<float *> ioBufferChannelPointers(numChannels);
+    std::vector<float *> &ioBufferChannelPointers =
+        scratchSpace.ioBufferChannelPointers;
+    ioBufferChannelPointers.resize(numChannels);
     for (unsigned int i = 0; i < numChannels; i++) {
-      ioBufferChannelPointers[i] = ((float *)outputInfo.ptr) + (i * numSamples);
-    }
-
-    juce::AudioBuffer<float> ioBuffer(ioBufferChannelPointers.data(),
-                                      numChannels, numSamples);
-
-    for (unsigned int blockStart = 0; blockStart < numSamples;
-         blockStart += bufferSize) {
-      unsigned int blockEnd = std::min(blockStart + bufferSize,
-                                       static_cast<unsigned int>(numSamples));
-      unsigned int blockSize = blockEnd - blockStart;
-
-      // Copy the input audio into the ioBuffer, which will be used for
-      // processing and will be returned.
-
-      // Depending on the input channel layout, we need to copy data
-      // differently. This loop is duplicated here to move the if statement
-      // outside of the tight loop, as we don't need to re-check that the input
-      // channel is still the same on every iteration of the loop.
-      switch (inputChannelLayout) {
-      case ChannelLayout::Interleaved:
-        for (unsigned int i = 0; i < numChannels; i++) {
-          // We're de-interleaving the data here, so we can't use std::copy.
-          for (unsigned int j = blockStart; j < blockEnd; j++) {
-            ioBufferChannelPointers[i][j] =
-                static_cast<float *>(inputInfo.ptr)[j * numChannels + i];
-          }
-        }
-        break;
-      case ChannelLayout::NotInterleaved:
-        for (unsigned int i = 0; i < numChannels; i++) {
-          const float *channelBuffer =
-              static_cast<float *>(inputInfo.ptr) + (i * numSamples);
-          std::copy(channelBuffer + blockStart, channelBuffer + blockEnd,
-                    ioBufferChannelPointers[i] + blockStart);
-        }
-      }
-
-      auto ioBlock = juce::dsp::AudioBlock<float>(
-          ioBufferChannelPointers.data(), numChannels, blockStart, blockSize);
-      juce::dsp::ProcessContextReplacing<float> context(ioBlock);
+      ioBufferChannelPointers[i] =
+          ((float *)outputInfo.ptr) + (i * numOutputSamples);
+    }
 
-      // Now all of the pointers in context are pointing to valid input data,
-      // so let's run the plugins.
-      for (auto *plugin : plugins) {
-        if (plugin == nullptr)
-          continue;
-        plugin->process(context);
-      }
+    if (changesLength || latency > 0 || numOutputSamples != numSamples) {
+      processInStages(inputInfo, inputChannelLayout, numChannels, numSamples,
+                      bufferSize, plugins, std::llround(latency),
+                      ioBufferChannelPointers, numOutputSamples,
+                      scratchSpace);
+    } else {
+      processInPlace(inputInfo, inputChannelLayout, numChannels, numSamples,
+                     bufferSize, plugins, ioBufferChannelPointers);
     }
   }
 
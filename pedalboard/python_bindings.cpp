@@ -27,29 +27,47 @@
 
 namespace py = pybind11;
 
+#include "AllocationTracking.h"
 #include "ExternalPlugin.h"
 #include "JucePlugin.h"
 #include "Plugin.h"
 #include "process.h"
 
+#include "plugins/AddNoise.h"
 #include "plugins/Chorus.h"
 #include "plugins/Compressor.h"
 #include "plugins/Convolution.h"
+#include "plugins/Delay.h"
 #include "plugins/Distortion.h"
 #include "plugins/Gain.h"
 #include "plugins/HighpassFilter.h"
 #include "plugins/LadderFilter.h"
 #include "plugins/Limiter.h"
+#include "plugins/LinearPhaseEQ.h"
 #include "plugins/LowpassFilter.h"
+#include "plugins/MidSide.h"
+#include "plugins/Mix.h"
 #include "plugins/NoiseGate.h"
 #include "plugins/Phaser.h"
+#include "plugins/PitchShift.h"
+#include "plugins/Resampled.h"
 #include "plugins/Reverb.h"
+#include "plugins/TimeStretch.h"
 
 using namespace Pedalboard;
 
-static constexpr int DEFAULT_BUFFER_SIZE = 8192;
-
+// Pedalboard doesn't rely on the GIL for thread safety: each plugin is guarded
+// by its own mutex, and parameters are stored atomically. Newer versions of
+// pybind11 allow us to declare this, so that free-threaded Python builds
+// don't re-enable the GIL when this module is imported.
+#if PYBIND11_VERSION_HEX >= 0x020D0000
+PYBIND11_MODULE(pedalboard_native, m, py::mod_gil_not_used()) {
+#else
 PYBIND11_MODULE(pedalboard_native, m) {
+#endif
+  // Used by tests to check if this module was built with TRACK_ALLOCATIONS=1.
+  m.attr("_allocation_tracking_enabled") = bool(PEDALBOARD_TRACK_ALLOCATIONS);
+
   m.def("process", process<float>,
         "Run a 32-bit floating point audio buffer through a list of Pedalboard "
         "plugins.",
@@ -119,22 +137,53 @@ PYBIND11_MODULE(pedalboard_native, m) {
               "will be "
               "converted to 32-bit for processing.",
               py::arg("input_array"), py::arg("sample_rate"),
-              py::arg("buffer_size") = DEFAULT_BUFFER_SIZE);
+              py::arg("buffer_size") = DEFAULT_BUFFER_SIZE)
+          .def(
+              "release",
+              [](Plugin &self) {
+                py::gil_scoped_release release;
+
+                // Release any plugins wrapped by this one (i.e.: by Mix) too,
+                // locking them all in pointer order as process() does.
+                std::vector<Plugin *> plugins = {&self};
+                self.appendNestedPlugins(plugins);
+                std::sort(plugins.begin(), plugins.end());
+                plugins.erase(std::unique(plugins.begin(), plugins.end()),
+                              plugins.end());
+
+                ScopedPluginLocks locks(plugins);
+                for (auto *plugin : plugins)
+                  plugin->release();
+              },
+              "Free any memory this plugin has allocated for processing "
+              "audio, while keeping its parameters. Useful when keeping many "
+              "idle plugins in memory; memory will be re-allocated the next "
+              "time this plugin is used.");
   plugin.attr("__call__") = plugin.attr("process");
 
+  init_addnoise(m);
   init_chorus(m);
 
   init_compressor(m);
   init_convolution(m);
+  init_delay(m);
   init_distortion(m);
   init_gain(m);
   init_highpass(m);
   init_ladderfilter(m);
   init_limiter(m);
+  init_linearphaseeq(m);
   init_lowpass(m);
+  init_midside(m);
+  init_mix(m);
   init_noisegate(m);
   init_phaser(m);
+  init_pitchshift(m);
+  init_resampled(m);
   init_reverb(m);
+  init_timestretch(m);
 
+#if JUCE_MODULE_AVAILABLE_juce_audio_processors
   init_external_plugins(m);
+#endif
 };
@@ -25,19 +25,34 @@ from distutils.unixccompiler import UnixCCompiler
 
 DEBUG = bool(int(os.environ.get('DEBUG', 0)))
 
+# Headless builds leave out JUCE's GUI modules, which makes pedalboard_native
+# smaller, faster to import, and removes the dependency on X11 and FreeType on
+# Linux. JUCE's plugin hosting code (juce_audio_processors) depends on the GUI
+# modules for plugin editor windows, so headless builds can't load VST3 or
+# Audio Unit plugins; all of Pedalboard's built-in plugins are still available.
+HEADLESS = bool(int(os.environ.get('HEADLESS', 0)))
+
+JUCE_MODULES = [
+    "juce_audio_basics",
+    "juce_audio_formats",
+    "juce_core",
+    "juce_data_structures",
+    "juce_dsp",
+    "juce_events",
+]
+GUI_JUCE_MODULES = [
+    "juce_audio_processors",
+    "juce_graphics",
+    "juce_gui_basics",
+    "juce_gui_extra",
+]
+if not HEADLESS:
+    JUCE_MODULES += GUI_JUCE_MODULES
+
 JUCE_CPPFLAGS = [
     "-DJUCE_DISPLAY_SPLASH_SCREEN=1",
     "-DJUCE_USE_DARK_SPLASH_SCREEN=1",
-    "-DJUCE_MODULE_AVAILABLE_juce_audio_basics=1",
-    "-DJUCE_MODULE_AVAILABLE_juce_audio_formats=1",
-    "-DJUCE_MODULE_AVAILABLE_juce_audio_processors=1",
-    "-DJUCE_MODULE_AVAILABLE_juce_core=1",
-    "-DJUCE_MODULE_AVAILABLE_juce_data_structures=1",
-    "-DJUCE_MODULE_AVAILABLE_juce_dsp=1",
-    "-DJUCE_MODULE_AVAILABLE_juce_events=1",
-    "-DJUCE_MODULE_AVAILABLE_juce_graphics=1",
-    "-DJUCE_MODULE_AVAILABLE_juce_gui_basics=1",
-    "-DJUCE_MODULE_AVAILABLE_juce_gui_extra=1",
+] + ["-DJUCE_MODULE_AVAILABLE_{}=1".format(module) for module in sorted(JUCE_MODULES)] + [
     "-DJUCE_GLOBAL_MODULE_SETTINGS_INCLUDED=1",
     "-DJUCE_STRICT_REFCOUNTEDPOINTER=1",
     "-DJUCE_STANDALONE_APPLICATION=1",
@@ -98,6 +113,21 @@ if DEBUG:
 else:
     JUCE_CPPFLAGS += ['/Ox' if platform.system() == "Windows" else '-O3']
 
+if bool(int(os.environ.get('TRACK_ALLOCATIONS', 0))):
+    # Replace the global operator new to detect heap allocations made
+    # inside Plugin::process, which then raise an exception. Test-only.
+    JUCE_CPPFLAGS += ['-DPEDALBOARD_TRACK_ALLOCATIONS=1']
+
+if os.environ.get('DIRECT_FORM_CROSSOVER_LENGTH'):
+    # The longest impulse response that Convolution processes in the time
+    # domain rather than with FFTs. By default, this is measured at runtime;
+    # setting it makes Convolution's output the same on every machine.
+    JUCE_CPPFLAGS += [
+        '-DPEDALBOARD_DIRECT_FORM_CROSSOVER_LENGTH={}'.format(
+            int(os.environ['DIRECT_FORM_CROSSOVER_LENGTH'])
+        )
+    ]
+
 
 # Regardless of platform, allow our compiler to compile .mm files as Objective-C (required on MacOS)
 UnixCCompiler.src_extensions.append(".mm")
@@ -145,16 +175,18 @@ if platform.system() == "Darwin":
             sources[sources.index(matching_cpp_source)] = objc_source
     PEDALBOARD_SOURCES = [str(p.resolve()) for p in sources]
 elif platform.system() == "Linux":
-    for package in ['freetype2']:
-        flags = (
-            check_output(['pkg-config', '--cflags-only-I', package])
-            .decode('utf-8')
-            .strip()
-            .split(' ')
-        )
-        include_paths = [flag[2:] for flag in flags]
-        JUCE_INCLUDES += include_paths
-    LINK_ARGS += ['-lfreetype']
+    # FreeType is only used by juce_graphics:
+    if not HEADLESS:
+        for package in ['freetype2']:
+            flags = (
+                check_output(['pkg-config', '--cflags-only-I', package])
+                .decode('utf-8')
+                .strip()
+                .split(' ')
+            )
+            include_paths = [flag[2:] for flag in flags]
+            JUCE_INCLUDES += include_paths
+        LINK_ARGS += ['-lfreetype']
 
     PEDALBOARD_SOURCES = [str(p.resolve()) for p in (list(Path("pedalboard").glob("**/*.cpp")))]
 elif platform.system() == "Windows":
@@ -182,6 +214,16 @@ else:
         "Not sure how to build JUCE on platform: {}!".format(platform.system())
     )
 
+if HEADLESS:
+    # Don't compile the juce_overrides/include_*.cpp (or .mm) files for modules
+    # we've left out of this build:
+    excluded_sources = {"include_{}".format(module) for module in GUI_JUCE_MODULES}
+    PEDALBOARD_SOURCES = [
+        source
+        for source in PEDALBOARD_SOURCES
+        if os.path.splitext(os.path.basename(source))[0] not in excluded_sources
+    ]
+
 pedalboard_cpp = Pybind11Extension(
     'pedalboard_native',
     sources=PEDALBOARD_SOURCES,
@@ -223,6 +265,7 @@ setup(
         "Programming Language :: Python :: 3.7",
         "Programming Language :: Python :: 3.8",
         "Programming Language :: Python :: 3.9",
+        "Programming Language :: Python :: Free Threading :: 2 - Beta",
     ],
     ext_modules=[pedalboard_cpp],
     install_requires=['numpy'],
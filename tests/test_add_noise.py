@@ -0,0 +1,123 @@
+#! /usr/bin/env python
+#
+# Copyright 2021 Spotify AB
+#
+# Licensed under the GNU Public License, Version 3.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    https://www.gnu.org/licenses/gpl-3.0.html
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+import os
+
+import pytest
+import numpy as np
+from pedalboard import AddNoise
+
+IMPULSE_RESPONSE_PATH = os.path.join(os.path.dirname(__file__), "impulse_response.wav")
+
+
+def measure_snr_db(signal: np.ndarray, output: np.ndarray) -> float:
+    signal = signal.astype(np.float64)
+    noise = output.astype(np.float64) - signal
+    return 10 * np.log10(np.sum(signal**2) / np.sum(noise**2))
+
+
+def sine(shape) -> np.ndarray:
+    return (0.3 * np.sin(np.arange(shape[-1]) * 0.05) * np.ones(shape)).astype(np.float32)
+
+
+@pytest.mark.parametrize("color", [AddNoise.White, AddNoise.Pink, AddNoise.Brown])
+@pytest.mark.parametrize("snr_db", [-10.0, 0.0, 20.0])
+@pytest.mark.parametrize("shape", [(44100,), (2, 44100)])
+def test_generated_noise_is_added_at_snr(color, snr_db, shape):
+    signal = sine(shape)
+    output = AddNoise(snr_db=snr_db, color=color)(signal, 44100, buffer_size=512)
+    assert measure_snr_db(signal, output) == pytest.approx(snr_db, abs=0.01)
+
+
+def test_noise_colors_have_different_spectra():
+    signal = np.ones(44100, dtype=np.float32)
+
+    def high_frequency_fraction(color):
+        noise = AddNoise(snr_db=0, color=color)(signal, 44100) - signal
+        spectrum = np.abs(np.fft.rfft(noise)) ** 2
+        return np.sum(spectrum[len(spectrum) // 2 :]) / np.sum(spectrum)
+
+    white = high_frequency_fraction(AddNoise.White)
+    pink = high_frequency_fraction(AddNoise.Pink)
+    brown = high_frequency_fraction(AddNoise.Brown)
+    assert white == pytest.approx(0.5, abs=0.05)
+    assert white > pink > brown
+
+
+def test_seed_makes_noise_repeatable():
+    signal = sine((44100,))
+    plugin = AddNoise(seed=1234)
+    first = plugin(signal, 44100)
+    second = plugin(signal, 44100)
+    assert not np.allclose(first, second)
+
+    np.testing.assert_array_equal(AddNoise(seed=1234)(signal, 44100), first)
+    plugin.seed(1234)
+    np.testing.assert_array_equal(plugin(signal, 44100), first)
+
+
+@pytest.mark.parametrize("noise_shape", [(1000,), (2, 1000), (1000, 2)])
+def test_provided_noise_is_looped_at_snr(noise_shape):
+    signal = sine((2, 44100))
+    noise = np.random.uniform(-1, 1, noise_shape).astype(np.float32)
+    output = AddNoise(snr_db=6, noise=noise)(signal, 44100)
+    assert measure_snr_db(signal, output) == pytest.approx(6, abs=0.01)
+
+    # Noise shorter than the signal repeats:
+    added = output - signal
+    np.testing.assert_allclose(added[:, :1000], added[:, 1000:2000], atol=1e-5)
+
+
+@pytest.mark.parametrize("sample_rate", [22050, 44100, 48000])
+def test_noise_from_file(sample_rate):
+    signal = sine((sample_rate,))
+    output = AddNoise(snr_db=10, noise_filename=IMPULSE_RESPONSE_PATH)(signal, sample_rate)
+    assert measure_snr_db(signal, output) == pytest.approx(10, abs=0.01)
+
+
+def test_snr_is_accurate_for_long_clips():
+    # A loud start followed by a long, quiet tail: the tail's energy must
+    # still be counted once the running total is large.
+    signal = sine((44100 * 60,))
+    signal[44100:] *= 0.01
+    output = AddNoise(snr_db=10, seed=1)(signal, 44100)
+    assert measure_snr_db(signal, output) == pytest.approx(10, abs=0.01)
+
+
+def test_silence_stays_silent():
+    silence = np.zeros(1000, dtype=np.float32)
+    np.testing.assert_array_equal(AddNoise()(silence, 44100), silence)
+
+
+def test_invalid_noise():
+    with pytest.raises(ValueError):
+        AddNoise(noise=np.zeros(100, dtype=np.float32), noise_filename=IMPULSE_RESPONSE_PATH)
+    with pytest.raises(RuntimeError):
+        AddNoise(noise=np.zeros((3, 100), dtype=np.float32))
+    with pytest.raises(RuntimeError):
+        AddNoise(noise_filename="/nonexistent/noise.wav")
+
+
+def test_noise_is_not_left_resampled_for_a_previous_sample_rate():
+    # The noise file is at 44.1kHz, so it's only resampled for the first call:
+    signal = sine((44100,))
+    plugin = AddNoise(snr_db=0, noise_filename=IMPULSE_RESPONSE_PATH, seed=1)
+    plugin(sine((22050,)), 22050)
+
+    plugin.seed(1)
+    expected = AddNoise(snr_db=0, noise_filename=IMPULSE_RESPONSE_PATH, seed=1)(signal, 44100)
+    np.testing.assert_array_equal(plugin(signal, 44100), expected)
@@ -0,0 +1,70 @@
+#! /usr/bin/env python
+#
+# Copyright 2021 Spotify AB
+#
+# Licensed under the GNU Public License, Version 3.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    https://www.gnu.org/licenses/gpl-3.0.html
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+import os
+import pytest
+import numpy as np
+
+import pedalboard
+import pedalboard_native
+
+IMPULSE_RESPONSE_PATH = os.path.join(os.path.dirname(__file__), "impulse_response.wav")
+
+# These tests only do anything useful if pedalboard was built with TRACK_ALLOCATIONS=1,
+# in which case process() raises an exception if a plugin allocates while processing.
+pytestmark = pytest.mark.skipif(
+    not pedalboard_native._allocation_tracking_enabled,
+    reason="pedalboard was not built with TRACK_ALLOCATIONS=1",
+)
+
+PLUGIN_FACTORIES = [
+    pedalboard.AddNoise,
+    lambda: pedalboard.AddNoise(color=pedalboard.AddNoise.Pink),
+    pedalboard.Chorus,
+    pedalboard.Compressor,
+    lambda: pedalboard.Convolution(IMPULSE_RESPONSE_PATH),
+    pedalboard.Delay,
+    lambda: pedalboard.Delay(feedback=0.5, tap_gains=[1.0, 0.5]),
+    pedalboard.Distortion,
+    pedalboard.Gain,
+    pedalboard.HighpassFilter,
+    pedalboard.LadderFilter,
+    pedalboard.Limiter,
+    lambda: pedalboard.LinearPhaseEQ([100, 1000, 8000], [6, -6, 3]),
+    pedalboard.LowpassFilter,
+    lambda: pedalboard.MidSide(pedalboard.LowpassFilter(), pedalboard.Gain(gain_db=-6)),
+    lambda: pedalboard.Mix(pedalboard.Reverb()),
+    lambda: pedalboard.Mix(pedalboard.LinearPhaseEQ([1000], [6]), mix=0.25),
+    pedalboard.NoiseGate,
+    pedalboard.Phaser,
+    lambda: pedalboard.PitchShift(semitones=7),
+    lambda: pedalboard.Resampled([pedalboard.LowpassFilter(cutoff_frequency_hz=1000)], 16000),
+    pedalboard.Reverb,
+    lambda: pedalboard.TimeStretch(rate=0.8),
+]
+
+
+@pytest.mark.parametrize("plugin_factory", PLUGIN_FACTORIES)
+@pytest.mark.parametrize("num_channels", [1, 2])
+@pytest.mark.parametrize("buffer_size", [1, 128, 8192])
+def test_process_does_not_allocate(plugin_factory, num_channels: int, buffer_size: int):
+    sr = 44100
+    noise = np.random.rand(num_channels, sr).astype(np.float32)
+    plugin = plugin_factory()
+    # Run twice, as the first call to process() may allocate while preparing.
+    for _ in range(2):
+        plugin.process(noise, sr, buffer_size=buffer_size)
@@ -16,12 +16,14 @@
 
 
 import time
+import wave
 
 import pytest
 import numpy as np
 
 import sox
 import pedalboard
+import pedalboard_native
 
 
 class timer(object):
@@ -69,3 +71,203 @@ def test_pysox_performance_difference():
     # This test ensures we're at least 100x faster to account for
     # variations across test run environments.
     assert average_pysox_time / average_pedalboard_time > 100
+
+
+@pytest.mark.skip
+@pytest.mark.parametrize("buffer_size", [128, 512, 8192])
+def test_convolution_performance_with_long_impulse_response(tmp_path, buffer_size: int):
+    """
+    Measures the time taken to process each block through a Convolution with a
+    long (five second) impulse response, where nearly all of the time is spent
+    on the frequency-domain multiply-accumulate across hundreds of partitions.
+    This is compared against JUCE's original four-pass multiply-accumulate.
+    """
+    sr = 48000
+    impulse_response = np.random.uniform(-1, 1, sr * 5) * np.exp(-np.linspace(0, 10, sr * 5))
+    path = str(tmp_path / "long_impulse_response.wav")
+    with wave.open(path, "wb") as f:
+        f.setnchannels(1)
+        f.setsampwidth(2)
+        f.setframerate(sr)
+        f.writeframes((impulse_response * 32767).astype("<i2").tobytes())
+
+    plugin = pedalboard.Convolution(path)
+    noise = np.random.rand(2, sr * 10).astype(np.float32)
+    num_blocks = noise.shape[1] / buffer_size
+
+    # Run once to build the convolution engine before timing anything.
+    plugin(noise[:, :buffer_size], sr, buffer_size=buffer_size)
+
+    def microseconds_per_block(use_reference: bool) -> float:
+        pedalboard_native._set_use_reference_convolution_kernel(use_reference)
+        try:
+            measurements = []
+            for _ in range(0, 5):
+                with timer() as time_taken:
+                    plugin(noise, sr, buffer_size=buffer_size)
+                measurements.append(float(time_taken))
+        finally:
+            pedalboard_native._set_use_reference_convolution_kernel(False)
+        return 1e6 * np.min(measurements) / num_blocks
+
+    reference = microseconds_per_block(use_reference=True)
+    fused = microseconds_per_block(use_reference=False)
+    realtime_budget = 1e6 * buffer_size / sr
+    print(
+        f"buffer_size={buffer_size}: {fused:.1f}µs per block"
+        f" ({100 * fused / realtime_budget:.1f}% of real time), vs."
+        f" {reference:.1f}µs with the four-pass multiply-accumulate"
+        f" ({reference / fused:.2f}x speedup)"
+    )
+    assert fused < realtime_budget
+    assert fused < reference
+
+
+@pytest.mark.skip
+@pytest.mark.parametrize("disk_backed_tail_after_seconds", [None, 5.0, 1.0, 0.0])
+def test_convolution_memory_with_disk_backed_tail(tmp_path, disk_backed_tail_after_seconds):
+    """
+    Compares the memory used by (and the speed of) a Convolution with a very
+    long (30 second, 96kHz, stereo) impulse response when its partitions are
+    all kept in memory, against keeping all but the first few seconds in a
+    memory-mapped file. (Memory is measured as anonymous RSS, so only works
+    on Linux: pages of memory-mapped files are excluded, as the OS can evict
+    them whenever it needs to.)
+    """
+
+    def anonymous_memory_mb() -> float:
+        with open("/proc/self/status") as f:
+            for line in f:
+                if line.startswith("RssAnon:"):
+                    return int(line.split()[1]) / 1024
+        raise RuntimeError("RssAnon not found in /proc/self/status")
+
+    sr = 96000
+    length = sr * 30
+    impulse_response = np.random.uniform(-1, 1, (length, 2)) * np.exp(
+        -np.linspace(0, 10, length)
+    ).reshape(-1, 1)
+    path = str(tmp_path / "very_long_impulse_response.wav")
+    with wave.open(path, "wb") as f:
+        f.setnchannels(2)
+        f.setsampwidth(2)
+        f.setframerate(sr)
+        f.writeframes((impulse_response * 32767).astype("<i2").tobytes())
+
+    noise = np.random.rand(2, sr * 5).astype(np.float32)
+    buffer_size = 8192
+
+    memory_before = anonymous_memory_mb()
+    plugin = pedalboard.Convolution(
+        path, disk_backed_tail_after_seconds=disk_backed_tail_after_seconds
+    )
+    # Run once to build the convolution engine before timing anything.
+    plugin(noise[:, :buffer_size], sr, buffer_size=buffer_size)
+    memory_used = anonymous_memory_mb() - memory_before
+
+    measurements = []
+    for _ in range(0, 3):
+        with timer() as time_taken:
+            plugin(noise, sr, buffer_size=buffer_size)
+        measurements.append(float(time_taken))
+
+    print(
+        f"disk_backed_tail_after_seconds={disk_backed_tail_after_seconds}:"
+        f" {memory_used:.1f}MB in memory, {np.min(measurements):.3f}s to process"
+        f" {noise.shape[1] / sr:.1f}s of audio"
+    )
+
+
+@pytest.mark.skip
+@pytest.mark.parametrize("feedback", [0.0, 0.5])
+@pytest.mark.parametrize("buffer_size", [32, 512, 8192])
+def test_chorus_performance(feedback: float, buffer_size: int):
+    """
+    Measures the time taken to process each block through a Chorus, compared
+    against juce::dsp::Chorus (which computes its LFO and delay a sample at a
+    time) with the same parameters.
+    """
+    sr = 48000
+    noise = np.random.rand(2, sr * 10).astype(np.float32)
+    num_blocks = noise.shape[1] / buffer_size
+
+    def microseconds_per_block(plugin) -> float:
+        measurements = []
+        for _ in range(0, 5):
+            with timer() as time_taken:
+                plugin(noise, sr, buffer_size=buffer_size)
+            measurements.append(float(time_taken))
+        return 1e6 * np.min(measurements) / num_blocks
+
+    chorus = microseconds_per_block(pedalboard.Chorus(depth=0.5, feedback=feedback))
+    reference = microseconds_per_block(
+        pedalboard_native._ReferenceChorus(depth=0.5, feedback=feedback)
+    )
+    print(
+        f"feedback={feedback}, buffer_size={buffer_size}:"
+        f" {chorus:.2f}µs per block, vs. {reference:.2f}µs with"
+        f" juce::dsp::Chorus ({reference / chorus:.2f}x speedup)"
+    )
+    assert chorus < reference
+
+
+@pytest.mark.skip
+@pytest.mark.parametrize("stages", [4, 6, 8, 12])
+@pytest.mark.parametrize("num_channels", [1, 2])
+def test_phaser_performance(stages: int, num_channels: int):
+    """
+    Compares the time taken to process audio through a Phaser with each
+    number of stages against juce::dsp::Phaser (which always has six) in the
+    same build.
+    """
+    sr = 48000
+    noise = np.random.rand(num_channels, sr * 10).astype(np.float32)
+
+    def nanoseconds_per_sample(plugin):
+        measurements = []
+        for _ in range(0, 5):
+            with timer() as time_taken:
+                plugin(noise, sr)
+            measurements.append(float(time_taken))
+        return 1e9 * np.min(measurements) / noise.size
+
+    phaser = nanoseconds_per_sample(pedalboard.Phaser(stages=stages))
+    reference = nanoseconds_per_sample(pedalboard_native._ReferencePhaser())
+    print(
+        f"stages={stages}, num_channels={num_channels}:"
+        f" {phaser:.2f}ns per sample, vs. {reference:.2f}ns with six-stage"
+        f" juce::dsp::Phaser ({reference / phaser:.2f}x speedup)"
+    )
+    if stages <= 6:
+        assert phaser < reference
+
+
+@pytest.mark.skip
+@pytest.mark.parametrize("num_channels", [1, 2])
+def test_ladder_filter_sweep_performance(num_channels: int):
+    """
+    Compares rendering a filter sweep through a LadderFilter by calling it on
+    many short chunks (changing cutoff_hz between each) against rendering the
+    same sweep in a single call, with cutoff_hz_modulation.
+    """
+    sr = 48000
+    chunk_size = 32
+    noise = np.random.rand(num_channels, sr * 10).astype(np.float32)
+    sweep = np.geomspace(100, 10000, noise.shape[1]).astype(np.float32)
+
+    plugin = pedalboard.LadderFilter()
+    with timer() as chunked_time_taken:
+        for start in range(0, noise.shape[1], chunk_size):
+            plugin.cutoff_hz = float(sweep[start])
+            plugin(noise[:, start : start + chunk_size], sr)
+
+    plugin = pedalboard.LadderFilter(cutoff_hz_modulation=sweep)
+    with timer() as modulated_time_taken:
+        plugin(noise, sr)
+
+    print(
+        f"num_channels={num_channels}: {float(chunked_time_taken):.3f}s in"
+        f" {chunk_size}-sample chunks, {float(modulated_time_taken):.3f}s with"
+        " cutoff_hz_modulation"
+    )
+    assert float(modulated_time_taken) < float(chunked_time_taken)
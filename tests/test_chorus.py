@@ -0,0 +1,73 @@
+#! /usr/bin/env python
+#
+# Copyright 2021 Spotify AB
+#
+# Licensed under the GNU Public License, Version 3.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    https://www.gnu.org/licenses/gpl-3.0.html
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+
+import pytest
+import numpy as np
+from pedalboard import Chorus
+
+
+def chorus_reference(signal, sr, rate_hz, depth, centre_delay_ms, feedback, mix):
+    """
+    A slow, sample-by-sample implementation of the same algorithm as
+    juce::dsp::Chorus, which Chorus should sound identical to.
+    """
+    delay_line_size = max(4, int(np.ceil(110 * sr / 1000)) + 1)
+    num_samples = signal.shape[-1]
+    lfo = np.sin(2 * np.pi * rate_hz * np.arange(num_samples) / sr - np.pi) * depth * 0.5
+    delay_ms = np.maximum(1.0, 20 * lfo + centre_delay_ms)
+    delay = np.clip(delay_ms * sr / 1000, 0, delay_line_size - 1)
+    whole = np.floor(delay).astype(int)
+    fraction = delay - whole
+
+    wet = np.zeros(signal.shape)
+    for c, channel in enumerate(signal):
+        pushed = np.zeros(num_samples)
+        last_output = 0.0
+        for i in range(num_samples):
+            pushed[i] = channel[i] - last_output
+            newer = pushed[i - whole[i]] if i >= whole[i] else 0.0
+            older = pushed[i - whole[i] - 1] if i > whole[i] else 0.0
+            wet[c, i] = newer + fraction[i] * (older - newer)
+            last_output = wet[c, i] * feedback
+    return signal * (1 - mix) + wet * mix
+
+
+@pytest.mark.parametrize(
+    "rate_hz,depth,centre_delay_ms", [(1.0, 0.25, 7.0), (5.0, 1.0, 2.0), (0.3, 0.9, 25.0)]
+)
+@pytest.mark.parametrize("feedback", [0.0, 0.5, -0.75])
+@pytest.mark.parametrize("buffer_size", [1, 100, 8192])
+def test_chorus_matches_reference(rate_hz, depth, centre_delay_ms, feedback, buffer_size):
+    sr = 22050
+    t = np.arange(sr // 2) / sr
+    signal = np.stack([np.sin(2 * np.pi * 440 * t), 0.5 * np.sin(2 * np.pi * 1234 * t)])
+    signal = signal.astype(np.float32)
+
+    plugin = Chorus(
+        rate_hz=rate_hz,
+        depth=depth,
+        centre_delay_ms=centre_delay_ms,
+        feedback=feedback,
+        mix=0.5,
+    )
+    result = plugin(signal, sr, buffer_size=buffer_size)
+    expected = chorus_reference(
+        signal.astype(np.float64), sr, rate_hz, depth, centre_delay_ms, feedback, 0.5
+    )
+    np.testing.assert_allclose(result, expected, rtol=0, atol=2e-4)
+
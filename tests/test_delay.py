@@ -0,0 +1,84 @@
+#! /usr/bin/env python
+#
+# Copyright 2021 Spotify AB
+#
+# Licensed under the GNU Public License, Version 3.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    https://www.gnu.org/licenses/gpl-3.0.html
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+
+import pytest
+import numpy as np
+from pedalboard import Delay
+
+
+def delay_reference(signal, delay_samples, feedback, mix, tap_gains=(1.0,)):
+    num_samples = signal.shape[-1]
+    line = np.zeros(signal.shape)
+    for i in range(num_samples):
+        line[:, i] = signal[:, i]
+        if i >= delay_samples:
+            line[:, i] += feedback * line[:, i - delay_samples]
+
+    wet = np.zeros(signal.shape)
+    for k, gain in enumerate(tap_gains):
+        offset = (k + 1) * delay_samples
+        wet[:, offset:] += gain * line[:, : max(0, num_samples - offset)]
+    return signal * (1 - mix) + wet * mix
+
+
+@pytest.mark.parametrize("delay_seconds", [1 / 8000, 0.0123, 0.25])
+@pytest.mark.parametrize("feedback", [0.0, 0.6])
+@pytest.mark.parametrize("tap_gains", [None, [1.0, 0.5, 0.25]])
+@pytest.mark.parametrize("buffer_size", [1, 37, 8192])
+def test_delay_matches_reference(delay_seconds, feedback, tap_gains, buffer_size):
+    sr = 8000
+    noise = np.random.uniform(-1, 1, (2, sr)).astype(np.float32)
+    plugin = Delay(delay_seconds=delay_seconds, feedback=feedback, mix=0.5, tap_gains=tap_gains)
+    result = plugin(noise, sr, buffer_size=buffer_size)
+    expected = delay_reference(
+        noise.astype(np.float64), round(delay_seconds * sr), feedback, 0.5, tap_gains or [1.0]
+    )
+    np.testing.assert_allclose(result, expected, rtol=1e-5, atol=1e-5)
+
+
+def test_tempo_synced_delay():
+    sr = 8000
+    noise = np.random.uniform(-1, 1, (2, sr)).astype(np.float32)
+    # A sixteenth note at 120bpm is 0.125 seconds long:
+    synced = Delay(delay_seconds=1.0, tempo_bpm=120, delay_beats=0.25, feedback=0.5)
+    unsynced = Delay(delay_seconds=0.125, feedback=0.5)
+    np.testing.assert_allclose(synced(noise, sr), unsynced(noise, sr), rtol=1e-6, atol=1e-6)
+
+    synced.tempo_bpm = None
+    assert synced.tempo_bpm is None
+    np.testing.assert_allclose(
+        synced(noise, sr), Delay(delay_seconds=1.0, feedback=0.5)(noise, sr), rtol=1e-6, atol=1e-6
+    )
+
+
+@pytest.mark.parametrize(
+    "kwargs",
+    [
+        {"delay_seconds": 0},
+        {"delay_seconds": 31},
+        {"feedback": -0.1},
+        {"feedback": 1.1},
+        {"mix": 2},
+        {"tempo_bpm": 120},
+        {"tempo_bpm": 0, "delay_beats": 1},
+        {"tap_gains": []},
+    ],
+)
+def test_delay_throws_on_invalid_parameters(kwargs):
+    with pytest.raises(ValueError):
+        Delay(**kwargs)
@@ -15,6 +15,7 @@
 # limitations under the License.
 
 
+import gc
 import os
 import math
 import platform
@@ -23,9 +24,16 @@ from glob import glob
 from pedalboard.pedalboard import WrappedBool
 import pytest
 import pedalboard
+import pedalboard_native
 import numpy as np
 
 
+# Headless builds of pedalboard (built with HEADLESS=1) can't host external plugins.
+pytestmark = pytest.mark.skipif(
+    not pedalboard.AVAILABLE_PLUGIN_CLASSES,
+    reason="pedalboard was built without support for external plugins",
+)
+
 TEST_PLUGIN_BASE_PATH = os.path.join(os.path.abspath(os.path.dirname(__file__)), "plugins")
 
 AVAILABLE_PLUGINS_IN_TEST_ENVIRONMENT = [
@@ -326,6 +334,30 @@ def test_plugin_state_cleared_between_invocations(plugin_filename: str):
     assert np.allclose(plugin(slience, sr), effected_silence)
 
 
+@pytest.mark.parametrize("plugin_filename", AVAILABLE_PLUGINS_IN_TEST_ENVIRONMENT)
+def test_plugin_can_be_reloaded_repeatedly(plugin_filename: str):
+    # Loading and dropping the only live instance of a plugin shouldn't
+    # tear down (and then have to recreate) JUCE's global hosting state.
+    sr = 44100
+    noise = np.random.rand(sr)
+    path = os.path.join(TEST_PLUGIN_BASE_PATH, platform.system(), plugin_filename)
+    expected = None
+    message_manager_address = None
+    for _ in range(5):
+        plugin = pedalboard.load_plugin(path)
+        if message_manager_address is None:
+            message_manager_address = pedalboard_native._get_message_manager_address()
+            assert message_manager_address != 0
+        output = plugin(noise, sr)
+        if expected is None:
+            expected = output
+        assert np.allclose(output, expected)
+
+        del plugin
+        gc.collect()
+        assert pedalboard_native._get_message_manager_address() == message_manager_address
+
+
 @pytest.mark.parametrize("value", (True, False))
 def test_wrapped_bool(value: bool):
     wrapped = WrappedBool(value)
@@ -69,3 +69,37 @@ def test_lowpass_slope(cutoff_frequency_hz, fundamental_hz, sample_rate):
     assert np.allclose(
         rms(filtered) / rms(sine_wave), db_to_gain((num_octaves + 1) * -3), rtol=0.1, atol=0.1
     )
+
+
+@pytest.mark.parametrize("filter_type", [HighpassFilter, LowpassFilter])
+@pytest.mark.parametrize("fundamental_hz", [440, 880])
+@pytest.mark.parametrize("sample_rate", [22050, 44100, 48000])
+def test_zero_phase_filter_has_no_phase_shift(filter_type, fundamental_hz, sample_rate):
+    samples = np.arange(sample_rate)
+    sine_wave = np.sin(2 * np.pi * fundamental_hz * samples / sample_rate).astype(np.float32)
+    plugin = filter_type(cutoff_frequency_hz=fundamental_hz, zero_phase=True)
+    filtered = plugin(np.stack([sine_wave, sine_wave]), sample_rate, buffer_size=128)
+
+    # Filtering forwards and backwards squares the magnitude response (so the
+    # cutoff frequency is attenuated by -6dB) but doesn't delay the signal.
+    # (As with scipy.signal.filtfilt, there are transients at the edges.)
+    expected = sine_wave * db_to_gain(-6)
+    for channel in filtered:
+        np.testing.assert_allclose(channel[1000:-1000], expected[1000:-1000], atol=0.01)
+
+
+@pytest.mark.parametrize("filter_type", [HighpassFilter, LowpassFilter])
+def test_zero_phase_impulse_response_is_symmetric(filter_type):
+    impulse = np.zeros(10001, dtype=np.float32)
+    impulse[5000] = 1
+    filtered = filter_type(cutoff_frequency_hz=1000, zero_phase=True)(impulse, 44100)
+    np.testing.assert_allclose(filtered, filtered[::-1], atol=1e-6)
+    assert np.argmax(np.abs(filtered)) == 5000
+
+
+def test_zero_phase_property():
+    plugin = LowpassFilter(cutoff_frequency_hz=1000)
+    assert not plugin.zero_phase
+    plugin.zero_phase = True
+    assert plugin.zero_phase
+    assert "zero_phase=True" in repr(plugin)
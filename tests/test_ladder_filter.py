@@ -0,0 +1,107 @@
+#! /usr/bin/env python
+#
+# Copyright 2021 Spotify AB
+#
+# Licensed under the GNU Public License, Version 3.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    https://www.gnu.org/licenses/gpl-3.0.html
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+
+import pytest
+import numpy as np
+from pedalboard import LadderFilter
+
+MODE_WEIGHTS = {
+    LadderFilter.Mode.LPF12: ([0, 0, 1, 0, 0], 0.5),
+    LadderFilter.Mode.HPF12: ([1, -2, 1, 0, 0], 0.0),
+    LadderFilter.Mode.BPF12: ([0, 0, -1, 1, 0], 0.5),
+    LadderFilter.Mode.LPF24: ([0, 0, 0, 0, 1], 0.5),
+    LadderFilter.Mode.HPF24: ([1, -4, 6, -4, 1], 0.0),
+    LadderFilter.Mode.BPF24: ([0, 0, 1, -2, 1], 0.5),
+}
+
+
+def ladder_filter_reference(signal, sr, mode, cutoff_hz, resonance, drive):
+    """
+    A slow, sample-by-sample implementation of the same algorithm as
+    juce::dsp::LadderFilter (but with an exact tanh rather than a lookup
+    table), with either a constant or a per-sample cutoff frequency.
+    """
+    weights, compensation = MODE_WEIGHTS[mode]
+    weights = 1.2 * np.array(weights)
+    gain = drive ** -2.642 * 0.6103 + 0.3903
+    drive2 = drive * 0.04 + 0.96
+    gain2 = drive2 ** -2.642 * 0.6103 + 0.3903
+    feedback = -4 * (0.1 + 0.9 * resonance)
+    a1 = np.exp(-2 * np.pi * np.broadcast_to(cutoff_hz, signal.shape[-1]) / sr)
+    b0 = (1 - a1) * 0.76923076923
+    b1 = (1 - a1) * 0.23076923076
+
+    output = np.zeros(signal.shape)
+    for c, channel in enumerate(signal):
+        s = [0.0] * 5
+        for i, x in enumerate(channel):
+            dx = gain * np.tanh(np.clip(drive * x, -5, 5))
+            a = dx + feedback * (gain2 * np.tanh(np.clip(drive2 * s[4], -5, 5)) - dx * compensation)
+            b = b1[i] * s[0] + a1[i] * s[1] + b0[i] * a
+            c_ = b1[i] * s[1] + a1[i] * s[2] + b0[i] * b
+            d = b1[i] * s[2] + a1[i] * s[3] + b0[i] * c_
+            e = b1[i] * s[3] + a1[i] * s[4] + b0[i] * d
+            s = [a, b, c_, d, e]
+            output[c, i] = np.dot(s, weights)
+    return output
+
+
+@pytest.mark.parametrize("mode", list(MODE_WEIGHTS.keys()))
+@pytest.mark.parametrize("num_channels", [1, 2])
+@pytest.mark.parametrize("modulated", [False, True])
+def test_ladder_filter_matches_reference(mode, num_channels, modulated):
+    sr = 44100
+    num_samples = sr // 16
+    noise = np.random.uniform(-1, 1, (num_channels, num_samples)).astype(np.float32)
+
+    plugin = LadderFilter(mode=mode, cutoff_hz=1000, resonance=0.9, drive=4.0)
+    cutoff_hz = 1000.0
+    if modulated:
+        # A sweep that ends halfway through the audio, after which the
+        # last cutoff frequency should be held:
+        sweep = np.geomspace(100, 10000, num_samples // 2).astype(np.float32)
+        plugin.cutoff_hz_modulation = sweep
+        cutoff_hz = np.concatenate([sweep, np.full(num_samples - len(sweep), sweep[-1])])
+
+    result = plugin(noise, sr, buffer_size=100)
+    expected = ladder_filter_reference(noise.astype(np.float64), sr, mode, cutoff_hz, 0.9, 4.0)
+    np.testing.assert_allclose(result, expected, rtol=0, atol=1e-4)
+
+
+def test_constant_cutoff_modulation_matches_cutoff_hz():
+    sr = 44100
+    noise = np.random.uniform(-1, 1, (2, sr)).astype(np.float32)
+    expected = LadderFilter(cutoff_hz=440)(noise, sr)
+    modulated = LadderFilter(cutoff_hz=10000, cutoff_hz_modulation=np.array([440.0]))
+    np.testing.assert_allclose(modulated(noise, sr), expected, rtol=1e-6, atol=1e-6)
+
+
+def test_cutoff_modulation_property():
+    plugin = LadderFilter()
+    assert plugin.cutoff_hz_modulation is None
+
+    plugin.cutoff_hz_modulation = [100, 200, 300]
+    np.testing.assert_array_equal(plugin.cutoff_hz_modulation, [100, 200, 300])
+
+    plugin.cutoff_hz_modulation = None
+    assert plugin.cutoff_hz_modulation is None
+
+    with pytest.raises(ValueError):
+        plugin.cutoff_hz_modulation = [100, 0, 300]
+    with pytest.raises(ValueError):
+        plugin.cutoff_hz_modulation = np.ones((2, 10))
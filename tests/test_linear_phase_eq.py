@@ -0,0 +1,74 @@
+#! /usr/bin/env python
+#
+# Copyright 2021 Spotify AB
+#
+# Licensed under the GNU Public License, Version 3.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    https://www.gnu.org/licenses/gpl-3.0.html
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+import pytest
+import numpy as np
+from pedalboard import LinearPhaseEQ, Mix
+
+BAND_FREQUENCIES_HZ = [100, 1000, 8000]
+BAND_GAINS_DB = [6, -6, 3]
+
+
+@pytest.mark.parametrize("buffer_size", [1, 128, 8192])
+@pytest.mark.parametrize("shape", [(44100,), (2, 44100)])
+def test_flat_eq_is_identity(buffer_size, shape):
+    noise = np.random.uniform(-1, 1, shape).astype(np.float32)
+    plugin = LinearPhaseEQ([1000], [0], num_taps=255)
+    np.testing.assert_allclose(plugin(noise, 44100, buffer_size=buffer_size), noise, atol=1e-4)
+
+
+@pytest.mark.parametrize("band", [0, 1, 2])
+@pytest.mark.parametrize("buffer_size", [512, 8192])
+def test_eq_applies_gain_without_delay(band, buffer_size):
+    sr = 44100
+    frequency = BAND_FREQUENCIES_HZ[band]
+    sine = np.sin(2 * np.pi * frequency * np.arange(sr) / sr).astype(np.float32)
+    plugin = LinearPhaseEQ(BAND_FREQUENCIES_HZ, BAND_GAINS_DB, num_taps=4095)
+    output = plugin(sine, sr, buffer_size=buffer_size)
+
+    assert output.shape == sine.shape
+    # Ignore the filter's ramp-up at either end:
+    output = output[4096:-4096]
+    sine = sine[4096:-4096]
+    gain = np.sqrt(np.mean(output**2) / np.mean(sine**2))
+    assert 20 * np.log10(gain) == pytest.approx(BAND_GAINS_DB[band], abs=0.3)
+    np.testing.assert_allclose(output, sine * gain, atol=0.02)
+
+
+def test_eq_is_aligned_within_mix():
+    noise = np.random.uniform(-1, 1, 44100).astype(np.float32)
+    plugin = Mix(LinearPhaseEQ([1000], [0], num_taps=255), mix=0.5)
+    np.testing.assert_allclose(plugin(noise, 44100), noise, atol=1e-4)
+
+
+def test_changing_bands():
+    plugin = LinearPhaseEQ([1000], [0])
+    plugin.set_bands(BAND_FREQUENCIES_HZ, BAND_GAINS_DB)
+    assert plugin.band_frequencies_hz == BAND_FREQUENCIES_HZ
+    assert plugin.band_gains_db == BAND_GAINS_DB
+    assert "8000Hz: 3dB" in repr(plugin)
+
+
+def test_invalid_parameters():
+    with pytest.raises(ValueError):
+        LinearPhaseEQ([100, 1000], [0])
+    with pytest.raises(ValueError):
+        LinearPhaseEQ([1000, 100], [0, 0])
+    with pytest.raises(ValueError):
+        LinearPhaseEQ([1000], [0], num_taps=1024)
+    with pytest.raises(ValueError):
+        LinearPhaseEQ([], [])
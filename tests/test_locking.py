@@ -16,6 +16,8 @@
 
 
 import random
+import threading
+import time
 import pytest
 from concurrent.futures import ThreadPoolExecutor
 
@@ -65,3 +67,80 @@ def test_multiple_threads_using_same_plugin_instances(num_concurrent_chains: int
     first_result = processed[0]
     for other_result in processed[1:]:
         assert np.allclose(first_result, other_result)
+
+
+@pytest.mark.parametrize("num_threads", [2, 8])
+def test_parameters_can_be_set_while_processing(num_threads: int):
+    """
+    Change plugin parameters from some threads while other threads process
+    audio through the same plugins. Without the GIL (on free-threaded Python
+    builds) these threads run truly in parallel, so this checks that parameter
+    access is safe from any thread.
+    """
+    sr = 48000
+    reverb = pedalboard.Reverb()
+    compressor = pedalboard.Compressor()
+    lowpass = pedalboard.LowpassFilter()
+    board = pedalboard.Pedalboard([compressor, lowpass, reverb], sample_rate=sr)
+    noise = np.random.rand(2, sr).astype(np.float32)
+
+    def process():
+        for _ in range(5):
+            output = board.process(noise, buffer_size=512)
+            assert output.shape == noise.shape
+            assert np.all(np.isfinite(output))
+
+    def set_parameters(seed: int):
+        rng = random.Random(seed)
+        for _ in range(1000):
+            reverb.room_size = rng.random()
+            reverb.wet_level = rng.random()
+            compressor.threshold_db = rng.uniform(-60, 0)
+            compressor.ratio = rng.uniform(1, 20)
+            lowpass.cutoff_frequency_hz = rng.uniform(20, 20000)
+            assert 0 <= reverb.room_size <= 1
+            assert compressor.ratio >= 1
+
+    with ThreadPoolExecutor(max_workers=num_threads * 2) as e:
+        futures = [e.submit(process) for _ in range(num_threads)]
+        futures += [e.submit(set_parameters, i) for i in range(num_threads)]
+        for future in futures:
+            future.result(timeout=60)
+
+
+def test_setting_parameters_does_not_stall_other_threads():
+    """
+    Setting a parameter on a plugin that's being used by another thread has
+    to wait for process() to finish; other Python threads should still be
+    able to run in the meantime.
+    """
+    sr = 44100
+    reverb = pedalboard.Reverb()
+    noise = np.random.rand(2, sr * 60).astype(np.float32)
+    started = threading.Event()
+
+    def process():
+        started.set()
+        return reverb.process(noise, sr)
+
+    def set_parameter():
+        reverb.room_size = 0.25
+
+    with ThreadPoolExecutor(max_workers=2) as e:
+        processing = e.submit(process)
+        started.wait()
+        time.sleep(0.01)
+        setting = e.submit(set_parameter)
+
+        ticks = 0
+        while not processing.done():
+            ticks += 1
+            time.sleep(0.001)
+
+        processing.result(timeout=60)
+        setting.result(timeout=60)
+
+    assert reverb.room_size == 0.25
+    # If the setter held the GIL while waiting for the plugin's lock, this
+    # thread wouldn't have run at all until processing was finished.
+    assert ticks > 10
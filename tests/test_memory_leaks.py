@@ -24,6 +24,11 @@ import platform
 import pedalboard
 from .test_external_plugins import TEST_PLUGIN_BASE_PATH, AVAILABLE_PLUGINS_IN_TEST_ENVIRONMENT
 
+pytestmark = pytest.mark.skipif(
+    not pedalboard.AVAILABLE_PLUGIN_CLASSES,
+    reason="pedalboard was built without support for external plugins",
+)
+
 
 @pytest.mark.parametrize("plugin_path", AVAILABLE_PLUGINS_IN_TEST_ENVIRONMENT)
 def test_plugin_can_be_garbage_collected(plugin_path: str):
@@ -0,0 +1,88 @@
+#! /usr/bin/env python
+#
+# Copyright 2021 Spotify AB
+#
+# Licensed under the GNU Public License, Version 3.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    https://www.gnu.org/licenses/gpl-3.0.html
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+import gc
+
+import pytest
+import numpy as np
+from pedalboard import Pedalboard, Gain, LowpassFilter, MidSide, Mix
+
+
+@pytest.mark.parametrize("mix", [0.0, 0.25, 1.0])
+@pytest.mark.parametrize("shape", [(44100,), (2, 44100)])
+def test_mix_is_linear(mix, shape):
+    sr = 44100
+    noise = np.random.uniform(-1, 1, shape).astype(np.float32)
+    wet = LowpassFilter(cutoff_frequency_hz=1000)(noise, sr)
+    result = Mix(LowpassFilter(cutoff_frequency_hz=1000), mix=mix)(noise, sr)
+    np.testing.assert_allclose(result, noise * (1 - mix) + wet * mix, atol=1e-5)
+
+
+def test_mix_is_applied_from_first_call_and_after_release():
+    # Shorter than the mixer's 50ms smoothing time:
+    sr = 44100
+    noise = np.random.uniform(-1, 1, (2, 1000)).astype(np.float32)
+    wet = LowpassFilter(cutoff_frequency_hz=1000)(noise, sr)
+    expected = noise * 0.75 + wet * 0.25
+
+    plugin = Mix(LowpassFilter(cutoff_frequency_hz=1000), mix=0.25)
+    np.testing.assert_allclose(plugin(noise, sr), expected, atol=1e-5)
+    plugin.release()
+    np.testing.assert_allclose(plugin(noise, sr), expected, atol=1e-5)
+
+
+def test_mix_keeps_plugin_alive():
+    mix = Mix(Gain(gain_db=-6))
+    gc.collect()
+    assert isinstance(mix.plugin, Gain)
+    assert mix.plugin.gain_db == -6
+    assert "Gain" in repr(mix)
+
+
+def test_invalid_mix():
+    with pytest.raises(ValueError):
+        Mix(Gain(), mix=1.5)
+
+
+@pytest.mark.parametrize("buffer_size", [1, 128, 8192])
+def test_mid_side_matches_reference(buffer_size):
+    sr = 44100
+    noise = np.random.uniform(-1, 1, (2, sr)).astype(np.float32)
+    mid = (noise[0] + noise[1]) / 2
+    side = (noise[0] - noise[1]) / 2
+    mid = LowpassFilter(cutoff_frequency_hz=500)(mid, sr)
+    side = Gain(gain_db=-12)(side, sr)
+    expected = np.stack([mid + side, mid - side])
+
+    plugin = MidSide(LowpassFilter(cutoff_frequency_hz=500), Gain(gain_db=-12))
+    np.testing.assert_allclose(plugin(noise, sr, buffer_size=buffer_size), expected, atol=1e-5)
+
+
+def test_mid_side_without_plugins_is_transparent():
+    sr = 44100
+    noise = np.random.uniform(-1, 1, (2, sr)).astype(np.float32)
+    np.testing.assert_allclose(MidSide()(noise, sr), noise, atol=1e-6)
+
+
+def test_wrapped_plugin_cannot_be_reused_in_same_chain():
+    gain = Gain(gain_db=-6)
+    board = Pedalboard([Mix(gain), gain], sample_rate=44100)
+    with pytest.raises(RuntimeError):
+        board(np.zeros((2, 1024), dtype=np.float32))
+
+    with pytest.raises(RuntimeError):
+        MidSide(gain, gain)(np.zeros((2, 1024), dtype=np.float32), 44100)
@@ -16,9 +16,22 @@
 
 
 import os
+import threading
+import wave
 import pytest
 import numpy as np
-from pedalboard import process, Distortion, Gain, Compressor, Convolution
+import pedalboard_native
+from pedalboard import (
+    process,
+    clear_preloaded_impulse_responses,
+    preload_impulse_responses,
+    Chorus,
+    Compressor,
+    Convolution,
+    Distortion,
+    Gain,
+    Reverb,
+)
 
 IMPULSE_RESPONSE_PATH = os.path.join(os.path.dirname(__file__), "impulse_response.wav")
 
@@ -69,6 +82,261 @@ def test_convolution_works(sr=44100, duration=10):
     assert not np.allclose(full_scale_noise, result, rtol=0.1)
 
 
+@pytest.mark.parametrize("buffer_size", [100, 8192])
+def test_convolution_mix_is_applied_from_first_call(buffer_size: int, sr=44100):
+    # Shorter than the mixer's 50ms smoothing time:
+    noise = np.random.rand(2, 1000).astype(np.float32)
+    wet = Convolution(IMPULSE_RESPONSE_PATH)(noise, sr, buffer_size=buffer_size)
+    expected = noise * 0.5 + wet * 0.5
+
+    plugin = Convolution(IMPULSE_RESPONSE_PATH, 0.5)
+    np.testing.assert_allclose(plugin(noise, sr, buffer_size=buffer_size), expected, atol=1e-5)
+    plugin.release()
+    np.testing.assert_allclose(plugin(noise, sr, buffer_size=buffer_size), expected, atol=1e-5)
+
+
+@pytest.mark.parametrize("impulse_response_length", [1, 16, 64, 65, 256, 257, 1000])
+@pytest.mark.parametrize("buffer_size", [1, 100, 512, 8192])
+def test_convolution_matches_numpy(tmp_path, impulse_response_length: int, buffer_size: int):
+    # Short impulse responses are convolved in the time domain, while longer
+    # ones use FFTs; both should match numpy to within float tolerance.
+    sr = 44100
+    impulse_response = np.random.uniform(-1, 1, impulse_response_length)
+    pcm = (impulse_response * 32767).astype("<i2")
+    path = str(tmp_path / "impulse_response.wav")
+    with wave.open(path, "wb") as f:
+        f.setnchannels(1)
+        f.setsampwidth(2)
+        f.setframerate(sr)
+        f.writeframes(pcm.tobytes())
+
+    # Convolution normalises impulse responses when loading them:
+    impulse_response = pcm.astype(np.float32) / 32768
+    impulse_response *= 0.125 / np.sqrt(np.sum(impulse_response ** 2))
+
+    signal = np.random.rand(2, sr).astype(np.float32)
+    expected = np.stack([np.convolve(c, impulse_response)[: signal.shape[1]] for c in signal])
+    result = Convolution(path)(signal, sr, buffer_size=buffer_size)
+    np.testing.assert_allclose(result, expected, rtol=1e-4, atol=1e-4)
+
+
+def test_direct_form_crossover_is_measured_once():
+    length = pedalboard_native._get_direct_form_crossover_length()
+    assert length >= 0
+    assert pedalboard_native._get_direct_form_crossover_length() == length
+
+
+@pytest.mark.parametrize("offline", [False, True])
+@pytest.mark.parametrize("buffer_size", [100, 8192])
+def test_true_stereo_convolution_matches_numpy(tmp_path, offline: bool, buffer_size: int):
+    sr = 44100
+    # Channels are the L->L, L->R, R->L and R->R paths:
+    impulse_response = np.random.uniform(-1, 1, (4, 1000))
+    pcm = (impulse_response * 32767).astype("<i2")
+    path = str(tmp_path / "true_stereo_impulse_response.wav")
+    with wave.open(path, "wb") as f:
+        f.setnchannels(4)
+        f.setsampwidth(2)
+        f.setframerate(sr)
+        f.writeframes(pcm.T.tobytes())
+
+    # All four paths are normalised together, by the loudest of them:
+    impulse_response = pcm.astype(np.float32) / 32768
+    impulse_response *= 0.125 / np.sqrt(np.max(np.sum(impulse_response ** 2, axis=1)))
+
+    signal = np.random.rand(2, sr).astype(np.float32)
+    ll, lr, rl, rr = [
+        np.convolve(signal[i // 2], impulse_response[i])[: signal.shape[1]] for i in range(4)
+    ]
+    expected = np.stack([ll + rl, lr + rr])
+    result = Convolution(path, offline=offline)(signal, sr, buffer_size=buffer_size)
+    np.testing.assert_allclose(result, expected, rtol=1e-4, atol=1e-4)
+
+
+# Inputs shorter than the impulse response are processed with smaller partitions offline:
+@pytest.mark.parametrize("shape", [(1000,), (2, 5000), (44100,), (2, 44100), (2, 100000)])
+def test_offline_convolution_matches_realtime(shape, sr=44100):
+    noise = np.random.rand(*shape).astype(np.float32)
+    realtime = Convolution(IMPULSE_RESPONSE_PATH, 0.5)
+    offline = Convolution(IMPULSE_RESPONSE_PATH, 0.5, offline=True)
+    assert offline.offline and not realtime.offline
+
+    expected = realtime(noise, sr, buffer_size=512)
+    # buffer_size is ignored in offline mode:
+    np.testing.assert_allclose(offline(noise, sr, buffer_size=512), expected, atol=1e-4)
+    np.testing.assert_allclose(offline(noise, sr), expected, atol=1e-4)
+
+
+@pytest.mark.parametrize("offline", [False, True])
+@pytest.mark.parametrize("num_threads", [0, 1, 3])
+def test_convolution_process_batch(offline: bool, num_threads: int, sr=44100):
+    clips = [np.random.rand(2, [1000, sr, 2 * sr][i % 3]).astype(np.float32) for i in range(7)]
+    plugin = Convolution(IMPULSE_RESPONSE_PATH, 0.75, offline=offline)
+
+    results = plugin.process_batch(clips, sr, num_threads=num_threads)
+    assert len(results) == len(clips)
+    for clip, result in zip(clips, results):
+        np.testing.assert_allclose(result, plugin(clip, sr), atol=1e-4)
+
+
+@pytest.mark.parametrize("preload", [False, True])
+def test_async_convolution_matches_sync(preload: bool, sr=44100):
+    if preload:
+        preload_impulse_responses([IMPULSE_RESPONSE_PATH])
+    noise = np.random.rand(2, sr).astype(np.float32)
+    expected = Convolution(IMPULSE_RESPONSE_PATH, 0.5)(noise, sr)
+    plugin = Convolution(IMPULSE_RESPONSE_PATH, 0.5, load_async=True)
+    np.testing.assert_allclose(plugin(noise, sr), expected, atol=1e-6)
+
+
+def test_clear_preloaded_impulse_responses(sr=44100):
+    preload_impulse_responses([IMPULSE_RESPONSE_PATH])
+    assert pedalboard_native._get_preloaded_impulse_responses_size() > 0
+    clear_preloaded_impulse_responses()
+    assert pedalboard_native._get_preloaded_impulse_responses_size() == 0
+
+    # Files are read from disk again once cleared:
+    noise = np.random.rand(2, sr).astype(np.float32)
+    np.testing.assert_allclose(
+        Convolution(IMPULSE_RESPONSE_PATH)(noise, sr),
+        Convolution(IMPULSE_RESPONSE_PATH, load_async=True)(noise, sr),
+        atol=1e-6,
+    )
+
+
+def test_many_async_convolutions(sr=44100):
+    noise = np.random.rand(2, sr // 10).astype(np.float32)
+    expected = Convolution(IMPULSE_RESPONSE_PATH)(noise, sr)
+    plugins = [Convolution(IMPULSE_RESPONSE_PATH, load_async=True) for _ in range(64)]
+    for plugin in plugins:
+        np.testing.assert_allclose(plugin(noise, sr), expected, atol=1e-6)
+
+
+def test_preload_impulse_responses_throws_on_missing_file():
+    with pytest.raises(RuntimeError):
+        preload_impulse_responses([IMPULSE_RESPONSE_PATH, IMPULSE_RESPONSE_PATH + ".missing"])
+
+
+@pytest.mark.parametrize("offline", [False, True])
+def test_convolution_partition_cache(tmp_path, offline: bool, sr=44100):
+    noise = np.random.rand(2, sr).astype(np.float32)
+    expected = Convolution(IMPULSE_RESPONSE_PATH, 0.5, offline=offline)(noise, sr)
+
+    cache_directory = str(tmp_path / "partitions")
+    first = Convolution(
+        IMPULSE_RESPONSE_PATH, 0.5, offline=offline, partition_cache_directory=cache_directory
+    )
+    np.testing.assert_allclose(first(noise, sr), expected, atol=1e-6)
+    cache_files = os.listdir(cache_directory)
+    assert len(cache_files) == 1
+
+    # A second plugin should load its partitions from the cache file:
+    second = Convolution(
+        IMPULSE_RESPONSE_PATH, 0.5, offline=offline, partition_cache_directory=cache_directory
+    )
+    np.testing.assert_allclose(second(noise, sr), expected, atol=1e-6)
+
+    # ...and corrupt cache files should be ignored (and replaced):
+    del first, second
+    with open(os.path.join(cache_directory, cache_files[0]), "r+b") as f:
+        f.write(b"garbage")
+    third = Convolution(
+        IMPULSE_RESPONSE_PATH, 0.5, offline=offline, partition_cache_directory=cache_directory
+    )
+    np.testing.assert_allclose(third(noise, sr), expected, atol=1e-6)
+
+
+@pytest.mark.parametrize("offline", [False, True])
+@pytest.mark.parametrize("disk_backed_tail_after_seconds", [0.0, 0.05, 10.0])
+def test_disk_backed_tail_matches_in_memory(
+    offline: bool, disk_backed_tail_after_seconds: float, sr=44100
+):
+    noise = np.random.rand(2, sr).astype(np.float32)
+    expected = Convolution(IMPULSE_RESPONSE_PATH, offline=offline)(noise, sr, buffer_size=512)
+    plugin = Convolution(
+        IMPULSE_RESPONSE_PATH,
+        offline=offline,
+        disk_backed_tail_after_seconds=disk_backed_tail_after_seconds,
+    )
+    np.testing.assert_allclose(plugin(noise, sr, buffer_size=512), expected, atol=1e-6)
+
+
+@pytest.mark.parametrize("tail_truncation_db", [-10.0, -30.0, -300.0])
+def test_convolution_tail_truncation(tmp_path, tail_truncation_db: float, sr=44100):
+    # An exponentially decaying impulse response, like a reverb tail:
+    length = sr // 2
+    impulse_response = np.random.uniform(-1, 1, length) * np.exp(-np.linspace(0, 10, length))
+    pcm = (impulse_response * 32767).astype("<i2")
+    path = str(tmp_path / "decaying_impulse_response.wav")
+    with wave.open(path, "wb") as f:
+        f.setnchannels(1)
+        f.setsampwidth(2)
+        f.setframerate(sr)
+        f.writeframes(pcm.tobytes())
+
+    # Cut off where the remaining energy drops below tail_truncation_db, with
+    # a 10ms fade, before normalising:
+    impulse_response = pcm.astype(np.float64) / 32768
+    energy = impulse_response ** 2
+    remaining_energy = np.cumsum(energy[::-1])[::-1]
+    threshold = np.sum(energy) * 10 ** (tail_truncation_db / 10)
+    truncated_length = np.nonzero(remaining_energy > threshold)[0][-1] + 1
+    if truncated_length < length:
+        impulse_response = impulse_response[:truncated_length].copy()
+        fade_length = min(truncated_length, round(0.01 * sr))
+        impulse_response[-fade_length:] *= 1 - np.arange(fade_length) / fade_length
+    impulse_response *= 0.125 / np.sqrt(np.sum(impulse_response ** 2))
+
+    signal = np.random.rand(2, sr).astype(np.float32)
+    expected = np.stack([np.convolve(c, impulse_response)[: signal.shape[1]] for c in signal])
+    result = Convolution(path, tail_truncation_db=tail_truncation_db)(signal, sr)
+    np.testing.assert_allclose(result, expected, rtol=1e-4, atol=1e-4)
+
+
+def write_random_impulse_response(path: str, length: int = 2000, sr: int = 44100):
+    pcm = (np.random.uniform(-1, 1, length) * 32767).astype("<i2")
+    with wave.open(path, "wb") as f:
+        f.setnchannels(1)
+        f.setsampwidth(2)
+        f.setframerate(sr)
+        f.writeframes(pcm.tobytes())
+
+
+def test_set_impulse_response(tmp_path, sr=44100):
+    new_path = str(tmp_path / "new_impulse_response.wav")
+    write_random_impulse_response(new_path)
+    noise = np.random.rand(2, sr).astype(np.float32)
+
+    plugin = Convolution(IMPULSE_RESPONSE_PATH)
+    plugin(noise, sr)
+    plugin.set_impulse_response(new_path)
+    assert plugin.impulse_response_filename == new_path
+
+    # Between calls to process, the new impulse response is used right away:
+    np.testing.assert_allclose(plugin(noise, sr), Convolution(new_path)(noise, sr), atol=1e-6)
+
+
+def test_set_impulse_response_while_processing(tmp_path, sr=44100):
+    new_path = str(tmp_path / "new_impulse_response.wav")
+    write_random_impulse_response(new_path)
+    noise = np.random.rand(2, sr * 10).astype(np.float32)
+
+    plugin = Convolution(IMPULSE_RESPONSE_PATH)
+    results = []
+    thread = threading.Thread(target=lambda: results.append(plugin(noise, sr, buffer_size=64)))
+    thread.start()
+    plugin.set_impulse_response(new_path, crossfade_seconds=0.01)
+    # The filename can be read (and replaced) while audio is being processed:
+    for path in [IMPULSE_RESPONSE_PATH, new_path] * 5:
+        plugin.set_impulse_response(path, crossfade_seconds=0.01)
+        assert plugin.impulse_response_filename == path
+        assert path in repr(plugin)
+    thread.join()
+
+    assert np.all(np.isfinite(results[0]))
+    np.testing.assert_allclose(plugin(noise, sr), Convolution(new_path)(noise, sr), atol=1e-6)
+
+
 def test_throw_on_inaccessible_convolution_file():
     # Should work:
     Convolution(IMPULSE_RESPONSE_PATH)
@@ -89,3 +357,27 @@ def test_distortion(gain_db, shape, sr=44100):
     np.testing.assert_equal(result.shape, full_scale_noise.shape)
     gain_scale = np.power(10.0, 0.05 * gain_db)
     np.testing.assert_allclose(np.tanh(full_scale_noise * gain_scale), result, rtol=4e-7, atol=2e-7)
+
+
+@pytest.mark.parametrize(
+    "plugin_factory",
+    [
+        lambda: Chorus(depth=0.5, feedback=0.2),
+        lambda: Convolution(IMPULSE_RESPONSE_PATH, 0.5),
+        lambda: Reverb(room_size=0.8),
+        lambda: Gain(-6),
+    ],
+)
+def test_release_keeps_parameters(plugin_factory, sr=44100):
+    noise = np.random.rand(2, sr).astype(np.float32)
+
+    # Releasing a plugin that has never been used should be a no-op:
+    plugin = plugin_factory()
+    plugin.release()
+
+    expected = plugin(noise, sr)
+    plugin.release()
+    np.testing.assert_allclose(plugin(noise, sr), expected, rtol=1e-6, atol=1e-6)
+
+    # Parameters should be unchanged (ignoring the object's address in its repr):
+    assert repr(plugin).rsplit(" at ", 1)[0] == repr(plugin_factory()).rsplit(" at ", 1)[0]
@@ -0,0 +1,79 @@
+#! /usr/bin/env python
+#
+# Copyright 2021 Spotify AB
+#
+# Licensed under the GNU Public License, Version 3.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    https://www.gnu.org/licenses/gpl-3.0.html
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+
+import pytest
+import numpy as np
+from pedalboard import Phaser
+
+
+def phaser_reference(signal, sr, rate_hz, depth, centre_frequency_hz, feedback, mix, stages):
+    """
+    A slow, sample-by-sample implementation of the same algorithm as
+    juce::dsp::Phaser (generalized to any number of stages), which Phaser
+    should sound identical to.
+    """
+    num_samples = signal.shape[-1]
+    # The all-pass filters' cutoff frequency is updated once every four samples:
+    num_updates = (num_samples + 3) // 4
+    lfo = np.sin(2 * np.pi * rate_hz * np.arange(num_updates) / (sr / 4) - np.pi) * depth * 0.5
+    lfo = np.clip(lfo + np.log10(centre_frequency_hz / 20) / np.log10(1000), 0, 1)
+    cutoff = 20 * (min(20000, 0.49 * sr) / 20) ** lfo
+    g = np.tan(np.pi * cutoff / sr)
+    coefficients = np.repeat(g / (1 + g), 4)[:num_samples]
+
+    wet = np.zeros(signal.shape)
+    for c, channel in enumerate(signal):
+        state = np.zeros(stages)
+        last_output = 0.0
+        for i in range(num_samples):
+            x = channel[i] - last_output
+            for stage in range(stages):
+                v = coefficients[i] * (x - state[stage])
+                y = v + state[stage]
+                state[stage] = y + v
+                x = 2 * y - x
+            wet[c, i] = x
+            last_output = x * feedback
+    return signal * (1 - mix) + wet * mix
+
+
+@pytest.mark.parametrize("stages", [4, 6, 12])
+@pytest.mark.parametrize("feedback", [0.0, -0.9])
+@pytest.mark.parametrize("num_channels", [1, 2])
+@pytest.mark.parametrize("buffer_size", [1, 8192])
+def test_phaser_matches_reference(stages, feedback, num_channels, buffer_size):
+    sr = 44100
+    noise = np.random.uniform(-1, 1, (num_channels, sr // 8)).astype(np.float32)
+
+    plugin = Phaser(rate_hz=7.0, depth=1.0, feedback=feedback, stages=stages)
+    result = plugin(noise, sr, buffer_size=buffer_size)
+    expected = phaser_reference(
+        noise.astype(np.float64), sr, 7.0, 1.0, 1300.0, feedback, 0.5, stages
+    )
+    np.testing.assert_allclose(result, expected, rtol=0, atol=1e-4)
+
+
+@pytest.mark.parametrize("stages", [0, 3, 5, 16])
+def test_phaser_throws_on_invalid_stages(stages):
+    with pytest.raises(ValueError):
+        Phaser(stages=stages)
+
+    plugin = Phaser()
+    with pytest.raises(ValueError):
+        plugin.stages = stages
+    assert plugin.stages == 6
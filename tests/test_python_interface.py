@@ -17,7 +17,7 @@
 
 import pytest
 import numpy as np
-from pedalboard import Pedalboard, Gain
+from pedalboard import Pedalboard, Gain, Reverb
 
 
 @pytest.mark.parametrize("shape", [(44100,), (44100, 1), (44100, 2), (1, 4), (2, 4)])
@@ -105,3 +105,12 @@ def test_process_validates_sample_rate():
     pb = Pedalboard([Gain(-6)])
     with pytest.raises(ValueError):
         pb.process(full_scale_noise)
+
+
+def test_release():
+    sr = 44100
+    noise = np.random.rand(sr).astype(np.float32)
+    pb = Pedalboard([Gain(-6), None, Reverb()], sr)
+    expected = pb(noise)
+    pb.release()
+    np.testing.assert_allclose(pb(noise), expected, rtol=1e-6, atol=1e-6)
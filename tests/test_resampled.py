@@ -0,0 +1,120 @@
+#! /usr/bin/env python
+#
+# Copyright 2021 Spotify AB
+#
+# Licensed under the GNU Public License, Version 3.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    https://www.gnu.org/licenses/gpl-3.0.html
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+import gc
+
+import pytest
+import numpy as np
+from pedalboard import Pedalboard, Gain, LinearPhaseEQ, Mix, Resampled
+
+
+def sine(frequency, sample_rate, num_seconds=1.0):
+    t = np.arange(int(sample_rate * num_seconds)) / sample_rate
+    return np.sin(2 * np.pi * frequency * t).astype(np.float32)
+
+
+@pytest.mark.parametrize(
+    "sample_rate,internal_sample_rate",
+    [(44100, 16000), (48000, 8000), (44100, 48000), (22050, 22050)],
+)
+@pytest.mark.parametrize("buffer_size", [1, 100, 8192])
+def test_low_frequencies_pass_through_aligned(sample_rate, internal_sample_rate, buffer_size):
+    audio = np.stack([sine(440, sample_rate), sine(1000, sample_rate)])
+    plugin = Resampled([Gain(gain_db=-6)], internal_sample_rate)
+    output = plugin(audio, sample_rate, buffer_size=buffer_size)
+
+    assert output.shape == audio.shape
+    # Ignore the edges, where the resampling filters start and stop:
+    np.testing.assert_allclose(output[:, 1000:-1000], audio[:, 1000:-1000] * 0.501187, atol=1e-3)
+
+
+def test_high_frequencies_are_removed():
+    sample_rate = 44100
+    audio = sine(10000, sample_rate)
+    output = Resampled([Gain()], 16000)(audio, sample_rate)
+    assert np.max(np.abs(output[1000:-1000])) < 1e-3
+
+
+def test_latency_of_wrapped_plugins_is_compensated():
+    sample_rate = 44100
+    audio = sine(200, sample_rate)
+    eq = LinearPhaseEQ([200], [0], num_taps=255)
+    output = Resampled([eq], 11025)(audio, sample_rate)
+    np.testing.assert_allclose(output[2000:-2000], audio[2000:-2000], atol=2e-3)
+
+
+def test_mixed_output_lines_up():
+    sample_rate = 44100
+    audio = sine(300, sample_rate)
+    output = Mix(Resampled([Gain()], 8000), mix=0.5)(audio, sample_rate)
+    np.testing.assert_allclose(output[1000:-1000], audio[1000:-1000], atol=1e-3)
+
+
+def test_accepts_single_plugins_and_pedalboards():
+    sample_rate = 44100
+    audio = sine(440, sample_rate)
+    expected = Resampled([Gain(gain_db=6)], 16000)(audio, sample_rate)
+
+    single = Resampled(Gain(gain_db=6), 16000)
+    np.testing.assert_allclose(single(audio, sample_rate), expected, atol=1e-6)
+
+    board = Resampled(Pedalboard([Gain(gain_db=3), Gain(gain_db=3)]), 16000)
+    np.testing.assert_allclose(board(audio, sample_rate), expected, atol=1e-5)
+
+
+def test_resampled_keeps_plugins_alive():
+    plugin = Resampled([Gain(gain_db=-6), Gain(gain_db=3)], 16000)
+    gc.collect()
+    assert [p.gain_db for p in plugin.plugins] == [-6, 3]
+    assert plugin.internal_sample_rate == 16000
+    assert "Gain" in repr(plugin)
+
+
+def test_resampled_keeps_plugins_alive_when_their_sequence_changes():
+    sample_rate = 44100
+    audio = sine(440, sample_rate)
+    expected = Resampled([Gain(gain_db=6)], 16000)(audio, sample_rate)
+
+    plugins = [Gain(gain_db=6)]
+    from_list = Resampled(plugins, 16000)
+    board = Pedalboard([Gain(gain_db=6)])
+    from_board = Resampled(board, 16000)
+
+    plugins.clear()
+    del board[0]
+    gc.collect()
+
+    assert [p.gain_db for p in from_list.plugins] == [6]
+    assert [p.gain_db for p in from_board.plugins] == [6]
+    np.testing.assert_allclose(from_list(audio, sample_rate), expected, atol=1e-6)
+    np.testing.assert_allclose(from_board(audio, sample_rate), expected, atol=1e-6)
+
+
+def test_non_plugins_are_rejected():
+    with pytest.raises(TypeError):
+        Resampled([Gain(), "not a plugin"], 16000)
+    with pytest.raises(TypeError):
+        Resampled(None, 16000)
+
+
+def test_invalid_internal_sample_rate():
+    with pytest.raises(ValueError):
+        Resampled([Gain()], 0)
+
+    plugin = Resampled([Gain()], 16000)
+    with pytest.raises(ValueError):
+        plugin.internal_sample_rate = -1
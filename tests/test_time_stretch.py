@@ -0,0 +1,104 @@
+#! /usr/bin/env python
+#
+# Copyright 2021 Spotify AB
+#
+# Licensed under the GNU Public License, Version 3.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    https://www.gnu.org/licenses/gpl-3.0.html
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+import pytest
+import numpy as np
+from pedalboard import Pedalboard, Gain, Mix, PitchShift, TimeStretch
+
+
+def get_peak_frequency(signal: np.ndarray, sample_rate: float) -> float:
+    magnitudes = np.abs(np.fft.rfft(signal * np.hanning(len(signal))))
+    return np.argmax(magnitudes) * sample_rate / len(signal)
+
+
+def sine_wave(frequency: float, sample_rate: float, num_samples: int) -> np.ndarray:
+    t = np.arange(num_samples) / sample_rate
+    return np.sin(2 * np.pi * frequency * t).astype(np.float32)
+
+
+@pytest.mark.parametrize("rate", [0.1, 0.5, 0.8, 1.25, 2.0, 10.0])
+@pytest.mark.parametrize("buffer_size", [512, 8192])
+def test_time_stretch_changes_length_but_not_pitch(rate, buffer_size):
+    sr = 44100
+    sine = np.stack([sine_wave(440, sr, sr), 0.5 * sine_wave(440, sr, sr)])
+    output = TimeStretch(rate=rate)(sine, sr, buffer_size=buffer_size)
+
+    assert output.shape == (2, round(sr / rate))
+    middle = output[:, output.shape[1] // 4 : 3 * output.shape[1] // 4]
+    assert get_peak_frequency(middle[0], sr) == pytest.approx(440, abs=2)
+    np.testing.assert_allclose(np.sqrt(np.mean(middle**2, axis=1)), [0.707, 0.354], rtol=0.1)
+
+
+@pytest.mark.parametrize("plugin", [TimeStretch(rate=1.0), PitchShift(semitones=0)])
+@pytest.mark.parametrize("buffer_size", [1, 100, 8192])
+@pytest.mark.parametrize("shape", [(8192,), (2, 8192)])
+def test_identity_is_aligned_with_input(plugin, buffer_size, shape):
+    sr = 44100
+    noise = np.random.uniform(-1, 1, shape).astype(np.float32)
+    np.testing.assert_allclose(plugin(noise, sr, buffer_size=buffer_size), noise, atol=1e-3)
+
+
+@pytest.mark.parametrize("semitones", [-24, -12, -5, 3, 7, 12, 24])
+def test_pitch_shift_changes_pitch_but_not_length(semitones):
+    sr = 44100
+    sine = sine_wave(440, sr, sr)
+    output = PitchShift(semitones=semitones)(sine, sr, buffer_size=1000)
+
+    assert output.shape == sine.shape
+    expected = 440 * 2 ** (semitones / 12)
+    assert get_peak_frequency(output[sr // 4 : 3 * sr // 4], sr) == pytest.approx(expected, abs=2)
+
+
+def test_chain_of_length_changes():
+    sr = 44100
+    sine = sine_wave(440, sr, sr)
+    board = Pedalboard([TimeStretch(rate=0.8), Gain(gain_db=-6), PitchShift(3), TimeStretch(1.5)])
+    output = board(sine, sr, buffer_size=1024)
+
+    assert output.shape == (round(round(sr / 0.8) / 1.5),)
+    middle = output[len(output) // 4 : 3 * len(output) // 4]
+    assert get_peak_frequency(middle, sr) == pytest.approx(440 * 2**0.25, abs=2)
+
+
+def test_reused_stage_buffers_do_not_change_output():
+    sr = 44100
+    sine = sine_wave(440, sr, sr)
+    short_chain = Pedalboard([TimeStretch(rate=1.25)])
+    long_chain = Pedalboard([TimeStretch(rate=0.5), Gain(gain_db=-6), TimeStretch(rate=0.8)])
+
+    expected = short_chain(sine, sr, buffer_size=256)
+    # Processing a chain with more, larger stages first must not leave
+    # anything behind in the buffers reused by the shorter chain:
+    long_chain(sine, sr, buffer_size=4096)
+    np.testing.assert_allclose(short_chain(sine, sr, buffer_size=256), expected)
+
+
+def test_time_stretch_cannot_be_mixed():
+    sr = 44100
+    noise = np.random.uniform(-1, 1, sr).astype(np.float32)
+    with pytest.raises(RuntimeError):
+        Mix(TimeStretch(rate=2.0))(noise, sr)
+    Mix(TimeStretch(rate=1.0))(noise, sr)
+
+
+def test_invalid_parameters():
+    with pytest.raises(ValueError):
+        TimeStretch(rate=0)
+    with pytest.raises(ValueError):
+        TimeStretch(rate=20)
+    with pytest.raises(ValueError):
+        PitchShift(semitones=36)